@@ -0,0 +1,526 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include <time.h>
+
+#include <benchmark/benchmark.h>
+
+#include <grpcpp/grpcpp.h>
+
+#include "view_proto_helper.h"
+#include "exchange_stream.h"
+#include "loopback_transport.h"
+#include "udp_transport.h"
+#include "local_channels.h"
+#include "channel_pool.h"
+#include "entry_sampler.h"
+#include "admission_control.h"
+#include "merge_queue.h"
+#include "client.h"
+#include "server.h"
+
+using namespace gossip;
+
+/* Bytes of payload one push/pull puts on the wire each way, excluding framing. Unary RPCs also pay a HEADERS frame
+   (path, deadline, content type) per call that the stream only pays once when it opens. */
+static void set_payload_counters(benchmark::State& state, std::shared_ptr<URView> view, bool stream) {
+    ViewProto tx_buf;
+    ViewProtoHelper<NodeDescriptor>::add_to_proto(view->tx_nodes(), tx_buf);
+    if (!stream) {
+        state.counters["bytes_per_exchange"] = 2 * tx_buf.ByteSizeLong();
+        return;
+    }
+    ExchangeRequest request;
+    request.set_id(state.iterations());
+    request.set_type(ExchangeRequest::PUSH_PULL);
+    *request.mutable_view() = tx_buf;
+    ExchangeResponse response;
+    response.set_id(state.iterations());
+    *response.mutable_view() = tx_buf;
+    state.counters["bytes_per_exchange"] = request.ByteSizeLong() + response.ByteSizeLong();
+}
+
+/* CPU time of the whole process, every gRPC, transport and scheduler thread included, in microseconds */
+static double process_cpu_us() {
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+/* Loopback exchanges against a single in process server, one exchange per iteration */
+static void BM_Client_push_pull_view_loopback(benchmark::State& state) {
+    const std::string server_address = "127.0.0.1:51051";
+    std::shared_ptr<URView> view_server = std::make_shared<URView>(server_address, 10, 5, 5);
+    view_server->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view_server);
+    std::shared_ptr<Server::Thread> server_thread = server->thread();
+    server_thread->start();
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("127.0.0.1:51052", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view_client);
+
+    // Server comes up asynchronously
+    while (!client->push_pull_view(server_address).ok()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    int64_t failed = 0;
+    for (auto _ : state) {
+        if (!client->push_pull_view(server_address).ok()) {
+            ++failed;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["failed"] = failed;
+    set_payload_counters(state, view_client, false);
+}
+BENCHMARK(BM_Client_push_pull_view_loopback)->UseRealTime()->MinTime(2.0);
+
+
+/* Sequential exchanges multiplexed over one persistent stream, compare with BM_Client_push_pull_view_loopback */
+static void BM_Client_push_pull_view_stream_loopback(benchmark::State& state) {
+    const std::string server_address = "127.0.0.1:51053";
+    std::shared_ptr<URView> view_server = std::make_shared<URView>(server_address, 10, 5, 5);
+    view_server->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view_server);
+    std::shared_ptr<Server::Thread> server_thread = server->thread();
+    server_thread->start();
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("127.0.0.1:51054", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view_client);
+    client->set_exchange_streams(std::make_shared<ExchangeStreamPool>(client->channel_pool()));
+
+    // Server comes up asynchronously
+    while (!client->push_pull_view(server_address).ok()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    int64_t failed = 0;
+    for (auto _ : state) {
+        if (!client->push_pull_view(server_address).ok()) {
+            ++failed;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["failed"] = failed;
+    set_payload_counters(state, view_client, true);
+}
+BENCHMARK(BM_Client_push_pull_view_stream_loopback)->UseRealTime()->MinTime(2.0);
+
+/* state.range(0) exchanges in flight at once against one server, state.range(1) selects the stream over unary RPCs */
+static void BM_Client_push_pull_view_concurrent(benchmark::State& state) {
+    const bool stream = state.range(1);
+    const std::string server_address = stream ? "127.0.0.1:51055" : "127.0.0.1:51057";
+    std::shared_ptr<URView> view_server = std::make_shared<URView>(server_address, 10, 5, 5);
+    view_server->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view_server);
+    std::shared_ptr<Server::Thread> server_thread = server->thread();
+    server_thread->start();
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>(stream ? "127.0.0.1:51056" : "127.0.0.1:51058", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view_client);
+    client->set_max_in_flight(state.range(0));
+    if (stream) {
+        client->set_exchange_streams(std::make_shared<ExchangeStreamPool>(client->channel_pool()));
+    }
+
+    // Server comes up asynchronously
+    while (!client->push_pull_view(server_address).ok()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::atomic<int64_t> failed(0);
+    double cpu_start = process_cpu_us();
+    for (auto _ : state) {
+        std::mutex lock;
+        std::condition_variable all_done;
+        int64_t remaining = state.range(0);
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            client->async_push_pull_view(server_address, [&](::grpc::Status status) {
+                if (!status.ok()) {
+                    failed++;
+                }
+                std::lock_guard<std::mutex> guard(lock);
+                if (--remaining == 0) {
+                    all_done.notify_one();
+                }
+            });
+        }
+        std::unique_lock<std::mutex> guard(lock);
+        all_done.wait(guard, [&remaining]() { return remaining == 0; });
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["rpcs_per_second"] = benchmark::Counter(state.iterations() * state.range(0), benchmark::Counter::kIsRate);
+    state.counters["cpu_us_per_exchange"] = (process_cpu_us() - cpu_start) / (state.iterations() * state.range(0));
+    state.counters["failed"] = failed.load();
+    set_payload_counters(state, view_client, stream);
+}
+BENCHMARK(BM_Client_push_pull_view_concurrent)->ArgsProduct({{1, 16, 64}, {0, 1}})->ArgNames({"in_flight", "stream"})->UseRealTime()->MinTime(2.0);
+
+/* Same exchange as BM_Client_push_pull_view_loopback delivered in process, the difference is the cost of gRPC */
+static void BM_Client_push_pull_view_loopback_transport(benchmark::State& state) {
+    std::shared_ptr<LoopbackTransport> transport = std::make_shared<LoopbackTransport>();
+    std::shared_ptr<URView> view_server = std::make_shared<URView>("node:0", 10, 5, 5);
+    view_server->init_selector(SelectorType::TAIL);
+    transport->serve(std::make_shared<Server>(view_server));
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("node:1", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view_client);
+    client->set_transport(transport);
+
+    int64_t failed = 0;
+    for (auto _ : state) {
+        if (!client->push_pull_view("node:0").ok()) {
+            ++failed;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["failed"] = failed;
+}
+BENCHMARK(BM_Client_push_pull_view_loopback_transport)->UseRealTime();
+
+/* One gossip round of every node in a state.range(0) node network sharing one loopback transport per iteration */
+static void BM_Client_gossip_round_loopback_network(benchmark::State& state) {
+    std::shared_ptr<LoopbackTransport> transport = std::make_shared<LoopbackTransport>();
+    std::vector<std::shared_ptr<Client>> clients;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        std::shared_ptr<URView> view = std::make_shared<URView>("node:" + std::to_string(i), 30, 15, 15);
+        view->init_selector(SelectorType::UNIFORM_RANDOM);
+        transport->serve(std::make_shared<Server>(view));
+        std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view);
+        client->set_transport(transport);
+        // Every node bootstraps off the first
+        if (i > 0) {
+            client->push_pull_view("node:0");
+        }
+        clients.push_back(client);
+    }
+
+    for (auto _ : state) {
+        for (auto& client : clients) {
+            client->async_gossip_round();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Client_gossip_round_loopback_network)->Arg(1000)->Arg(10000)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/* BM_Client_push_pull_view_concurrent over a UDP transport on loopback, both nodes' sockets live in this process so
+   cpu_us_per_exchange covers both ends as it does for gRPC */
+static void BM_Client_push_pull_view_udp_concurrent(benchmark::State& state) {
+    const std::string server_address = "127.0.0.1:51059";
+    std::shared_ptr<URView> view_server = std::make_shared<URView>(server_address, 10, 5, 5);
+    view_server->init_selector(SelectorType::TAIL);
+    std::shared_ptr<UdpTransport> server_transport = std::make_shared<UdpTransport>(server_address);
+    server_transport->serve(std::make_shared<Server>(view_server));
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("127.0.0.1:51060", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view_client);
+    client->set_max_in_flight(state.range(0));
+    client->set_transport(std::make_shared<UdpTransport>("127.0.0.1:51060"));
+
+    std::atomic<int64_t> failed(0);
+    double cpu_start = process_cpu_us();
+    for (auto _ : state) {
+        std::mutex lock;
+        std::condition_variable all_done;
+        int64_t remaining = state.range(0);
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            client->async_push_pull_view(server_address, [&](::grpc::Status status) {
+                if (!status.ok()) {
+                    failed++;
+                }
+                std::lock_guard<std::mutex> guard(lock);
+                if (--remaining == 0) {
+                    all_done.notify_one();
+                }
+            });
+        }
+        std::unique_lock<std::mutex> guard(lock);
+        all_done.wait(guard, [&remaining]() { return remaining == 0; });
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["rpcs_per_second"] = benchmark::Counter(state.iterations() * state.range(0), benchmark::Counter::kIsRate);
+    state.counters["cpu_us_per_exchange"] = (process_cpu_us() - cpu_start) / (state.iterations() * state.range(0));
+    state.counters["failed"] = failed.load();
+}
+BENCHMARK(BM_Client_push_pull_view_udp_concurrent)->Arg(1)->Arg(16)->Arg(64)->ArgName("in_flight")->UseRealTime()->MinTime(2.0);
+
+
+/* Sequential exchanges with a co-located server over loopback TCP (0), a unix domain socket (1) and an
+   in-process channel (2), each through its own pool so no channel is shared between modes */
+static void BM_Client_push_pull_view_local(benchmark::State& state) {
+    const int mode = state.range(0);
+    const std::string server_address = "127.0.0.1:51061";
+    const std::string local_address = "unix:///tmp/gossip_bench_51061.sock";
+    std::shared_ptr<URView> view_server = std::make_shared<URView>(server_address, 10, 5, 5);
+    view_server->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view_server);
+    server->set_local_address(local_address);
+    std::shared_ptr<Server::Thread> server_thread = server->thread();
+    server_thread->start();
+
+    std::shared_ptr<ChannelPool> channel_pool = std::make_shared<ChannelPool>(4, std::chrono::seconds(60));
+    channel_pool->set_in_process(mode == 2);
+    if (mode == 1) {
+        LocalChannels::global().add_route(server_address, local_address);
+    }
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("127.0.0.1:51062", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view_client, channel_pool);
+
+    // Server comes up asynchronously
+    while (!client->push_pull_view(server_address).ok()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    int64_t failed = 0;
+    double cpu_start = process_cpu_us();
+    for (auto _ : state) {
+        if (!client->push_pull_view(server_address).ok()) {
+            ++failed;
+        }
+    }
+    state.counters["cpu_us_per_exchange"] = (process_cpu_us() - cpu_start) / std::max<int64_t>(state.iterations(), 1);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["failed"] = failed;
+    LocalChannels::global().remove_route(server_address);
+}
+BENCHMARK(BM_Client_push_pull_view_local)->Arg(0)->Arg(1)->Arg(2)->ArgName("mode")->UseRealTime()->MinTime(2.0);
+
+
+/* state.range(0) clients, each on its own connection with 16 exchanges in flight, against one entry server run
+   with gRPC's defaults (tuned 0) or with ServerOptions sized for fan in (tuned 1) */
+static void BM_Server_fan_in(benchmark::State& state) {
+    const int num_clients = state.range(0);
+    const bool tuned = state.range(1);
+    const int64_t in_flight = 16;
+    const std::string server_address = tuned ? "127.0.0.1:51063" : "127.0.0.1:51064";
+    std::shared_ptr<URView> view_server = std::make_shared<URView>(server_address, 10, 5, 5);
+    view_server->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view_server);
+    if (tuned) {
+        ServerOptions options;
+        options.memory_quota = 64 * 1024 * 1024;
+        options.max_concurrent_streams = in_flight;
+        options.min_ping_interval = std::chrono::seconds(10);
+        options.max_connection_idle = std::chrono::seconds(30);
+        server->set_options(options);
+    }
+    std::shared_ptr<Server::Thread> server_thread = server->thread();
+    server_thread->start();
+
+    std::vector<std::shared_ptr<Client>> clients;
+    for (int i = 0; i < num_clients; ++i) {
+        std::shared_ptr<URView> view_client = std::make_shared<URView>("clienthost:" + std::to_string(52000 + i), 10, 5, 5);
+        view_client->init_selector(SelectorType::TAIL);
+        // A pool per client so each holds its own connection to the server
+        std::shared_ptr<ChannelPool> channel_pool = std::make_shared<ChannelPool>(4, std::chrono::seconds(60));
+        clients.push_back(std::make_shared<Client>(true, true, 1, 1, view_client, channel_pool));
+        clients.back()->set_max_in_flight(in_flight);
+        // Server comes up asynchronously
+        while (!clients.back()->push_pull_view(server_address).ok()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    std::atomic<int64_t> failed(0);
+    double cpu_start = process_cpu_us();
+    for (auto _ : state) {
+        std::mutex lock;
+        std::condition_variable all_done;
+        int64_t remaining = num_clients * in_flight;
+        for (auto& client : clients) {
+            for (int64_t i = 0; i < in_flight; ++i) {
+                client->async_push_pull_view(server_address, [&](::grpc::Status status) {
+                    if (!status.ok()) {
+                        failed++;
+                    }
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (--remaining == 0) {
+                        all_done.notify_one();
+                    }
+                });
+            }
+        }
+        std::unique_lock<std::mutex> guard(lock);
+        all_done.wait(guard, [&remaining]() { return remaining == 0; });
+    }
+    const int64_t exchanges = state.iterations() * num_clients * in_flight;
+    state.SetItemsProcessed(exchanges);
+    state.counters["rpcs_per_second"] = benchmark::Counter(exchanges, benchmark::Counter::kIsRate);
+    state.counters["cpu_us_per_exchange"] = (process_cpu_us() - cpu_start) / exchanges;
+    state.counters["failed"] = failed.load();
+}
+BENCHMARK(BM_Server_fan_in)->ArgsProduct({{16, 64}, {0, 1}})->ArgNames({"clients", "tuned"})->UseRealTime()->MinTime(2.0);
+
+
+/* A bootstrap storm on one entry point, 8 threads each serving 64 push/pulls from distinct joiners straight through
+   Server::answer, against the view's lock (entry_sampler 0) or from an EntrySampler (entry_sampler 1) */
+static void BM_Server_entry_storm(benchmark::State& state) {
+    const bool use_sampler = state.range(0);
+    const int num_threads = 8;
+    const int per_thread = 64;
+    std::shared_ptr<URView> view = std::make_shared<URView>("entry:0", 64, 16, 16);
+    view->init_selector(SelectorType::UNIFORM_RANDOM);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view);
+    std::shared_ptr<EntrySampler> sampler;
+    if (use_sampler) {
+        sampler = std::make_shared<EntrySampler>(view, std::chrono::milliseconds(100));
+        server->set_entry_sampler(sampler);
+        sampler->start();
+    }
+
+    std::vector<ViewProto> requests(num_threads * per_thread);
+    for (std::size_t i = 0; i < requests.size(); ++i) {
+        NodeDescriptorProto* node = requests[i].add_nodes();
+        node->set_address("joiner:" + std::to_string(i));
+        node->set_age(0);
+    }
+
+    for (auto _ : state) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&server, &requests, t]() {
+                for (int i = 0; i < per_thread; ++i) {
+                    ViewProto response;
+                    server->answer(ExchangeRequest::PUSH_PULL, requests[t * per_thread + i], response);
+                    benchmark::DoNotOptimize(response);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * num_threads * per_thread);
+    if (sampler) {
+        sampler->stop();
+    }
+}
+BENCHMARK(BM_Server_entry_storm)->Arg(0)->Arg(1)->ArgName("entry_sampler")->UseRealTime();
+
+
+/* select_peer() on an application thread while one looping peer floods the node's server with pushes, admitted
+   without limit (admission 0) or held to 100 exchanges a second (admission 1) */
+static void BM_View_select_peer_under_flood(benchmark::State& state) {
+    const bool admission = state.range(0);
+    std::shared_ptr<URView> view = std::make_shared<URView>("node:0", 64, 16, 16);
+    view->init_selector(SelectorType::UNIFORM_RANDOM);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view);
+    if (admission) {
+        server->set_admission_control(std::make_shared<AdmissionControl>(100.0, 10.0, 0));
+    }
+
+    ViewProto flood;
+    for (int i = 0; i < 64; ++i) {
+        NodeDescriptorProto* node = flood.add_nodes();
+        node->set_address("looping:" + std::to_string(i));
+        node->set_age(0);
+    }
+    std::atomic<bool> flooding(true);
+    std::thread flooder([&server, &flood, &flooding]() {
+        while (flooding) {
+            ViewProto unused;
+            server->serve("ipv4:10.0.0.1", ExchangeRequest::PUSH, flood, unused);
+        }
+    });
+
+    // The mean hides the stalls behind the flooder's merges, the tail shows them
+    std::vector<int64_t> latencies_ns;
+    latencies_ns.reserve(1 << 20);
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        benchmark::DoNotOptimize(view->select_peer());
+        if (latencies_ns.size() < latencies_ns.capacity()) {
+            latencies_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+    flooding = false;
+    flooder.join();
+    state.SetItemsProcessed(state.iterations());
+    if (!latencies_ns.empty()) {
+        std::size_t p99 = latencies_ns.size() * 99 / 100;
+        std::nth_element(latencies_ns.begin(), latencies_ns.begin() + p99, latencies_ns.end());
+        state.counters["p99_ns"] = latencies_ns[p99];
+    }
+}
+BENCHMARK(BM_View_select_peer_under_flood)->Arg(0)->Arg(1)->ArgName("admission")->UseRealTime();
+
+
+/* Eight threads pushing into one server, each push merged into the view on its own (merge_queue 0) or queued and
+   merged in batches by the queue's thread (merge_queue 1) */
+static void BM_Server_merge_queue(benchmark::State& state) {
+    const bool use_queue = state.range(0);
+    const int num_threads = 8;
+    const int per_thread = 64;
+    std::shared_ptr<URView> view = std::make_shared<URView>("node:0", 64, 16, 16);
+    view->init_selector(SelectorType::UNIFORM_RANDOM);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view);
+    std::shared_ptr<MergeQueue> merge_queue;
+    if (use_queue) {
+        merge_queue = std::make_shared<MergeQueue>(view);
+        server->set_merge_queue(merge_queue);
+    }
+
+    std::vector<ViewProto> requests(num_threads * per_thread);
+    for (std::size_t i = 0; i < requests.size(); ++i) {
+        for (int j = 0; j < 16; ++j) {
+            NodeDescriptorProto* node = requests[i].add_nodes();
+            node->set_address("pusher:" + std::to_string((i * 16 + j) % 1024));
+            node->set_age(j);
+        }
+    }
+
+    for (auto _ : state) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&server, &requests, t]() {
+                for (int i = 0; i < per_thread; ++i) {
+                    ViewProto response;
+                    server->answer(ExchangeRequest::PUSH, requests[t * per_thread + i], response);
+                    benchmark::DoNotOptimize(response);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (merge_queue) {
+            merge_queue->flush();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * num_threads * per_thread);
+}
+BENCHMARK(BM_Server_merge_queue)->Arg(0)->Arg(1)->ArgName("merge_queue")->UseRealTime();
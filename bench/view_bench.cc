@@ -0,0 +1,197 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+
+#include <benchmark/benchmark.h>
+
+#include "view.h"
+#include "packed_view.h"
+
+using namespace gossip;
+
+/* A full view of state.range(0) nodes, swap a quarter of it and healing a quarter of it unless turned off. Seeded, so
+   every run makes the same choices */
+template <class ViewType>
+static std::shared_ptr<ViewType> full_view(benchmark::State& state, bool healing=true, SelectorType type=SelectorType::UNIFORM_RANDOM) {
+    const int size = state.range(0);
+    std::shared_ptr<ViewType> view = std::make_shared<ViewType>("node:0", size, healing ? size / 4 : 0, size / 4, 1);
+    view->init_selector(type);
+    std::vector<std::shared_ptr<NodeDescriptor>> nodes;
+    for (int i = 0; i < size; ++i) {
+        nodes.push_back(std::make_shared<NodeDescriptor>("peer:" + std::to_string(i), i % 32));
+    }
+    view->manual_insert(nodes);
+    return view;
+}
+
+template <class ViewType>
+static void BM_View_tx_nodes(benchmark::State& state) {
+    std::shared_ptr<ViewType> view = full_view<ViewType>(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(view->tx_nodes());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* Only the sampling of what to send, without holding back the oldest */
+template <class ViewType>
+static void BM_View_tx_nodes_no_healing(benchmark::State& state) {
+    std::shared_ptr<ViewType> view = full_view<ViewType>(state, false);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(view->tx_nodes());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* Merges half a view at a time, drawn from four views' worth of addresses, so most of each batch is new and evicts */
+template <class ViewType>
+static void rx_churn(benchmark::State& state, SelectorType type) {
+    const int size = state.range(0);
+    std::shared_ptr<ViewType> view = full_view<ViewType>(state, true, type);
+    const int num_batches = 16;
+    std::vector<std::vector<std::shared_ptr<NodeDescriptor>>> batches(num_batches);
+    for (int b = 0; b < num_batches; ++b) {
+        for (int i = 0; i < size / 2; ++i) {
+            int peer = (b * size / 2 + i * 7) % (4 * size);
+            batches[b].push_back(std::make_shared<NodeDescriptor>("peer:" + std::to_string(peer), i % 32));
+        }
+    }
+    int b = 0;
+    for (auto _ : state) {
+        view->rx_nodes(batches[b]);
+        b = (b + 1) % num_batches;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <class ViewType>
+static void BM_View_rx_nodes(benchmark::State& state) {
+    rx_churn<ViewType>(state, SelectorType::UNIFORM_RANDOM);
+}
+
+/* The same churn, with a no replacement selector told of every peer coming and going */
+template <class ViewType>
+static void BM_View_rx_nodes_urnr(benchmark::State& state) {
+    rx_churn<ViewType>(state, SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT);
+}
+
+template <class ViewType>
+static void BM_View_increment_age(benchmark::State& state) {
+    std::shared_ptr<ViewType> view = full_view<ViewType>(state);
+    for (auto _ : state) {
+        view->increment_age();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* k distinct peers for a broadcast, as k select_peer() calls that drop repeats against one select_peers(k) */
+template <class ViewType>
+static void BM_View_select_peer_k_times(benchmark::State& state) {
+    std::shared_ptr<ViewType> view = full_view<ViewType>(state);
+    const std::size_t k = state.range(1);
+    std::vector<std::shared_ptr<NodeDescriptor>> selected;
+    for (auto _ : state) {
+        selected.clear();
+        while (selected.size() < k) {
+            std::shared_ptr<NodeDescriptor> peer = view->select_peer();
+            if (std::none_of(selected.begin(), selected.end(), [&peer](const std::shared_ptr<NodeDescriptor>& node) { return node->address() == peer->address(); })) {
+                selected.push_back(peer);
+            }
+        }
+        benchmark::DoNotOptimize(selected.data());
+    }
+    state.SetItemsProcessed(state.iterations() * k);
+}
+
+template <class ViewType>
+static void BM_View_select_peers(benchmark::State& state) {
+    std::shared_ptr<ViewType> view = full_view<ViewType>(state);
+    const std::size_t k = state.range(1);
+    std::vector<std::shared_ptr<NodeDescriptor>> selected;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(view->select_peers(k, selected));
+    }
+    state.SetItemsProcessed(state.iterations() * k);
+}
+
+/* select_peer() on an application thread while another thread merges exchanges into the view back to back */
+template <class ViewType>
+static void BM_View_select_peer_while_merging(benchmark::State& state) {
+    const int size = state.range(0);
+    std::shared_ptr<ViewType> view = full_view<ViewType>(state);
+    std::vector<std::vector<std::shared_ptr<NodeDescriptor>>> batches(16);
+    for (std::size_t b = 0; b < batches.size(); ++b) {
+        for (int i = 0; i < size / 2; ++i) {
+            batches[b].push_back(std::make_shared<NodeDescriptor>("peer:" + std::to_string((b * size / 2 + i) % (4 * size)), i % 32));
+        }
+    }
+    std::atomic<bool> merging(true);
+    std::thread merger([&view, &batches, &merging]() {
+        for (std::size_t b = 0; merging; b = (b + 1) % batches.size()) {
+            view->merge(batches[b]);
+            benchmark::DoNotOptimize(view->tx_nodes());
+        }
+    });
+
+    std::vector<int64_t> latencies_ns;
+    latencies_ns.reserve(1 << 20);
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        benchmark::DoNotOptimize(view->select_peer());
+        if (latencies_ns.size() < latencies_ns.capacity()) {
+            latencies_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+    merging = false;
+    merger.join();
+    state.SetItemsProcessed(state.iterations());
+    if (!latencies_ns.empty()) {
+        // Merges are rare next to selections, the stalls behind them only show past the 99th percentile
+        std::size_t p99 = latencies_ns.size() * 99 / 100;
+        std::nth_element(latencies_ns.begin(), latencies_ns.begin() + p99, latencies_ns.end());
+        state.counters["p99_ns"] = latencies_ns[p99];
+        std::size_t p999 = latencies_ns.size() * 999 / 1000;
+        std::nth_element(latencies_ns.begin(), latencies_ns.begin() + p999, latencies_ns.end());
+        state.counters["p999_ns"] = latencies_ns[p999];
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_View_tx_nodes, URView)->Arg(32)->Arg(256)->Arg(1024)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_View_tx_nodes, PackedView)->Arg(32)->Arg(256)->Arg(1024)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_View_tx_nodes_no_healing, URView)->Arg(32)->Arg(256)->Arg(1024)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_View_tx_nodes_no_healing, PackedView)->Arg(32)->Arg(256)->Arg(1024)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_View_rx_nodes, URView)->Arg(32)->Arg(256)->Arg(1024)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_View_rx_nodes, PackedView)->Arg(32)->Arg(256)->Arg(1024)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_View_rx_nodes_urnr, URView)->Arg(32)->Arg(256)->Arg(1024)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_View_rx_nodes_urnr, PackedView)->Arg(32)->Arg(256)->Arg(1024)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_View_increment_age, URView)->Arg(32)->Arg(256)->Arg(1024)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_View_increment_age, PackedView)->Arg(32)->Arg(256)->Arg(1024)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_View_select_peer_k_times, URView)->Args({256, 8})->Args({10000, 8})->Args({10000, 64});
+BENCHMARK_TEMPLATE(BM_View_select_peer_k_times, PackedView)->Args({256, 8})->Args({10000, 8})->Args({10000, 64});
+BENCHMARK_TEMPLATE(BM_View_select_peers, URView)->Args({256, 8})->Args({10000, 8})->Args({10000, 64});
+BENCHMARK_TEMPLATE(BM_View_select_peers, PackedView)->Args({256, 8})->Args({10000, 8})->Args({10000, 64});
+BENCHMARK_TEMPLATE(BM_View_select_peer_while_merging, URView)->Arg(32)->Arg(1024)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_View_select_peer_while_merging, PackedView)->Arg(32)->Arg(1024)->UseRealTime();
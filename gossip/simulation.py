@@ -26,6 +26,7 @@ from pathlib import Path
 import networkx as nx
 import json
 import random
+import zlib
 
 
 
@@ -108,7 +109,14 @@ class NodeSchema():
     def __init__(self, name: str,
                  push: bool, pull: bool, wait_time: int, timeout: int,
                  func: Callable[[_gossip.PeerSamplingService, _gossip.View, _gossip.TSLog, threading.Event], None],
-                 view_type: _gossip.View, selector_type: _gossip.SelectorType, **view_args):
+                 view_type: _gossip.View, selector_type: _gossip.SelectorType,
+                 scheduler: _gossip.Scheduler=None, jitter: float=None, fanout: int=None,
+                 min_timeout: float=None, evict_after: int=None, max_streams: int=None,
+                 transport: _gossip.Transport=None, udp: bool=False, in_process: bool=False,
+                 local_socket_dir: str=None, server_options: _gossip.ServerOptions=None,
+                 entry_refresh: float=None, redirects: list[str]=None, admission_rate: float=None,
+                 admission_burst: float=None, max_in_flight: int=None, merge_batch: int=None,
+                 merge_delay: float=None, seed: int=None, **view_args):
         
         self.name = name
         self.push = push
@@ -119,15 +127,89 @@ class NodeSchema():
         self.selector_type = selector_type
         self.view_args = view_args
         self.func = func
+        # Shared scheduler drives the gossip rounds of every node of this schema instead of one client thread each
+        self.scheduler = scheduler
+        # Seconds (or timedelta) each gossip period is randomly stretched or shrunk by
+        self.jitter = jitter
+        self.fanout = fanout
+        # Given a floor, deadlines adapt to each peer's round trip time between it and timeout
+        self.min_timeout = min_timeout
+        # Consecutive failed exchanges before a peer is evicted, half that many gets it passed over
+        self.evict_after = evict_after
+        # Given a bound, each node keeps that many persistent exchange streams open to its most frequent peers
+        self.max_streams = max_streams
+        # Shared by every node of this schema in place of gRPC, a LoopbackTransport runs them all without sockets
+        self.transport = transport
+        # Each node exchanges over its own UDP socket bound to its address instead of gRPC
+        self.udp = udp
+        # Nodes reach peers hosted in this same process through in-process gRPC channels, no sockets involved
+        self.in_process = in_process
+        # Each node also listens on a unix socket here, peers in this process dial it instead of its TCP address
+        self.local_socket_dir = local_socket_dir
+        # Tuning for each node's gRPC server
+        self.server_options = server_options
+        # Given a period, nodes of this schema serve as entry points from samples refreshed this often
+        self.entry_refresh = entry_refresh
+        # Peers every entry point of this schema points joiners on to
+        self.redirects = redirects
+        # Exchanges per second each source may make of a node, with bursts of admission_burst
+        self.admission_rate = admission_rate
+        self.admission_burst = admission_burst
+        # Exchanges a node serves at once, more are refused
+        self.max_in_flight = max_in_flight
+        # Given a batch size, pushes to a node are merged into its view that many at a time, held at most merge_delay
+        self.merge_batch = merge_batch
+        self.merge_delay = merge_delay
+        # Given a seed, each node's view is seeded from it and the node's address, so reruns make the same choices
+        self.seed = seed
         
 
     def gen_node(self, address: str, entry_times: dict[str, int], exit_times: dict[str, int], entry_points: list[str]=[]) -> SimNode:
         log = PandasLog()
-        view = self.view_type(address=address, **self.view_args)
+        view_args = dict(self.view_args)
+        if self.seed is not None:
+            view_args['seed'] = (self.seed * 0x9E3779B97F4A7C15 + zlib.crc32(address.encode())) % (1 << 64)
+        view = self.view_type(address=address, **view_args)
         view.init_selector(self.selector_type, log)
         pss = _gossip.PeerSamplingService(push=self.push, pull=self.pull, 
                                            wait_time=self.wait_time, timeout=self.timeout,
                                            entry_points=entry_points, view=view)
+        if self.scheduler is not None:
+            pss.set_scheduler(self.scheduler)
+        if self.jitter is not None:
+            pss.set_jitter(self.jitter)
+        if self.fanout is not None:
+            pss.set_fanout(self.fanout)
+        if self.min_timeout is not None:
+            pss.set_rtt_tracker(_gossip.RttTracker(min_timeout=self.min_timeout, max_timeout=float(self.timeout)))
+        if self.evict_after is not None:
+            pss.set_failure_detector(_gossip.FailureDetector(suspect_after=max(1, self.evict_after // 2), evict_after=self.evict_after))
+        if self.transport is not None:
+            pss.set_transport(self.transport)
+        elif self.udp:
+            pss.set_transport(_gossip.UdpTransport(address=address))
+        if self.in_process:
+            pss.channel_pool().set_in_process(True)
+        if self.local_socket_dir is not None:
+            local_address = f"unix://{Path(self.local_socket_dir).resolve() / (address.replace(':', '_') + '.sock')}"
+            pss.set_local_address(local_address)
+            pss.add_local_route(address, local_address)
+        if self.server_options is not None:
+            pss.set_server_options(self.server_options)
+        if self.admission_rate is not None or self.max_in_flight is not None:
+            rate = self.admission_rate if self.admission_rate is not None else 0.0
+            burst = self.admission_burst if self.admission_burst is not None else max(1.0, rate)
+            pss.set_admission_control(_gossip.AdmissionControl(rate=rate, burst=burst, max_in_flight=self.max_in_flight or 0))
+        if self.merge_batch is not None:
+            merge_delay = self.merge_delay if self.merge_delay is not None else 0.001
+            pss.set_merge_queue(_gossip.MergeQueue(view=view, batch_size=self.merge_batch, max_delay=merge_delay))
+        if self.entry_refresh is not None:
+            entry_sampler = _gossip.EntrySampler(view=view, refresh=self.entry_refresh)
+            if self.redirects:
+                entry_sampler.set_redirects(self.redirects)
+            pss.set_entry_sampler(entry_sampler)
+        if self.max_streams is not None:
+            pss.set_exchange_streams(_gossip.ExchangeStreamPool(max_streams=self.max_streams))
         return SimNode(self.name, pss, view, log, self.func, entry_times, exit_times)
 
 
@@ -0,0 +1,103 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+namespace gossip {
+
+/* Decides whether a server takes an exchange before any of it is merged, so a looping or misbehaving peer can't
+   hold the view's lock or churn most of the view. Each source gets a token bucket refilled at rate exchanges per
+   second up to burst, and no more than max_in_flight exchanges are served at once across all sources. A rate or
+   max_in_flight of 0 disables that limit. Sources are tracked up to max_sources, once full the least recently seen
+   are dropped if their buckets have refilled, as they are then no different from a source never seen. */
+class AdmissionControl final {
+    public:
+        AdmissionControl(double rate, double burst, std::size_t max_in_flight, std::size_t max_sources=4096)
+                         : _rate(rate), _burst(std::max(burst, 1.0)), _max_in_flight(max_in_flight),
+                         _max_sources(max_sources), _per_host(false), _in_flight(0), _accepted(0), _rejected_rate(0), _rejected_in_flight(0) {}
+
+        // No copying with mutex
+        AdmissionControl(const AdmissionControl& other) = delete;
+
+        /* True takes one of the in flight slots, it must be given back with release() once the exchange is served.
+           An empty source is only held to the in flight cap. */
+        bool admit(const std::string& source);
+        void release();
+
+        std::size_t in_flight() const { return _in_flight; }
+        uint64_t accepted() const { return _accepted; }
+        uint64_t rejected() const { return _rejected_rate + _rejected_in_flight; }
+        uint64_t rejected_rate() const { return _rejected_rate; }
+        uint64_t rejected_in_flight() const { return _rejected_in_flight; }
+
+        std::size_t size() const;
+        double rate() const { return _rate; }
+        double burst() const { return _burst; }
+        std::size_t max_in_flight() const { return _max_in_flight; }
+
+        /* Sources are peers by default, host and port, so virtual nodes sharing a machine are limited apart. Over gRPC
+           the port is the client's end of its connection, a peer opening more connections gets more buckets. Per host
+           every connection from one machine shares a bucket. Applied by the server admitting, see Server::serve. */
+        void set_per_host(bool per_host) { _per_host = per_host; }
+        bool per_host() const { return _per_host; }
+
+        std::string print() const;
+
+        friend std::ostream& operator<<(std::ostream& os, const AdmissionControl& obj) {
+            os << obj.print();
+            return os;
+        }
+
+    private:
+        struct Bucket {
+            std::string source;
+            double tokens;
+            std::chrono::steady_clock::time_point last_refill;
+        };
+
+        mutable std::mutex _lock;
+        std::list<Bucket> _lru; // Front is most recently seen
+        std::unordered_map<std::string, std::list<Bucket>::iterator> _buckets;
+        const double _rate;
+        const double _burst;
+        const std::size_t _max_in_flight;
+        const std::size_t _max_sources;
+        std::atomic<bool> _per_host;
+
+        std::atomic<std::size_t> _in_flight;
+        std::atomic<uint64_t> _accepted;
+        std::atomic<uint64_t> _rejected_rate;
+        std::atomic<uint64_t> _rejected_in_flight;
+
+        bool take_token(const std::string& source);
+        bool refilled(const Bucket& bucket, std::chrono::steady_clock::time_point now) const;
+        void remove_refilled(std::chrono::steady_clock::time_point now);
+};
+
+}
@@ -0,0 +1,102 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include <grpcpp/grpcpp.h>
+
+#include "gossip.grpc.pb.h"
+
+namespace gossip {
+
+/* Process wide cache of channels keyed by peer address so consecutive exchanges reuse the same HTTP/2 connection.
+   Least recently used channels are dropped when the pool is full or when they have sat idle past the timeout.
+   Dropped channels are retired rather than destroyed, an exchange still in flight on one must not release the last
+   reference from inside its own completion callback. Retired channels are released once no exchange holds them, on
+   the next acquire, idle sweep or clear.
+   Channels are dialed through LocalChannels, so a peer with a local route is reached over its local target and, with
+   in_process set, a peer hosted in this same process over an in-process channel. */
+class ChannelPool final {
+    public:
+        ChannelPool(std::size_t max_channels, std::chrono::milliseconds idle_timeout) 
+                    : _max_channels(max_channels), _idle_timeout(idle_timeout), _in_process(false) {}
+
+        ~ChannelPool();
+
+        // No copying with mutex
+        ChannelPool(const ChannelPool& other) = delete;
+
+        static std::shared_ptr<ChannelPool> global();
+
+        std::shared_ptr<GossipProtocol::Stub> stub(const std::string& address);
+        std::shared_ptr<::grpc::Channel> channel(const std::string& address);
+
+        /* Reach servers hosted in this process through in-process channels, applies to channels made from now on */
+        void set_in_process(bool in_process) { _in_process = in_process; }
+        bool in_process() const { return _in_process; }
+
+        void evict(const std::string& address);
+        void clear();
+
+        bool contains(const std::string& address) const;
+        std::size_t size() const;
+        std::size_t max_channels() const { return _max_channels; }
+        std::chrono::milliseconds idle_timeout() const { return _idle_timeout; }
+
+        std::string print() const;
+
+        friend std::ostream& operator<<(std::ostream& os, const ChannelPool& obj) {
+            os << obj.print();
+            return os;
+        }
+
+    private:
+        struct Entry {
+            std::string address;
+            std::shared_ptr<::grpc::Channel> channel;
+            std::shared_ptr<GossipProtocol::Stub> stub;
+            std::chrono::steady_clock::time_point last_used;
+            uint64_t local_id; // LocalChannels id of the server an in-process channel leads to, 0 otherwise
+        };
+
+        mutable std::mutex _lock;
+        std::list<Entry> _lru; // Front is most recently used
+        std::unordered_map<std::string, std::list<Entry>::iterator> _lut;
+        std::list<Entry> _retired;
+        const std::size_t _max_channels;
+        const std::chrono::milliseconds _idle_timeout;
+        std::atomic<bool> _in_process;
+
+        std::list<Entry>::iterator acquire(const std::string& address);
+        void remove_idle(std::chrono::steady_clock::time_point now);
+        void remove_lru();
+        void retire(std::list<Entry>::iterator entry);
+        void release_retired();
+};
+
+}
@@ -25,6 +25,11 @@
 #include <thread>
 #include <future>
 #include <atomic>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
 
 #include <grpcpp/grpcpp.h>
 
@@ -32,41 +37,77 @@
 #include "gossip.grpc.pb.h"
 
 #include "view.h"
+#include "channel_pool.h"
+#include "scheduler.h"
+#include "rtt_tracker.h"
+#include "failure_detector.h"
+#include "exchange_stream.h"
+#include "transport.h"
 
 
 namespace gossip {
 
-class ClientSession final {
+/* One asynchronous exchange with a peer. Must be made from a shared ptr, the completion callback holds a
+   reference so the context and buffers live until the RPC finishes. The response is handed to done, merging it into
+   a view is left to the caller. */
+class ClientSession final : public std::enable_shared_from_this<ClientSession> {
     public:
-        ClientSession(std::shared_ptr<View> view, std::string server_address, unsigned int timeout) 
-                            :_server_address(server_address), _timeout(timeout), _view(view), 
-                            _stub(GossipProtocol::NewStub(grpc::CreateChannel(server_address, grpc::InsecureChannelCredentials()))) {}
+        using Callback = std::function<void(::grpc::Status)>;
+        /* The response view is empty on a push and only meaningful when the status is OK */
+        using Received = std::function<void(::grpc::Status, const ViewProto&)>;
+
+        ClientSession(std::string server_address, std::chrono::milliseconds timeout, std::shared_ptr<ChannelPool> channel_pool) 
+                            :_timeout(timeout), _server_address(server_address), 
+                            _stub(channel_pool->stub(server_address)) {}
         
-        ::grpc::Status push_view(const ViewProto& tx_buf, std::shared_ptr<::google::protobuf::Empty> dummy_resp);
-        ::grpc::Status pull_view(const ::google::protobuf::Empty& dummy_req, std::shared_ptr<ViewProto> rx_buf);
-        ::grpc::Status push_pull_view(const ViewProto& tx_buf, std::shared_ptr<ViewProto> rx_buf);
+        void push_view(std::shared_ptr<ViewProto> tx_buf, Received done);
+        void pull_view(Received done);
+        void push_pull_view(std::shared_ptr<ViewProto> tx_buf, Received done);
+
+        const std::string& server_address() const { return _server_address; }
+
+        static void merge(std::shared_ptr<View> view, const ViewProto& rx_buf, bool age);
 
     private:
-        const unsigned int _timeout;
+        const std::chrono::milliseconds _timeout;
         const std::string _server_address;
-        std::shared_ptr<View> _view;
-        std::unique_ptr<GossipProtocol::Stub> _stub;
+        std::shared_ptr<GossipProtocol::Stub> _stub;
+
+        ::grpc::ClientContext _context;
+        std::shared_ptr<ViewProto> _tx_buf;
+        ViewProto _rx_buf;
+        ::google::protobuf::Empty _empty_req;
+        ::google::protobuf::Empty _empty_resp;
+
+        void set_deadline();
 };
 
 
 /* This class must always be made from a shared ptr and is wrapped that way in gossip_peer_sampling_service */
 class Client final : public std::enable_shared_from_this<Client>{
     public:
+        using Callback = ClientSession::Callback;
+
+        Client(bool push, bool pull, std::chrono::milliseconds wait_time, 
+                             std::chrono::milliseconds timeout, std::shared_ptr<View> view,
+                             std::shared_ptr<ChannelPool> channel_pool=nullptr) 
+                            : _name("Gossip Protocol Client"), _push(push), _pull(pull), 
+                            _wait_time(wait_time), _jitter(0), _timeout(timeout), _fanout(1), _view(view),
+                            _channel_pool(channel_pool ? channel_pool : ChannelPool::global()),
+                            _max_in_flight(16), _in_flight(0) {}
+
         Client(bool push, bool pull, unsigned int wait_time, 
-                             unsigned int timeout, std::shared_ptr<View> view) 
-                            : _push(push), _pull(pull), _view(view), 
-                            _wait_time(wait_time), _timeout(timeout),
-                            _name("Gossip Protocol Client") {}
+                             unsigned int timeout, std::shared_ptr<View> view,
+                             std::shared_ptr<ChannelPool> channel_pool=nullptr) 
+                            : Client(push, pull, std::chrono::seconds(wait_time), std::chrono::seconds(timeout), view, channel_pool) {}
 
+        /* Runs one gossip round per period on its own timeline, a slow or dead peer never delays the next round.
+           Given a scheduler the rounds are driven by its shared workers and no thread is created. 
+           stop() and signal() wake the thread immediately rather than waiting out the period. */
         class Thread {
             public:
-                Thread(std::shared_ptr<Client> client)
-                       :_client(client) , _active(false) {}
+                Thread(std::shared_ptr<Client> client, std::shared_ptr<Scheduler> scheduler=nullptr)
+                       :_client(client), _scheduler(scheduler), _task_id(0), _active(false) {}
 
                 ~Thread();
                 void start();
@@ -75,10 +116,15 @@ class Client final : public std::enable_shared_from_this<Client>{
 
             private:
                 std::shared_ptr<Client> _client;
+                std::shared_ptr<Scheduler> _scheduler;
+                Scheduler::TaskId _task_id;
                 std::thread _thread;
+                std::mutex _lock;
+                std::condition_variable _wake;
                 std::atomic<bool> _active;
         };
 
+        /* Blocking, wait for the exchange to complete */
         grpc::Status push_view();
         grpc::Status pull_view();
         grpc::Status push_pull_view();
@@ -87,14 +133,100 @@ class Client final : public std::enable_shared_from_this<Client>{
         grpc::Status pull_view(std::string address);
         grpc::Status push_pull_view(std::string address);
 
-        std::shared_ptr<Client::Thread> thread() { return std::make_shared<Thread>(shared_from_this()); }
+        /* Non blocking, done is invoked from a gRPC thread once the exchange completes or is rejected */
+        void async_push_view(Callback done=nullptr);
+        void async_pull_view(Callback done=nullptr);
+        void async_push_pull_view(Callback done=nullptr);
+
+        void async_push_view(const std::string& address, Callback done=nullptr);
+        void async_pull_view(const std::string& address, Callback done=nullptr);
+        void async_push_pull_view(const std::string& address, Callback done=nullptr);
+
+        /* One gossip round, exchanges concurrently with up to fanout distinct peers and ages the view once. done is invoked
+           after the last exchange of the round completes, with OK if any of them succeeded. */
+        void async_gossip_round(Callback done=nullptr);
+
+        void set_fanout(unsigned int fanout) { _fanout = std::max(fanout, 1u); }
+        unsigned int fanout() const { return _fanout; }
+
+        /* Each round is spaced wait_time +/- a uniformly random offset of up to jitter, set before starting a thread */
+        void set_jitter(std::chrono::milliseconds jitter) { 
+            // A round is never due straight after the previous one
+            _jitter = std::max(std::min(jitter, _wait_time - std::chrono::milliseconds(1)), std::chrono::milliseconds(0));
+        }
+        std::chrono::milliseconds jitter() const { return _jitter; }
+        std::chrono::milliseconds wait_time() const { return _wait_time; }
+
+        /* Given a tracker each exchange's deadline adapts to the peer's measured round trip time, timeout() then only
+           bounds it from above. nullptr, the default, uses timeout() for every exchange. */
+        void set_rtt_tracker(std::shared_ptr<RttTracker> rtt_tracker) { std::atomic_store(&_rtt_tracker, rtt_tracker); }
+        std::shared_ptr<RttTracker> rtt_tracker() const { return std::atomic_load(&_rtt_tracker); }
+        std::chrono::milliseconds timeout() const { return _timeout; }
+        std::chrono::milliseconds timeout(const std::string& address) const;
+
+        /* Given a detector peers that keep failing to answer are passed over when choosing whom to gossip with, and once
+           dead are removed from the view and their channel dropped. nullptr, the default, leaves the view to age them out. */
+        void set_failure_detector(std::shared_ptr<FailureDetector> failure_detector) { std::atomic_store(&_failure_detector, failure_detector); }
+        std::shared_ptr<FailureDetector> failure_detector() const { return std::atomic_load(&_failure_detector); }
+
+        /* Given a pool each peer is exchanged with over a persistent stream, kept open while the peer stays among the pool's
+           most recently contacted. Peers whose server has no stream fall back to the unary RPCs. nullptr, the default,
+           makes every exchange its own unary RPC. */
+        void set_exchange_streams(std::shared_ptr<ExchangeStreamPool> exchange_streams) { std::atomic_store(&_exchange_streams, exchange_streams); }
+        std::shared_ptr<ExchangeStreamPool> exchange_streams() const { return std::atomic_load(&_exchange_streams); }
+
+        /* Given a transport every exchange is carried by it instead of gRPC, exchange streams are then unused.
+           nullptr, the default, exchanges over gRPC. */
+        void set_transport(std::shared_ptr<Transport> transport) { std::atomic_store(&_transport, transport); }
+        std::shared_ptr<Transport> transport() const { return std::atomic_load(&_transport); }
+
+        /* Exchanges started past max_in_flight fail straight away with RESOURCE_EXHAUSTED. The default of 16 covers a
+           round's fanout several times over, so rounds that overlap behind slow peers still go out, while a stalled
+           network can't pile up unbounded calls. enter() paces its entry points to stay within it */
+        void set_max_in_flight(unsigned int max_in_flight) { _max_in_flight = max_in_flight; }
+        unsigned int max_in_flight() const { return _max_in_flight; }
+        unsigned int in_flight() const { return _in_flight; }
+
+        std::shared_ptr<Client::Thread> thread(std::shared_ptr<Scheduler> scheduler=nullptr) { return std::make_shared<Thread>(shared_from_this(), scheduler); }
+        std::shared_ptr<ChannelPool> channel_pool() { return _channel_pool; }
     private:
         const std::string _name;
         const bool _push;
         const bool _pull;
-        const unsigned int _wait_time;
-        const unsigned int _timeout;
+        const std::chrono::milliseconds _wait_time;
+        std::chrono::milliseconds _jitter;
+        const std::chrono::milliseconds _timeout;
+        std::shared_ptr<RttTracker> _rtt_tracker;
+        std::shared_ptr<FailureDetector> _failure_detector;
+        std::shared_ptr<ExchangeStreamPool> _exchange_streams;
+        std::shared_ptr<Transport> _transport;
+        std::atomic<unsigned int> _fanout;
         std::shared_ptr<View> _view;
+        std::shared_ptr<ChannelPool> _channel_pool;
+        std::atomic<unsigned int> _max_in_flight;
+        std::atomic<unsigned int> _in_flight;
+
+        enum class Exchange { PUSH, PULL, PUSH_PULL };
+
+        void gossip_round();
+        void async_exchange(Exchange type, const std::string& address, bool age, Callback done);
+        std::shared_ptr<ViewProto> make_tx_buffer(Exchange type);
+        /* Takes a slot already acquired, released when done is called */
+        void send_exchange(Exchange type, const std::string& address, std::shared_ptr<ViewProto> tx_buffer, bool age, Callback done);
+        void unary_exchange(Exchange type, const std::string& address, std::shared_ptr<ViewProto> tx_buf, Transport::Callback done);
+        Transport::Callback merge(Exchange type, bool age, Callback done);
+        static ExchangeRequest::Type request_type(Exchange type);
+        void stream_exchange(std::shared_ptr<ExchangeStreamPool> exchange_streams, Exchange type, const std::string& address,
+                             std::shared_ptr<ViewProto> tx_buf, Transport::Callback done);
+        Exchange exchange_type() const;
+        std::vector<std::string> select_peers(unsigned int count);
+        std::chrono::milliseconds next_wait_time() const;
+        bool acquire_slot();
+        /* Takes the RTT sample as the response arrives, before done merges it */
+        Transport::Callback measure(const std::string& address, Transport::Callback done);
+        Callback complete(const std::string& address, Callback done);
+        void track_failure(const std::string& address, const ::grpc::Status& status);
+        static ::grpc::Status wait(std::function<void(Callback)> start);
 };
 
 }
\ No newline at end of file
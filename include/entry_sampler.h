@@ -0,0 +1,102 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "gossip.pb.h"
+
+#include "view.h"
+#include "scheduler.h"
+
+namespace gossip {
+
+/* Entry point mode for a Server that a whole fleet joins through at once. Rather than shuffling and merging into
+   the view under its lock on every exchange, the server hands out one of num_samples random samples of the view
+   precomputed each refresh, read without any lock, and admits the descriptors pushed to it through a reservoir of
+   reservoir_size sampled uniformly from everything pushed since the last refresh. Each refresh merges the reservoir
+   into the view in one go, ages the view once and draws fresh samples. Samples are as large as an exchange but are
+   drawn without reordering the view, which swaps and healing evict by. Redirects, other peers the entry point wants
+   joiners to spread out to, are added to every sample. Must be made from a shared ptr. */
+class EntrySampler final : public std::enable_shared_from_this<EntrySampler> {
+    public:
+        EntrySampler(std::shared_ptr<View> view, std::chrono::milliseconds refresh=std::chrono::milliseconds(100),
+                     std::size_t num_samples=16, std::size_t reservoir_size=256, std::shared_ptr<Scheduler> scheduler=nullptr)
+                     : _view(view), _selector(view->create_subscriber(SelectorType::UNIFORM_RANDOM)), _refresh(refresh), _num_samples(std::max<std::size_t>(num_samples, 1)),
+                     _reservoir_size(reservoir_size), _scheduler(scheduler ? scheduler : Scheduler::global()),
+                     _samples(std::make_shared<const std::vector<ViewProto>>()),
+                     _redirects(std::make_shared<const std::vector<std::string>>()),
+                     _next(0), _eng(std::random_device{}()), _seen(0), _offered(0), _task(0) {}
+
+        ~EntrySampler();
+
+        // No copying with mutex
+        EntrySampler(const EntrySampler& other) = delete;
+
+        /* Draws the first samples and refreshes them periodically on the scheduler */
+        void start();
+        void stop();
+        void refresh();
+
+        /* Both are called on the serving path, neither takes the view's lock */
+        void sample(ViewProto& response) const;
+        void admit(const ViewProto& request);
+
+        /* Takes effect on the next refresh */
+        void set_redirects(const std::vector<std::string>& redirects);
+        std::vector<std::string> redirects() const { return *std::atomic_load(&_redirects); }
+
+        bool active() const;
+        std::size_t reservoir() const;
+        /* Descriptors pushed to the entry point since it was made, whether or not the reservoir kept them */
+        uint64_t offered() const { return _offered; }
+        std::chrono::milliseconds refresh_interval() const { return _refresh; }
+        std::size_t num_samples() const { return _num_samples; }
+        std::size_t reservoir_size() const { return _reservoir_size; }
+
+    private:
+        std::shared_ptr<View> _view;
+        std::shared_ptr<View::PeerSelector> _selector;
+        const std::chrono::milliseconds _refresh;
+        const std::size_t _num_samples;
+        const std::size_t _reservoir_size;
+        std::shared_ptr<Scheduler> _scheduler;
+
+        std::shared_ptr<const std::vector<ViewProto>> _samples;
+        std::shared_ptr<const std::vector<std::string>> _redirects;
+        mutable std::atomic<uint64_t> _next;
+
+        mutable std::mutex _lock;
+        std::mt19937 _eng;
+        ViewProto _reservoir;
+        uint64_t _seen; // Pushed since the last refresh
+        std::atomic<uint64_t> _offered;
+        Scheduler::TaskId _task;
+};
+
+}
@@ -0,0 +1,149 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <list>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <mutex>
+#include <chrono>
+
+#include <grpcpp/grpcpp.h>
+
+#include "gossip.pb.h"
+#include "gossip.grpc.pb.h"
+
+#include "channel_pool.h"
+#include "scheduler.h"
+
+namespace gossip {
+
+/* A long lived Exchange stream to one peer. Any number of exchanges are multiplexed over it, each tagged with an id
+   the server echoes back, and each bounded by its own deadline rather than the stream's. Must be made from a shared
+   ptr through create(), the stream holds a reference to itself until gRPC is done with it. */
+class ExchangeStream final : public ::grpc::ClientBidiReactor<ExchangeRequest, ExchangeResponse>,
+                             public std::enable_shared_from_this<ExchangeStream> {
+    public:
+        /* The response view is only meaningful when the status is OK */
+        using Callback = std::function<void(::grpc::Status, const ViewProto&)>;
+        using Closed = std::function<void(ExchangeStream*, const ::grpc::Status&)>;
+
+        static std::shared_ptr<ExchangeStream> create(std::shared_ptr<GossipProtocol::Stub> stub, 
+                                                      std::shared_ptr<Scheduler> scheduler, Closed closed=nullptr);
+
+        ExchangeStream(std::shared_ptr<GossipProtocol::Stub> stub, std::shared_ptr<Scheduler> scheduler, Closed closed)
+                       : _stub(stub), _scheduler(scheduler), _closed(closed), _next_id(1), _writing(false), _done(false) {}
+
+        /* tx_buf is unused on a pull. done is invoked exactly once, from a gRPC or scheduler thread. */
+        void exchange(ExchangeRequest::Type type, std::shared_ptr<ViewProto> tx_buf, std::chrono::milliseconds timeout, Callback done);
+        /* Cancels the stream, exchanges still waiting on it complete with CANCELLED */
+        void close();
+
+        bool done() const;
+        std::size_t pending() const;
+
+        void OnReadDone(bool ok) override;
+        void OnWriteDone(bool ok) override;
+        void OnDone(const ::grpc::Status& status) override;
+
+    private:
+        struct Pending {
+            Callback done;
+            Scheduler::TaskId timer;
+        };
+
+        std::shared_ptr<GossipProtocol::Stub> _stub;
+        // Weak, the stream is released from a scheduler task and must not be what destroys the scheduler there
+        std::weak_ptr<Scheduler> _scheduler;
+        Closed _closed;
+        std::shared_ptr<ExchangeStream> _self;
+
+        ::grpc::ClientContext _context;
+        ExchangeResponse _rx_buf;
+
+        mutable std::mutex _lock;
+        uint64_t _next_id;
+        std::unordered_map<uint64_t, Pending> _pending;
+        std::deque<ExchangeRequest> _writes; // Front is the write in flight
+        bool _writing;
+        bool _done;
+
+        void start();
+        void expire(uint64_t id);
+};
+
+
+/* Keeps a stream open to each of the most recently contacted peers, up to max_streams, closing the least recently
+   used past that. Peers that answer a stream with UNIMPLEMENTED run an older server and are remembered as unary only,
+   exchanges with them are left to the unary RPCs. */
+class ExchangeStreamPool final {
+    public:
+        using Callback = ExchangeStream::Callback;
+
+        ExchangeStreamPool(std::shared_ptr<ChannelPool> channel_pool, std::size_t max_streams=64,
+                           std::shared_ptr<Scheduler> scheduler=nullptr)
+                           : _channel_pool(channel_pool ? channel_pool : ChannelPool::global()), _max_streams(max_streams),
+                           _scheduler(scheduler ? scheduler : Scheduler::global()), 
+                           _state(std::make_shared<State>()) {}
+
+        ~ExchangeStreamPool();
+
+        // No copying with mutex
+        ExchangeStreamPool(const ExchangeStreamPool& other) = delete;
+
+        void exchange(const std::string& address, ExchangeRequest::Type type, std::shared_ptr<ViewProto> tx_buf,
+                      std::chrono::milliseconds timeout, Callback done);
+
+        bool unary_only(const std::string& address) const;
+        bool contains(const std::string& address) const;
+        std::size_t size() const;
+        std::size_t max_streams() const { return _max_streams; }
+
+        void close(const std::string& address);
+        void clear();
+
+    private:
+        struct Entry {
+            std::string address;
+            std::shared_ptr<ExchangeStream> stream;
+        };
+
+        /* Outlives the pool, streams closing after it is destroyed still report in here */
+        struct State {
+            std::mutex lock;
+            std::list<Entry> lru; // Front is most recently used
+            std::unordered_map<std::string, std::list<Entry>::iterator> lut;
+            std::unordered_set<std::string> unary_only;
+        };
+
+        std::shared_ptr<ChannelPool> _channel_pool;
+        const std::size_t _max_streams;
+        std::shared_ptr<Scheduler> _scheduler;
+        std::shared_ptr<State> _state;
+
+        std::shared_ptr<ExchangeStream> acquire(const std::string& address, std::vector<std::shared_ptr<ExchangeStream>>& evicted);
+};
+
+}
@@ -0,0 +1,85 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+namespace gossip {
+
+/* Counts consecutive failed exchanges per peer address. A peer is suspected once it reaches suspect_after failures in a
+   row and should be deprioritized, at evict_after it is considered dead and should be removed from the view. Any
+   successful exchange clears the peer. Tracking is bounded, the least recently updated peer is dropped when full. */
+class FailureDetector final {
+    public:
+        enum class State {
+            ALIVE = 0,
+            SUSPECT = 1,
+            DEAD = 2,
+        };
+
+        FailureDetector(unsigned int suspect_after=2, unsigned int evict_after=4, std::size_t max_peers=1024)
+                        : _suspect_after(std::max(suspect_after, 1u)), _evict_after(std::max(evict_after, _suspect_after)),
+                        _max_peers(max_peers) {}
+
+        // No copying with mutex
+        FailureDetector(const FailureDetector& other) = delete;
+
+        void record_success(const std::string& address);
+        State record_failure(const std::string& address);
+        void forget(const std::string& address);
+
+        State state(const std::string& address) const;
+        bool suspected(const std::string& address) const { return state(address) != State::ALIVE; }
+        unsigned int failures(const std::string& address) const;
+
+        std::size_t size() const;
+        unsigned int suspect_after() const { return _suspect_after; }
+        unsigned int evict_after() const { return _evict_after; }
+
+        std::string print() const;
+
+        friend std::ostream& operator<<(std::ostream& os, const FailureDetector& obj) {
+            os << obj.print();
+            return os;
+        }
+
+    private:
+        struct Peer {
+            unsigned int failures;
+            std::chrono::steady_clock::time_point last_failure;
+        };
+
+        mutable std::mutex _lock;
+        std::unordered_map<std::string, Peer> _peers;
+        const unsigned int _suspect_after;
+        const unsigned int _evict_after;
+        const std::size_t _max_peers;
+
+        State to_state(unsigned int failures) const;
+        void remove_lru();
+};
+
+}
@@ -0,0 +1,75 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+#include <grpcpp/grpcpp.h>
+
+namespace gossip {
+
+/* Process wide directory of fast paths to co-located nodes, consulted by ChannelPool when it dials a peer.
+   Every gRPC server hosted in this process is listed under the addresses it serves, so a pool that allows it can
+   reach them through an in-process channel with no socket at all. Routes map the address a peer advertises, usually
+   TCP, to a target it also listens on locally, such as its unix:///path socket, for peers in other processes on
+   this host. Addresses without a route are dialed as given. */
+class LocalChannels final {
+    public:
+        LocalChannels() : _next_id(1) {}
+
+        // No copying with mutex
+        LocalChannels(const LocalChannels& other) = delete;
+
+        static LocalChannels& global();
+
+        /* Returns the id the server is listed under, removing it only succeeds with the same id. The server must be
+           removed before it is shut down. */
+        uint64_t add_server(const std::string& address, ::grpc::Server* server);
+        void remove_server(const std::string& address, uint64_t id);
+        /* In-process channel to the server hosted at address and its id, nullptr and 0 if none is */
+        std::shared_ptr<::grpc::Channel> in_process_channel(const std::string& address, uint64_t& id);
+        /* False once the server listed under id at address has been removed */
+        bool hosts(const std::string& address, uint64_t id) const;
+
+        void add_route(const std::string& address, const std::string& target);
+        void remove_route(const std::string& address);
+        /* The local target for address, address itself when there is no route */
+        std::string route(const std::string& address) const;
+
+        std::size_t num_servers() const;
+        std::size_t num_routes() const;
+
+    private:
+        struct Hosted {
+            ::grpc::Server* server;
+            uint64_t id;
+        };
+
+        mutable std::mutex _lock;
+        uint64_t _next_id;
+        std::unordered_map<std::string, Hosted> _servers;
+        std::unordered_map<std::string, std::string> _routes;
+};
+
+}
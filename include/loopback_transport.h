@@ -0,0 +1,62 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include "transport.h"
+#include "server.h"
+
+namespace gossip {
+
+/* Delivers exchanges between Servers in this one process by calling straight into them, with no sockets, framing or
+   serialization. Any number of nodes can share one, addresses are only names. Exchanges complete on the calling
+   thread before exchange() returns, so the timeout is never reached. An address nobody serves is UNAVAILABLE. */
+class LoopbackTransport final : public Transport {
+    public:
+        LoopbackTransport() : _exchanges(0) {}
+
+        // No copying with mutex
+        LoopbackTransport(const LoopbackTransport& other) = delete;
+
+        void exchange(const std::string& address, ExchangeRequest::Type type, std::shared_ptr<ViewProto> tx_buf,
+                      std::chrono::milliseconds timeout, Callback done) override;
+
+        bool serve(std::shared_ptr<Server> server) override;
+        void unserve(const std::string& address) override;
+
+        bool serving(const std::string& address) const;
+        std::size_t size() const;
+        /* Exchanges delivered to a server since construction */
+        uint64_t exchanges() const { return _exchanges; }
+
+    private:
+        mutable std::mutex _lock;
+        std::unordered_map<std::string, std::shared_ptr<Server>> _servers;
+        std::atomic<uint64_t> _exchanges;
+};
+
+}
@@ -0,0 +1,94 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "gossip.pb.h"
+
+#include "view.h"
+
+namespace gossip {
+
+/* Coalesces the views pushed to a server so the view's lock is taken once per batch rather than twice per exchange.
+   Serving threads push onto a lock free stack and return, a single merger thread takes everything queued once
+   batch_size views have arrived or max_delay has passed since the first of them, and merges it with View::merge,
+   one lock, one eviction pass and one age step for the batch. Pulls only ask for the next age step. Beyond
+   max_pending views waiting the newest are dropped, gossip tolerates a lost push. */
+class MergeQueue final {
+    public:
+        MergeQueue(std::shared_ptr<View> view, std::size_t batch_size=64,
+                   std::chrono::microseconds max_delay=std::chrono::microseconds(1000), std::size_t max_pending=4096);
+        ~MergeQueue();
+
+        // No copying with mutex
+        MergeQueue(const MergeQueue& other) = delete;
+
+        /* False if the push was dropped */
+        bool push(const ViewProto& view);
+        void age();
+        /* Merges whatever is queued now, on the calling thread */
+        void flush();
+
+        std::size_t pending() const { return _pending; }
+        uint64_t merged() const { return _merged; }
+        uint64_t batches() const { return _batches; }
+        uint64_t dropped() const { return _dropped; }
+        std::size_t batch_size() const { return _batch_size; }
+        std::chrono::microseconds max_delay() const { return _max_delay; }
+        std::size_t max_pending() const { return _max_pending; }
+
+    private:
+        struct Node {
+            ViewProto view;
+            Node* next;
+        };
+
+        std::shared_ptr<View> _view;
+        const std::size_t _batch_size;
+        const std::chrono::microseconds _max_delay;
+        const std::size_t _max_pending;
+
+        std::atomic<Node*> _head;
+        std::atomic<std::size_t> _pending;
+        std::atomic<bool> _age_pending;
+        std::atomic<uint64_t> _merged;
+        std::atomic<uint64_t> _batches;
+        std::atomic<uint64_t> _dropped;
+
+        std::mutex _lock; // One batch merged at a time
+        std::mutex _sleep_lock;
+        std::condition_variable _cv;
+        bool _active;
+        std::thread _merger;
+
+        void wake();
+        void run_merger();
+        void merge_batch();
+};
+
+}
@@ -20,6 +20,8 @@
 #pragma once
 
 #include <string>
+#include <memory>
+#include <atomic>
 #include <stdint.h>
 
 #include "gossip.pb.h"
@@ -30,6 +32,7 @@ class NodeDescriptor {
     public:
         NodeDescriptor(std::string address, uint32_t age) : _address(address), _age(age) {}
         NodeDescriptor(const NodeDescriptorProto& proto) : _address(proto.address()), _age(proto.age()) {}
+        NodeDescriptor(const NodeDescriptor& other) : _address(other._address), _age(other._age.load()), _clock(other._clock) {}
 
         const void make_proto(NodeDescriptorProto* out_proto) const;
 
@@ -41,11 +44,23 @@ class NodeDescriptor {
         }
 
         const std::string& address() const { return _address; }
-        uint32_t& age() { return _age; }
+        uint32_t age() const;
+        void set_age(uint32_t age);
+
+        /* Ages with clock from here on, a view's logical clock that it bumps once per increment_age, keeping the
+           current age. Detaching freezes it again, and is safe alongside readers of age() */
+        void attach(std::shared_ptr<const std::atomic<uint32_t>> clock);
+        void detach();
+        bool attached() const { return _age.load(std::memory_order_relaxed) & ATTACHED; }
 
     private:
+        static constexpr uint64_t ATTACHED = uint64_t(1) << 32;
+
         std::string _address;
-        uint32_t _age; 
+        // The age, or while ATTACHED the clock's value at age 0, which wraps with it. One word so detach can't tear it
+        std::atomic<uint64_t> _age;
+        // Kept after detach, only attach replaces it
+        std::shared_ptr<const std::atomic<uint32_t>> _clock;
 };
 
 }
\ No newline at end of file
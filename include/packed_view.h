@@ -0,0 +1,182 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <memory>
+#include <random>
+#include <mutex>
+
+#include "node_descriptor.h"
+#include "view.h"
+#include "rng.h"
+
+namespace gossip {
+
+/* Same protocol as URView, but addresses are interned to dense 32 bit ids and the view is kept as parallel arrays of
+   ids and ages, so shuffles, age scans and evictions run over contiguous integers rather than descriptors on the heap.
+   Descriptors are only built at the edges: tx_nodes, select_peer and print hand out copies */
+class PackedView final : public View, public std::enable_shared_from_this<PackedView> {
+    public:
+
+        PackedView(std::string address, int size, int healing, int swap);
+        /* Every random choice follows from seed, as with URView */
+        PackedView(std::string address, int size, int healing, int swap, uint64_t seed);
+
+        // No copying with mutex
+        PackedView(const PackedView& other) = delete;
+
+        void init_selector(SelectorType type, std::shared_ptr<TSLog> log=nullptr) override;
+
+        std::shared_ptr<NodeDescriptor> select_peer() override;
+        std::size_t select_peers(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) override;
+        std::vector<std::shared_ptr<NodeDescriptor>> tx_nodes() override;
+        void rx_nodes(std::vector<std::shared_ptr<NodeDescriptor>>& nodes) override;
+        void increment_age() override;
+        /* Under one lock */
+        void merge(std::vector<std::shared_ptr<NodeDescriptor>>& nodes) override;
+
+        const std::shared_ptr<NodeDescriptor> self() const override { return _self; }
+        int max_size() const;
+        bool contains(std::string address) const override;
+
+        int size() const override { return _size; }
+        int healing() const { return _healing; }
+        int swap() const { return _swap; }
+        uint64_t seed() const { return _seed; }
+        /* Ids handed out so far, including self and ids free for reuse */
+        std::size_t num_ids() const;
+
+        std::string print() const override;
+
+        /* Base of the selectors below, told of ids entering and leaving the view under the view's lock */
+        class IdPeerSelector : public virtual View::PeerSelector {
+            public:
+                IdPeerSelector(std::shared_ptr<PackedView> view) : _view(view) {}
+                virtual void on_add(uint32_t) {}
+                virtual void on_remove(uint32_t) {}
+            protected:
+                std::shared_ptr<PackedView> _view;
+        };
+
+        class TailPeerSelector : public IdPeerSelector {
+            public:
+                TailPeerSelector(std::shared_ptr<PackedView> view) : IdPeerSelector(view) {}
+                std::shared_ptr<NodeDescriptor> select_peer_impl() override;
+                std::size_t select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) override;
+
+                std::string print() const override;
+        };
+
+        struct LoggedTailPeerSelector : public TailPeerSelector, public View::LoggedPeerSelector {
+            LoggedTailPeerSelector(std::shared_ptr<PackedView> view, std::shared_ptr<TSLog> log=nullptr) : TailPeerSelector(view), View::LoggedPeerSelector(log, view->self()->address()) {}
+        };
+
+        class URPeerSelector : public IdPeerSelector {
+            public:
+                URPeerSelector(std::shared_ptr<PackedView> view) : IdPeerSelector(view) {}
+                std::shared_ptr<NodeDescriptor> select_peer_impl() override;
+                std::size_t select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) override;
+
+                std::string print() const override;
+        };
+
+        struct LoggedURPeerSelector : public URPeerSelector, public View::LoggedPeerSelector {
+            LoggedURPeerSelector(std::shared_ptr<PackedView> view, std::shared_ptr<TSLog> log=nullptr) : URPeerSelector(view), View::LoggedPeerSelector(log, view->self()->address()) {}
+        };
+
+        /* Each id added is drawn once, at random, before falling back to uniform random selection */
+        class URNRPeerSelector : public IdPeerSelector {
+            public:
+                URNRPeerSelector(std::shared_ptr<PackedView> view);
+                std::shared_ptr<NodeDescriptor> select_peer_impl() override;
+                std::size_t select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) override;
+                void on_add(uint32_t id) override;
+                void on_remove(uint32_t id) override;
+
+                std::string print() const override;
+            private:
+                std::vector<uint32_t> _unselected;
+                std::vector<int32_t> _positions; // id -> index in _unselected, -1 if not in it
+        };
+
+        struct LoggedURNRPeerSelector : public URNRPeerSelector, public View::LoggedPeerSelector {
+            LoggedURNRPeerSelector(std::shared_ptr<PackedView> view, std::shared_ptr<TSLog> log=nullptr) : URNRPeerSelector(view), View::LoggedPeerSelector(log, view->self()->address()) {}
+        };
+
+        std::shared_ptr<PeerSelector> create_subscriber(SelectorType type, std::shared_ptr<TSLog> log=nullptr) override;
+
+        void manual_insert(std::shared_ptr<NodeDescriptor> new_node) override;
+        void manual_insert(std::vector<std::shared_ptr<NodeDescriptor>>& new_nodes) override;
+
+        bool remove(const std::string& address) override;
+
+    private:
+        static constexpr uint32_t SELF_ID = 0;
+        static constexpr int32_t NO_SLOT = -1;
+
+        mutable std::mutex _lock;
+        const uint64_t _seed;
+        Engine _eng;
+        std::shared_ptr<NodeDescriptor> _self;
+
+        // The view, one entry per slot. Ages are kept as the value of _clock at age 0, so aging is one increment
+        std::vector<uint32_t> _ids;
+        std::vector<uint32_t> _births;
+        uint32_t _clock;
+
+        // Interning, one entry per id
+        std::vector<std::string> _addresses;
+        std::vector<int32_t> _slots; // NO_SLOT for self and free ids
+        std::vector<uint32_t> _free_ids;
+        std::unordered_map<std::string, uint32_t> _interned;
+
+        // Reused between calls so reordering and eviction don't allocate
+        std::vector<uint32_t> _order;
+        std::vector<uint32_t> _scratch;
+        std::vector<uint8_t> _marks;
+        std::vector<uint32_t> _picks;
+
+        std::vector<std::shared_ptr<IdPeerSelector>> _subscribers;
+        std::shared_ptr<View::PeerSelector> _selector;
+        const int _size;
+        const int _healing;
+        const int _swap;
+
+        std::shared_ptr<NodeDescriptor> descriptor(int slot) const;
+        uint32_t intern(const std::string& address);
+        void release(uint32_t id);
+
+        void receive(std::vector<std::shared_ptr<NodeDescriptor>>& nodes);
+        void append(const std::shared_ptr<NodeDescriptor>& new_peer);
+        uint32_t age(int slot) const { return _clock - _births[slot]; }
+        void mark_oldest(int num_mark);
+        void remove_marked();
+        void move_old_to_back(int num_move);
+        void remove_old(int num_remove);
+        void remove_head(int num_remove);
+        void remove_random(int num_remove);
+        void sample_head(int num_sample, int range);
+};
+
+}
@@ -21,24 +21,37 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <chrono>
 
 #include <grpcpp/grpcpp.h>
 
 #include "server.h"
 #include "client.h"
+#include "transport.h"
 
 // ToDo Add logging
 namespace gossip {
 
 class PeerSamplingService {
     public:
+        PeerSamplingService(bool push, bool pull, std::chrono::milliseconds wait_time,
+                              std::chrono::milliseconds timeout,
+                              std::vector<std::string> entry_points,
+                              std::shared_ptr<View> view,
+                              std::shared_ptr<ChannelPool> channel_pool=nullptr);
+
         PeerSamplingService(bool push, bool pull, unsigned int wait_time,
                               unsigned int timeout,
                               std::vector<std::string> entry_points,
-                              std::shared_ptr<View> view);
+                              std::shared_ptr<View> view,
+                              std::shared_ptr<ChannelPool> channel_pool=nullptr)
+                              : PeerSamplingService(push, pull, std::chrono::seconds(wait_time), std::chrono::seconds(timeout),
+                                                    entry_points, view, channel_pool) {}
 
         ~PeerSamplingService();
 
+        /* Contacts the entry points concurrently and returns as soon as one of them answers, the rest keep merging
+           into the view in the background. Returns false only once every entry point contacted has failed. */
         virtual bool enter();
         virtual bool exit();
 
@@ -54,6 +67,68 @@ class PeerSamplingService {
         void stop();
         void signal();
 
+        /* Opt in to a shared scheduler before starting, the gossip rounds then run on its workers instead of a client thread */
+        void set_scheduler(std::shared_ptr<Scheduler> scheduler) { _scheduler = scheduler; }
+        std::shared_ptr<Scheduler> scheduler() { return _scheduler; }
+
+        /* Randomize each gossip period by up to +/- jitter so nodes started together don't gossip in lock step */
+        void set_jitter(std::chrono::milliseconds jitter) { _gossip_client->set_jitter(jitter); }
+        std::chrono::milliseconds jitter() const { return _gossip_client->jitter(); }
+
+        /* Adapt each exchange's deadline to the peer's round trip time, timeout() stays the upper bound */
+        void set_rtt_tracker(std::shared_ptr<RttTracker> rtt_tracker) { _gossip_client->set_rtt_tracker(rtt_tracker); }
+        std::shared_ptr<RttTracker> rtt_tracker() const { return _gossip_client->rtt_tracker(); }
+
+        /* Pass over peers that keep failing and evict them from the view once dead */
+        void set_failure_detector(std::shared_ptr<FailureDetector> failure_detector) { _gossip_client->set_failure_detector(failure_detector); }
+        std::shared_ptr<FailureDetector> failure_detector() const { return _gossip_client->failure_detector(); }
+
+        /* Exchange with frequently contacted peers over persistent streams, falling back to unary for older servers */
+        void set_exchange_streams(std::shared_ptr<ExchangeStreamPool> exchange_streams) { _gossip_client->set_exchange_streams(exchange_streams); }
+        std::shared_ptr<ExchangeStreamPool> exchange_streams() const { return _gossip_client->exchange_streams(); }
+
+        /* Set before starting. Exchanges go out over the transport and the server is served through it rather than
+           bound to a gRPC port, nullptr (the default) uses gRPC for both */
+        void set_transport(std::shared_ptr<Transport> transport) { _transport = transport; _gossip_client->set_transport(transport); }
+        std::shared_ptr<Transport> transport() const { return _transport; }
+
+        /* Also listen on a local address, e.g. unix:///tmp/node.sock, for peers on the same host. Set before starting. */
+        void set_local_address(const std::string& local_address) { _gossip_server->set_local_address(local_address); }
+        const std::string& local_address() const { return _gossip_server->local_address(); }
+
+        /* Run as an entry point, the sampler serves exchanges and is started and stopped with the server */
+        void set_entry_sampler(std::shared_ptr<EntrySampler> entry_sampler) { _gossip_server->set_entry_sampler(entry_sampler); }
+        std::shared_ptr<EntrySampler> entry_sampler() const { return _gossip_server->entry_sampler(); }
+
+        /* Refuse exchanges from sources over their rate and beyond the in flight cap, whichever way they arrive */
+        void set_admission_control(std::shared_ptr<AdmissionControl> admission_control) { _gossip_server->set_admission_control(admission_control); }
+        std::shared_ptr<AdmissionControl> admission_control() const { return _gossip_server->admission_control(); }
+
+        /* Merge the views pushed to this node in batches, one lock and one age step per batch */
+        void set_merge_queue(std::shared_ptr<MergeQueue> merge_queue) { _gossip_server->set_merge_queue(merge_queue); }
+        std::shared_ptr<MergeQueue> merge_queue() const { return _gossip_server->merge_queue(); }
+
+        /* Tune the gRPC server, set before starting */
+        void set_server_options(const ServerOptions& options) { _gossip_server->set_options(options); }
+        const ServerOptions& server_options() const { return _gossip_server->options(); }
+
+        /* Reach a co-located peer advertising address over its local target instead, for every node in this process */
+        void add_local_route(const std::string& address, const std::string& target);
+        void remove_local_route(const std::string& address);
+
+        /* Number of entry points, chosen at random, that enter() contacts. 0 contacts all of them. They are contacted
+           concurrently, up to max_in_flight at once, the rest as earlier ones complete */
+        void set_entry_fanout(unsigned int entry_fanout) { _entry_fanout = entry_fanout; }
+        unsigned int entry_fanout() const { return _entry_fanout; }
+
+        /* Number of distinct peers contacted concurrently each gossip round */
+        void set_fanout(unsigned int fanout) { _gossip_client->set_fanout(fanout); }
+        unsigned int fanout() const { return _gossip_client->fanout(); }
+
+        /* Cap on the client's exchanges in flight, see Client::set_max_in_flight */
+        void set_max_in_flight(unsigned int max_in_flight) { _gossip_client->set_max_in_flight(max_in_flight); }
+        unsigned int max_in_flight() const { return _gossip_client->max_in_flight(); }
+
         virtual std::string print() const;
 
         friend std::ostream& operator<<(std::ostream& os, const PeerSamplingService& obj) {
@@ -64,24 +139,34 @@ class PeerSamplingService {
         bool entered() const { return _entered; }
         bool push() const { return _push; }
         bool pull() const { return _pull; }
-        unsigned int wait_time() const { return _wait_time; }
-        unsigned int timeout() const { return _timeout; }
+        unsigned int wait_time() const { return std::chrono::duration_cast<std::chrono::seconds>(_wait_time).count(); }
+        std::chrono::milliseconds wait_time_ms() const { return _wait_time; }
+        unsigned int timeout() const { return std::chrono::duration_cast<std::chrono::seconds>(_timeout).count(); }
+        std::chrono::milliseconds timeout_ms() const { return _timeout; }
         std::shared_ptr<View> view() { return _view; }
+        std::shared_ptr<ChannelPool> channel_pool() { return _gossip_client->channel_pool(); }
         
     private:
         bool _entered;
         const bool _push;
         const bool _pull;
-        const unsigned int _wait_time;
-        const unsigned int _timeout;
+        const std::chrono::milliseconds _wait_time;
+        const std::chrono::milliseconds _timeout;
         std::vector<std::string> _entry_points;
+        unsigned int _entry_fanout;
         std::shared_ptr<View> _view;
         std::shared_ptr<Client> _gossip_client;
         std::shared_ptr<Client::Thread> _client_thread;
         std::shared_ptr<Server> _gossip_server;
         std::shared_ptr<Server::Thread> _server_thread;
+        std::shared_ptr<Scheduler> _scheduler;
+        std::shared_ptr<Transport> _transport;
+        bool _served;
 
         void _start_server();
+
+        struct Bootstrap;
+        static void bootstrap_next(std::shared_ptr<Client> client, std::shared_ptr<Bootstrap> bootstrap);
 };
 
 }
\ No newline at end of file
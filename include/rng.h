@@ -0,0 +1,79 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+namespace gossip {
+
+/* The splitmix64 finalizer, spreads any 64 bit value over all 64 bits */
+inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* xoshiro256++, 32 bytes of state and a handful of instructions per draw. Meets UniformRandomBitGenerator, so the
+   <random> distributions and std::shuffle take it. Engines from the same seed and different streams are independent */
+class Xoshiro256pp {
+    public:
+        using result_type = uint64_t;
+
+        explicit Xoshiro256pp(uint64_t seed, uint64_t stream=0) {
+            // Seeded by splitmix64 as its authors recommend, which never leaves the state all zero
+            uint64_t x = seed ^ mix64(stream);
+            for (uint64_t& s : _s) {
+                x += 0x9e3779b97f4a7c15ULL;
+                s = mix64(x);
+            }
+        }
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return UINT64_MAX; }
+
+        result_type operator()() {
+            const uint64_t result = rotl(_s[0] + _s[3], 23) + _s[0];
+            const uint64_t t = _s[1] << 17;
+            _s[2] ^= _s[0];
+            _s[3] ^= _s[1];
+            _s[1] ^= _s[2];
+            _s[0] ^= _s[3];
+            _s[2] ^= t;
+            _s[3] = rotl(_s[3], 45);
+            return result;
+        }
+
+    private:
+        uint64_t _s[4];
+
+        static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+/* The generator views draw from */
+using Engine = Xoshiro256pp;
+
+/* For views not given a seed */
+inline uint64_t random_seed() {
+    std::random_device rd;
+    return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+}
@@ -0,0 +1,91 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <array>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+namespace gossip {
+
+/* Per peer round trip time estimates used to derive exchange deadlines, so a dead peer is given up on within a few
+   of its round trips instead of a fixed timeout. Keeps a smoothed RTT and variance (as TCP does for its RTO) and a
+   window of recent samples for a high percentile, the deadline covers whichever is larger. Each timeout doubles a
+   peer's deadline until its next success so a peer that only got slower isn't timed out forever. Deadlines are
+   clamped to [min_timeout, max_timeout] and peers never measured get max_timeout. */
+class RttTracker final {
+    public:
+        RttTracker(std::chrono::milliseconds min_timeout, std::chrono::milliseconds max_timeout,
+                   std::size_t max_peers=1024)
+                    : _min_timeout(min_timeout), _max_timeout(std::max(min_timeout, max_timeout)), _max_peers(max_peers) {}
+
+        // No copying with mutex
+        RttTracker(const RttTracker& other) = delete;
+
+        void record(const std::string& address, std::chrono::microseconds rtt);
+        void record_timeout(const std::string& address);
+        void forget(const std::string& address);
+
+        std::chrono::milliseconds timeout(const std::string& address) const;
+        std::chrono::microseconds srtt(const std::string& address) const;
+        std::chrono::microseconds percentile_rtt(const std::string& address) const;
+
+        bool contains(const std::string& address) const;
+        std::size_t size() const;
+        std::chrono::milliseconds min_timeout() const { return _min_timeout; }
+        std::chrono::milliseconds max_timeout() const { return _max_timeout; }
+
+        std::string print() const;
+
+        friend std::ostream& operator<<(std::ostream& os, const RttTracker& obj) {
+            os << obj.print();
+            return os;
+        }
+
+    private:
+        static constexpr std::size_t kWindow = 32;
+        static constexpr double kPercentile = 0.99;
+        static constexpr unsigned int kMaxBackoff = 64;
+
+        struct Peer {
+            double srtt_us;
+            double rttvar_us;
+            std::array<int64_t, kWindow> window;
+            std::size_t samples;
+            unsigned int backoff;
+            std::chrono::steady_clock::time_point last_used;
+        };
+
+        mutable std::mutex _lock;
+        std::unordered_map<std::string, Peer> _peers;
+        const std::chrono::milliseconds _min_timeout;
+        const std::chrono::milliseconds _max_timeout;
+        const std::size_t _max_peers;
+
+        int64_t percentile_us(const Peer& peer) const;
+        void remove_lru();
+};
+
+}
@@ -0,0 +1,115 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <random>
+
+namespace gossip {
+
+/* Hierarchical timer wheel driving periodic work for any number of services from a small pool of worker threads.
+   One timer thread advances the wheel in fixed ticks and hands due tasks to the workers. A periodic task is never
+   run concurrently with itself, if it is still running or still waiting for a worker when it comes due again that
+   firing is skipped, so a late wheel or busy workers never run it several times back to back. A periodic
+   task given a jitter comes due at period +/- a uniformly random offset each time, so services started together
+   drift apart instead of firing in lock step. */
+class Scheduler final {
+    public:
+        using Task = std::function<void()>;
+        using TaskId = uint64_t;
+
+        Scheduler(unsigned int num_workers, std::chrono::milliseconds tick=std::chrono::milliseconds(10));
+        ~Scheduler();
+
+        // No copying with mutex
+        Scheduler(const Scheduler& other) = delete;
+
+        static std::shared_ptr<Scheduler> global();
+
+        TaskId schedule(std::chrono::milliseconds delay, Task task);
+        TaskId schedule_periodic(std::chrono::milliseconds period, Task task,
+                                 std::chrono::milliseconds jitter=std::chrono::milliseconds(0));
+        void cancel(TaskId id);
+        void stop();
+
+        std::size_t size() const;
+        unsigned int num_workers() const { return _workers.size(); }
+        std::chrono::milliseconds tick() const { return _tick; }
+
+    private:
+        static constexpr int kLevels = 4;
+        static constexpr int kSlotBits = 6;
+        static constexpr uint64_t kSlots = 1 << kSlotBits;
+        static constexpr uint64_t kSlotMask = kSlots - 1;
+
+        struct Timer {
+            TaskId id;
+            uint64_t expiry; // In ticks
+            uint64_t period; // In ticks, 0 for one shot
+            uint64_t jitter; // In ticks
+            Task task;
+            bool queued; // In _ready, guarded by _lock
+            std::atomic<bool> running;
+            std::atomic<bool> cancelled;
+        };
+
+        mutable std::mutex _lock;
+        std::condition_variable _timer_cv;
+        std::condition_variable _worker_cv;
+        std::vector<std::thread> _workers;
+        std::thread _timer_thread;
+        bool _active;
+
+        const std::chrono::milliseconds _tick;
+        const std::chrono::steady_clock::time_point _epoch;
+        uint64_t _current_tick;
+        // The tick the wheel is catching up to
+        uint64_t _target_tick;
+        TaskId _next_id;
+        std::mt19937 _eng;
+
+        std::list<std::shared_ptr<Timer>> _wheel[kLevels][kSlots];
+        std::unordered_map<TaskId, std::shared_ptr<Timer>> _timers;
+        std::deque<std::shared_ptr<Timer>> _ready;
+
+        TaskId add(uint64_t delay_ticks, uint64_t period_ticks, uint64_t jitter_ticks, Task task);
+        uint64_t to_ticks(std::chrono::milliseconds duration) const;
+        uint64_t now_tick() const;
+        void insert(std::shared_ptr<Timer> timer);
+        void cascade(int level);
+        void advance();
+        void fire(std::shared_ptr<Timer> timer);
+        uint64_t next_period(const Timer& timer);
+        void run_timer();
+        void run_worker();
+};
+
+}
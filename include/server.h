@@ -19,18 +19,45 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <thread>
+#include <deque>
+#include <vector>
+#include <utility>
+#include <mutex>
+#include <chrono>
+#include <atomic>
 
 #include <grpcpp/grpcpp.h>
 
 #include "gossip.grpc.pb.h"
 
 #include "view.h"
+#include "entry_sampler.h"
+#include "admission_control.h"
+#include "merge_queue.h"
 
 namespace gossip {
 
+/* Tuning for the gRPC server hosting a Server, set per deployment. Zero leaves gRPC's own default in place. */
+struct ServerOptions {
+    /* Bytes of buffer memory the server may hold across all its connections before reads are throttled */
+    std::size_t memory_quota = 0;
+    /* RPCs, exchange streams included, one client connection may have open at once */
+    int max_concurrent_streams = 0;
+    /* Ping an idle client this often and drop it if no ack arrives within keepalive_timeout */
+    std::chrono::milliseconds keepalive_time{0};
+    std::chrono::milliseconds keepalive_timeout{0};
+    /* Shortest interval clients may ping at without a call in flight, pooled channels sit idle between rounds */
+    std::chrono::milliseconds min_ping_interval{0};
+    /* Close a client connection with no call on it for this long */
+    std::chrono::milliseconds max_connection_idle{0};
+    /* How long stop() lets exchanges in flight finish before cancelling them, exchange streams never finish on their own */
+    std::chrono::milliseconds shutdown_grace{1000};
+};
+
 class Server final : public GossipProtocol::CallbackService, public std::enable_shared_from_this<Server> {
     public:
         Server(std::shared_ptr<View> view) : _view(view) {}
@@ -38,7 +65,45 @@ class Server final : public GossipProtocol::CallbackService, public std::enable_
         ::grpc::ServerUnaryReactor* PushView(::grpc::CallbackServerContext* context, const ::gossip::ViewProto* request, ::google::protobuf::Empty* response) override;
         ::grpc::ServerUnaryReactor* PullView(::grpc::CallbackServerContext* context, const ::google::protobuf::Empty* request, ::gossip::ViewProto* response) override;
         ::grpc::ServerUnaryReactor* PushPullView(::grpc::CallbackServerContext* context, const ::gossip::ViewProto* request, ::gossip::ViewProto* response) override;
+        /* Answers each exchange multiplexed over the stream in the order they arrive, under the id it was sent with */
+        ::grpc::ServerBidiReactor<::gossip::ExchangeRequest, ::gossip::ExchangeResponse>* Exchange(::grpc::CallbackServerContext* context) override;
+
+        /* Serves one exchange against the view whichever transport carried it. request is unused on a pull and
+           response is left empty answering a push. */
+        void answer(ExchangeRequest::Type type, const ViewProto& request, ViewProto& response);
+        /* answer() if admission control lets the exchange from peer through, RESOURCE_EXHAUSTED otherwise. peer is
+           named as gRPC names it, ipv4:10.0.0.1:50000, and is admitted as source(peer) if admission is per host. */
+        ::grpc::Status serve(const std::string& peer, ExchangeRequest::Type type, const ViewProto& request, ViewProto& response);
+
+        /* Host part of a gRPC peer such as ipv4:10.0.0.1:50000, every connection from one host is one source */
+        static std::string source(const std::string& peer);
+
+        std::shared_ptr<View> view() { return _view; }
+
+        /* A second address to listen on for co-located peers, e.g. unix:///tmp/node.sock, empty for none.
+           Takes effect on the next start(). */
+        void set_local_address(const std::string& local_address) { _local_address = local_address; }
+        const std::string& local_address() const { return _local_address; }
 
+        /* Serve exchanges from the entry sampler instead of the view, for an entry point taking a fleet's joins */
+        void set_entry_sampler(std::shared_ptr<EntrySampler> entry_sampler) { std::atomic_store(&_entry_sampler, entry_sampler); }
+        std::shared_ptr<EntrySampler> entry_sampler() const { return std::atomic_load(&_entry_sampler); }
+
+        /* Rate limit exchanges per source and cap those served at once, nullptr (the default) admits everything */
+        void set_admission_control(std::shared_ptr<AdmissionControl> admission_control) { std::atomic_store(&_admission_control, admission_control); }
+        std::shared_ptr<AdmissionControl> admission_control() const { return std::atomic_load(&_admission_control); }
+
+        /* Queue pushed views for batched merges instead of merging each under the view's lock as it arrives */
+        void set_merge_queue(std::shared_ptr<MergeQueue> merge_queue) { std::atomic_store(&_merge_queue, merge_queue); }
+        std::shared_ptr<MergeQueue> merge_queue() const { return std::atomic_load(&_merge_queue); }
+
+        /* Takes effect on the next start() */
+        void set_options(const ServerOptions& options) { _options = options; }
+        const ServerOptions& options() const { return _options; }
+
+    /* Owns the gRPC server hosting this service. gRPC serves requests from its own pollers and callback threads,
+       so start() binds and returns without parking a thread of ours. Once started the server is listed with
+       LocalChannels under each address it listens on, so pools in this process can reach it in-process. */
     class Thread {
         public:
             Thread(std::shared_ptr<Server> server) : _server(server), _stop_flag(false) {}
@@ -50,15 +115,22 @@ class Server final : public GossipProtocol::CallbackService, public std::enable_
 
         private:
             std::shared_ptr<Server> _server;
-            std::thread _thread;
             std::unique_ptr<::grpc::Server> _grpc_server;
             std::atomic<bool> _stop_flag;
+            std::vector<std::pair<std::string, uint64_t>> _listed;
+
+            static void configure(::grpc::ServerBuilder& builder, const ServerOptions& options);
     };
 
     std::shared_ptr<Server::Thread> thread() { return std::make_shared<Thread>(shared_from_this()); }
 
     private:
         std::shared_ptr<View> _view;
+        std::string _local_address;
+        ServerOptions _options;
+        std::shared_ptr<EntrySampler> _entry_sampler;
+        std::shared_ptr<AdmissionControl> _admission_control;
+        std::shared_ptr<MergeQueue> _merge_queue;
 
 };
 
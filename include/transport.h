@@ -0,0 +1,53 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <functional>
+#include <chrono>
+
+#include <grpcpp/grpcpp.h>
+
+#include "gossip.pb.h"
+
+namespace gossip {
+
+class Server;
+
+/* Carries view exchanges between nodes in place of gRPC. A Client given a transport sends its exchanges through it,
+   and a PeerSamplingService given one serves its Server through it instead of binding a gRPC port. */
+class Transport {
+    public:
+        /* The response view is only meaningful when the status is OK and is unset answering a push */
+        using Callback = std::function<void(::grpc::Status, const ViewProto&)>;
+
+        virtual ~Transport() = default;
+
+        /* tx_buf is unused on a pull. done is invoked exactly once. */
+        virtual void exchange(const std::string& address, ExchangeRequest::Type type, std::shared_ptr<ViewProto> tx_buf,
+                              std::chrono::milliseconds timeout, Callback done) = 0;
+
+        /* Answers exchanges addressed to the server's own address until unserved. False if the address is taken. */
+        virtual bool serve(std::shared_ptr<Server> server) = 0;
+        virtual void unserve(const std::string& address) = 0;
+};
+
+}
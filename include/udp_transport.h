@@ -0,0 +1,140 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include <sys/socket.h>
+
+#include "transport.h"
+#include "scheduler.h"
+#include "server.h"
+
+namespace gossip {
+
+/* Carries each exchange as one UDP datagram each way, skipping HTTP/2 entirely. Requests and responses are
+   DatagramProtos matched up by id, each exchange bounded by its own deadline on the scheduler. Outgoing datagrams
+   queue up and leave batch_size at a time through sendmmsg, incoming ones are read batch_size at a time through
+   recvmmsg and a served node's answers to a whole batch go back out together. Where the batched calls are missing,
+   off Linux, each datagram is its own sendmsg or recvmsg. There is no retransmission, a lost datagram is a timed out
+   exchange which gossip already tolerates, and a view too large for max_datagram fails its exchange. A datagram
+   longer than the receiver's max_datagram is dropped, so nodes sharing a transport must agree on it. A response is
+   only taken from the address its request was sent to. One per node, bound to the node's own address (port 0 for a
+   client only node). Must be made from a shared ptr. */
+class UdpTransport final : public Transport, public std::enable_shared_from_this<UdpTransport> {
+    public:
+        static constexpr std::size_t kMaxDatagram = 65507;
+        // Room for a few hundred descriptors, far more than the half view an exchange carries
+        static constexpr std::size_t kDefaultMaxDatagram = 8192;
+
+        /* Receiving takes batch_size * max_datagram bytes of buffer, max_datagram is capped at kMaxDatagram */
+        UdpTransport(std::string address, std::size_t batch_size=32, std::shared_ptr<Scheduler> scheduler=nullptr,
+                     std::size_t max_datagram=kDefaultMaxDatagram)
+                     : _address(address), _batch_size(std::max<std::size_t>(batch_size, 1)),
+                     _max_datagram(std::min(std::max<std::size_t>(max_datagram, 1), kMaxDatagram)),
+                     _scheduler(scheduler ? scheduler : Scheduler::global()), _fd(-1), _family(AF_UNSPEC), _active(false), _next_id(0) {}
+
+        ~UdpTransport();
+
+        // No copying with mutex
+        UdpTransport(const UdpTransport& other) = delete;
+
+        void exchange(const std::string& address, ExchangeRequest::Type type, std::shared_ptr<ViewProto> tx_buf,
+                      std::chrono::milliseconds timeout, Callback done) override;
+
+        /* Only one server per transport, false if one is already served or the socket could not be bound */
+        bool serve(std::shared_ptr<Server> server) override;
+        void unserve(const std::string& address) override;
+
+        /* Binds the socket and starts the send and receive threads, done on first use. False if the address can't be bound. */
+        bool start();
+        /* Exchanges still waiting on a response complete with CANCELLED */
+        void stop();
+
+        bool active() const { return _active; }
+        bool serving() const;
+        std::size_t pending() const;
+        const std::string& address() const { return _address; }
+        std::size_t batch_size() const { return _batch_size; }
+        std::size_t max_datagram() const { return _max_datagram; }
+
+    private:
+        struct Pending {
+            Callback done;
+            Scheduler::TaskId timer;
+            sockaddr_storage peer; // Only a response from here completes the exchange
+        };
+
+        struct Outgoing {
+            sockaddr_storage to;
+            socklen_t to_len;
+            std::string data;
+        };
+
+        struct Resolved {
+            sockaddr_storage addr;
+            socklen_t len;
+        };
+
+        const std::string _address;
+        const std::size_t _batch_size;
+        const std::size_t _max_datagram;
+        std::shared_ptr<Scheduler> _scheduler;
+
+        mutable std::mutex _lock;
+        int _fd;
+        int _family;
+        std::atomic<bool> _active;
+        std::thread _receiver;
+        // Set when the receive thread itself stops the transport, from a callback, and is detached instead of joined
+        std::shared_ptr<std::atomic<bool>> _receiver_orphaned;
+        std::thread _sender;
+        uint64_t _next_id;
+        std::unordered_map<uint64_t, Pending> _pending;
+        std::shared_ptr<Server> _server;
+        std::unordered_map<std::string, Resolved> _resolved;
+
+        std::mutex _send_lock;
+        std::condition_variable _send_cv;
+        std::deque<Outgoing> _sends;
+
+        static bool resolve(const std::string& address, int family, sockaddr_storage& out, socklen_t& len);
+        static std::string peer(const sockaddr_storage& addr, socklen_t len);
+        static bool same_peer(const sockaddr_storage& sent_to, const sockaddr_storage& from);
+        bool lookup(const std::string& address, sockaddr_storage& out, socklen_t& len);
+        void enqueue(std::vector<Outgoing>& batch);
+        void expire(uint64_t id);
+        void respond(const ExchangeResponse& response, const sockaddr_storage& from);
+        void run_receiver(const std::atomic<bool>& orphaned);
+        void run_sender();
+};
+
+}
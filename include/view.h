@@ -21,15 +21,19 @@
 
 #include <cstdint>
 #include <vector>
-#include <unordered_map>
 #include <deque>
+#include <unordered_map>
+#include <unordered_set>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <random>
 #include <mutex>
+#include <atomic>
 
 #include "ts_ring_buffer.h"
 #include "node_descriptor.h"
+#include "rng.h"
 
 namespace gossip {
 
@@ -42,6 +46,9 @@ enum class SelectorType {
     LOGGED_UNIFORM_RANDOM_NO_REPLACEMENT = 5,
 };
 
+/* min(k, n) distinct indices below n into picks, in random order */
+void sample_indices(std::size_t k, std::size_t n, Engine& eng, std::vector<uint32_t>& picks);
+
 struct TSLog {
     virtual ~TSLog() = default;
     virtual void push_back(const std::string& id, const std::string& selected, uint64_t time) = 0;
@@ -85,10 +92,14 @@ struct View {
     /* View(std::string address, args); */
     /* Public methods must be Thread Safe */
     virtual std::shared_ptr<NodeDescriptor> select_peer() = 0; //Internal Selection
+    /* Up to k distinct peers written over out, returns how many. Defaults to k calls to select_peer */
+    virtual std::size_t select_peers(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out);
     virtual ~View() = default;
     virtual std::vector<std::shared_ptr<NodeDescriptor>> tx_nodes() = 0;
     virtual void rx_nodes(std::vector<std::shared_ptr<NodeDescriptor>>& nodes) = 0;
     virtual void increment_age() = 0;
+    /* rx_nodes then increment_age as one step, for merging a batch of pushes at once */
+    virtual void merge(std::vector<std::shared_ptr<NodeDescriptor>>& nodes) { rx_nodes(nodes); increment_age(); }
 
     virtual void init_selector(SelectorType type, std::shared_ptr<TSLog> log=nullptr) = 0;
 
@@ -112,6 +123,10 @@ struct View {
 
         virtual std::shared_ptr<NodeDescriptor> select_peer_impl() = 0;
         virtual std::shared_ptr<NodeDescriptor> select_peer() { return select_peer_impl(); }
+        /* Up to k distinct peers written over out, fewer only if the view holds fewer, returns how many. Selectors
+           below draw them in one go, this default makes k calls to select_peer_impl and drops repeats */
+        virtual std::size_t select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out);
+        virtual std::size_t select_peers(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) { return select_peers_impl(k, out); }
 
         virtual std::string print() const = 0;
 
@@ -127,6 +142,8 @@ struct View {
             virtual ~LoggedPeerSelector() = default;
 
             std::shared_ptr<NodeDescriptor> select_peer() override;
+            /* One entry per peer, all stamped with the same time */
+            std::size_t select_peers(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) override;
 
         private:
             std::shared_ptr<TSLog> _log;
@@ -138,6 +155,9 @@ struct View {
     /* Useful for simulation and certain static topology requirements for certain scenarios */
     virtual void manual_insert(std::shared_ptr<NodeDescriptor> new_node) = 0;
     virtual void manual_insert(std::vector<std::shared_ptr<NodeDescriptor>>& new_nodes) = 0;
+
+    /* Drop a peer found to be dead and notify_delete subscribers, returns false if it wasn't in the view */
+    virtual bool remove(const std::string&) { return false; }
 };
 
 
@@ -145,6 +165,9 @@ class URView final : public View, public std::enable_shared_from_this<URView> {
     public:
 
         URView(std::string address, int size, int healing, int swap);
+        /* Every random choice the view and its selectors make follows from seed, so replaying the same calls in the
+           same order makes the same choices */
+        URView(std::string address, int size, int healing, int swap, uint64_t seed);
         
         // No copying with mutex
         URView(const URView& other) = delete;
@@ -152,17 +175,22 @@ class URView final : public View, public std::enable_shared_from_this<URView> {
         void init_selector(SelectorType type, std::shared_ptr<TSLog> log=nullptr) override;
 
         std::shared_ptr<NodeDescriptor> select_peer() override;
+        std::size_t select_peers(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) override;
         std::vector<std::shared_ptr<NodeDescriptor>> tx_nodes() override; 
         void rx_nodes(std::vector<std::shared_ptr<NodeDescriptor>>& nodes) override; 
         void increment_age() override; 
+        /* Under one lock */
+        void merge(std::vector<std::shared_ptr<NodeDescriptor>>& nodes) override;
         
         const std::shared_ptr<NodeDescriptor> self() const override { return _self; }
-        int max_size() const { return _view.size(); }
-        bool contains(std::string address) const override { return (_node_lut.find(address) != _node_lut.end()); }
+        /* From the latest snapshot, without the lock */
+        int max_size() const;
+        bool contains(std::string address) const override;
 
         int size() const { return _size; }
         int healing() const { return _healing; }
         int swap() const { return _swap; }
+        uint64_t seed() const { return _seed; }
 
         std::string print() const override;
 
@@ -170,6 +198,7 @@ class URView final : public View, public std::enable_shared_from_this<URView> {
             public:
                 TailPeerSelector(std::shared_ptr<URView> view) : _view(view) {}
                 std::shared_ptr<NodeDescriptor> select_peer_impl() override;
+                std::size_t select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) override;
 
                 std::string print() const override;
             private:
@@ -184,6 +213,7 @@ class URView final : public View, public std::enable_shared_from_this<URView> {
             public:
                 URPeerSelector(std::shared_ptr<URView> view) : _view(view) {}
                 std::shared_ptr<NodeDescriptor> select_peer_impl() override;
+                std::size_t select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) override;
 
                 std::string print() const override;
             private:
@@ -194,19 +224,28 @@ class URView final : public View, public std::enable_shared_from_this<URView> {
             LoggedURPeerSelector(std::shared_ptr<URView> view, std::shared_ptr<TSLog> log=nullptr) : URPeerSelector(view), View::LoggedPeerSelector(log, view->self()->address()) {}
         };
 
+        /* Each peer added is drawn once, at random, before falling back to uniform random selection. Peers wait in a
+           pool that adds, deletes and draws in constant time, guarded by the view's lock that notifications come under */
         class URNRPeerSelector : public virtual View::PeerSelector {         
             public:
                 URNRPeerSelector(std::shared_ptr<URView> view);
                 std::shared_ptr<NodeDescriptor> select_peer_impl() override;
+                std::size_t select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) override;
                 void notify_add(std::shared_ptr<NodeDescriptor> new_node) override;
                 void notify_add(std::vector<std::shared_ptr<NodeDescriptor>>& new_nodes) override;
+                void notify_delete(std::string& del_address) override;
+                void notify_delete(std::vector<std::string>& del_addresses) override;
                 std::string print() const override;
             private:
                 std::shared_ptr<URView> _view;
-                std::deque<std::shared_ptr<NodeDescriptor>> _qos_queue;
-                
+                std::vector<std::shared_ptr<NodeDescriptor>> _unselected;
+                // Address -> index in _unselected, keyed by the address of the descriptor held there
+                std::unordered_map<std::string_view, std::size_t> _positions;
+
                 std::shared_ptr<NodeDescriptor> random_selection();
-                void permute_qos_queue();
+                void add(const std::shared_ptr<NodeDescriptor>& node);
+                void remove(std::string_view address);
+                std::shared_ptr<NodeDescriptor> draw();
         };
 
         struct LoggedURNRPeerSelector : public URNRPeerSelector, public View::LoggedPeerSelector {
@@ -219,28 +258,67 @@ class URView final : public View, public std::enable_shared_from_this<URView> {
         void manual_insert(std::shared_ptr<NodeDescriptor> new_node) override;
         void manual_insert(std::vector<std::shared_ptr<NodeDescriptor>>& new_nodes) override;
 
+        bool remove(const std::string& address) override;
+
     private:
+        /* The view as of its last publish, never modified once published. Selectors and queries read this rather than
+           wait on _lock behind a merge. Changes only mark it stale, the first reader after them publishes, so a run of
+           exchanges with no reader in between copies the view once rather than once per exchange */
+        struct Snapshot {
+            std::vector<std::shared_ptr<NodeDescriptor>> nodes;
+            // Views into the addresses of nodes, built by the first contains() to need it and shared by consecutive
+            // snapshots with the same members
+            mutable std::shared_ptr<const std::unordered_set<std::string_view>> members;
+        };
+
         mutable std::mutex _lock;
-        std::random_device _rd;
-        std::mt19937 _eng;
+        const uint64_t _seed;
+        // Drawn from under _lock
+        Engine _eng;
+        // Numbers the streams of draws made without the lock
+        mutable std::atomic<uint64_t> _streams;
         std::shared_ptr<NodeDescriptor> _self;
-        std::vector<std::shared_ptr<NodeDescriptor>> _view;
+        mutable std::shared_ptr<const Snapshot> _snapshot;
+        // Set under _lock by every change, cleared by publish()
+        mutable std::atomic<bool> _stale;
+        mutable bool _members_changed;
+        // Descriptors in the view are attached to this, so aging the whole view is one increment
+        std::shared_ptr<std::atomic<uint32_t>> _clock;
+        // A deque so the head can be dropped without shifting the rest
+        std::deque<std::shared_ptr<NodeDescriptor>> _view;
         std::unordered_map<std::string, std::shared_ptr<NodeDescriptor>> _node_lut;
         mutable std::vector<std::shared_ptr<View::PeerSelector>> _subscribers;
 
+        // Reused between calls so finding the oldest nodes doesn't allocate
+        std::vector<uint32_t> _ages;
+        std::vector<uint32_t> _select_ages;
+        std::vector<std::shared_ptr<NodeDescriptor>> _oldest;
+        std::vector<uint32_t> _picks;
+
         std::shared_ptr<View::PeerSelector> _selector;
         const int _size;
         const int _healing;
         const int _swap;
 
+        /* Takes _lock only to publish pending changes */
+        std::shared_ptr<const Snapshot> snapshot() const;
+        /* Under _lock */
+        std::shared_ptr<const Snapshot> locked_snapshot() const;
+        /* For selectors drawing from a snapshot without the lock, an engine of its own on every call */
+        Engine reader_engine() const { return Engine(_seed, _streams.fetch_add(1, std::memory_order_relaxed) + 1); }
+        /* Under _lock */
+        void changed() { _stale.store(true); }
+        void publish() const;
+        void receive(std::vector<std::shared_ptr<NodeDescriptor>>& nodes);
         std::vector<std::shared_ptr<NodeDescriptor>> head(int num_get) const;
         void append(std::shared_ptr<NodeDescriptor> new_peer);
         void append(std::vector<std::shared_ptr<NodeDescriptor>>& new_peers);
         void move_old_to_back(int num_move);
+        void forget(const std::shared_ptr<NodeDescriptor>& node, std::vector<std::string>& removed);
         void remove_old(int num_remove);
         void remove_head(int num_remove);
         void remove_random(int num_remove);
-        void permute();
+        void sample_head(int num_sample, int range);
 };
 
 }
\ No newline at end of file
@@ -21,10 +21,26 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/gil.h>
+#include <pybind11/chrono.h>
+
+#include <cmath>
 
 #include "node_descriptor.h"
 #include "view.h"
+#include "packed_view.h"
 #include "peer_sampling_service.h"
+#include "scheduler.h"
+#include "rtt_tracker.h"
+#include "failure_detector.h"
+#include "exchange_stream.h"
+#include "transport.h"
+#include "loopback_transport.h"
+#include "udp_transport.h"
+#include "channel_pool.h"
+#include "local_channels.h"
+#include "entry_sampler.h"
+#include "admission_control.h"
+#include "merge_queue.h"
 
 namespace py = pybind11;
 namespace gossip {
@@ -80,6 +96,10 @@ struct PyView : public View {
     void manual_insert(std::vector<std::shared_ptr<NodeDescriptor>>& new_nodes) override {
         PYBIND11_OVERRIDE_PURE(void, View, std::vector<std::shared_ptr<NodeDescriptor>> new_nodes);
     }
+
+    bool remove(const std::string& address) override {
+        PYBIND11_OVERRIDE(bool, View, remove, address);
+    }
  };
 
 struct PyPeerSelector : public View::PeerSelector {
@@ -159,14 +179,18 @@ PYBIND11_MODULE(_gossip, m) {
         .def(py::init<std::string, uint32_t>(), py::arg("address"), py::arg("age"))
         .def("print", &NodeDescriptor::print)        
         .def_property_readonly("address", &NodeDescriptor::address)
-        .def_property("age", [](NodeDescriptor &self) -> uint32_t& { return self.age(); }, // Getter
-                             [](NodeDescriptor &self, uint32_t value) { self.age() = value; }) // Setter)
+        .def_property("age", &NodeDescriptor::age, &NodeDescriptor::set_age)
 
         .def("__str__", &NodeDescriptor::print);
 
     py::class_<View, PyView, std::shared_ptr<View>>(m, "View")
         .def(py::init<>())  // Default constructor
         .def("select_peer", &View::select_peer)
+        .def("select_peers", [](View& self, std::size_t k) {
+            std::vector<std::shared_ptr<NodeDescriptor>> selected;
+            self.select_peers(k, selected);
+            return selected;
+        }, py::arg("k"))
         .def("tx_nodes", &View::tx_nodes)
         .def("rx_nodes", &View::rx_nodes)
         .def("increment_age", &View::increment_age)
@@ -178,13 +202,20 @@ PYBIND11_MODULE(_gossip, m) {
         .def("create_subscriber", &View::create_subscriber)
         .def("manual_insert", py::overload_cast<std::shared_ptr<NodeDescriptor>>(&View::manual_insert), py::arg("new_node"))
         .def("manual_insert", py::overload_cast<std::vector<std::shared_ptr<NodeDescriptor>>&>(&View::manual_insert), py::arg("new_nodes"))
+        .def("remove", &View::remove, py::arg("address"))
         .def("__str__", &View::print);
 
     // Bind Uniform Random View
     py::class_<URView, View, std::shared_ptr<URView>>(m, "URView")
         .def(py::init<std::string, int, int, int>(), py::arg("address"), py::arg("size"), py::arg("healing"), py::arg("swap"))
+        .def(py::init<std::string, int, int, int, uint64_t>(), py::arg("address"), py::arg("size"), py::arg("healing"), py::arg("swap"), py::arg("seed"))
         .def("init_selector", &URView::init_selector, py::arg("type"), py::arg("log") = nullptr)
         .def("select_peer", &URView::select_peer)
+        .def("select_peers", [](URView& self, std::size_t k) {
+            std::vector<std::shared_ptr<NodeDescriptor>> selected;
+            self.select_peers(k, selected);
+            return selected;
+        }, py::arg("k"))
         .def("tx_nodes", &URView::tx_nodes)
         .def("rx_nodes", &URView::rx_nodes)
         .def("increment_age", &URView::increment_age)
@@ -194,11 +225,41 @@ PYBIND11_MODULE(_gossip, m) {
         .def("size", &URView::size)
         .def("healing", &URView::healing)
         .def("swap", &URView::swap)
+        .def("seed", &URView::seed)
         .def("create_subscriber", &URView::create_subscriber)
         .def("manual_insert", py::overload_cast<std::shared_ptr<NodeDescriptor>>(&URView::manual_insert), py::arg("new_node"))
         .def("manual_insert", py::overload_cast<std::vector<std::shared_ptr<NodeDescriptor>>&>(&URView::manual_insert), py::arg("new_nodes"))
+        .def("remove", &URView::remove, py::arg("address"))
         .def("__str__", &URView::print);  // Allows the use of str() in Python;
 
+    // Bind Uniform Random View over interned ids
+    py::class_<PackedView, View, std::shared_ptr<PackedView>>(m, "PackedView")
+        .def(py::init<std::string, int, int, int>(), py::arg("address"), py::arg("size"), py::arg("healing"), py::arg("swap"))
+        .def(py::init<std::string, int, int, int, uint64_t>(), py::arg("address"), py::arg("size"), py::arg("healing"), py::arg("swap"), py::arg("seed"))
+        .def("init_selector", &PackedView::init_selector, py::arg("type"), py::arg("log") = nullptr)
+        .def("select_peer", &PackedView::select_peer)
+        .def("select_peers", [](PackedView& self, std::size_t k) {
+            std::vector<std::shared_ptr<NodeDescriptor>> selected;
+            self.select_peers(k, selected);
+            return selected;
+        }, py::arg("k"))
+        .def("tx_nodes", &PackedView::tx_nodes)
+        .def("rx_nodes", &PackedView::rx_nodes)
+        .def("increment_age", &PackedView::increment_age)
+        .def("self", &PackedView::self)
+        .def("max_size", &PackedView::max_size)
+        .def("contains", &PackedView::contains)
+        .def("size", &PackedView::size)
+        .def("healing", &PackedView::healing)
+        .def("swap", &PackedView::swap)
+        .def("seed", &PackedView::seed)
+        .def("num_ids", &PackedView::num_ids)
+        .def("create_subscriber", &PackedView::create_subscriber)
+        .def("manual_insert", py::overload_cast<std::shared_ptr<NodeDescriptor>>(&PackedView::manual_insert), py::arg("new_node"))
+        .def("manual_insert", py::overload_cast<std::vector<std::shared_ptr<NodeDescriptor>>&>(&PackedView::manual_insert), py::arg("new_nodes"))
+        .def("remove", &PackedView::remove, py::arg("address"))
+        .def("__str__", &PackedView::print);
+
     // Bind the Selector Type Enum
     py::enum_<SelectorType>(m, "SelectorType")
         .value("TAIL", SelectorType::TAIL)
@@ -217,6 +278,11 @@ PYBIND11_MODULE(_gossip, m) {
         .def("notify_delete", py::overload_cast<std::vector<std::string>&>(&View::PeerSelector::notify_delete), py::arg("del_addresses"))  // Overload for vector
         .def("select_peer_impl", &View::PeerSelector::select_peer_impl)
         .def("select_peer", &View::PeerSelector::select_peer)
+        .def("select_peers", [](View::PeerSelector& self, std::size_t k) {
+            std::vector<std::shared_ptr<NodeDescriptor>> selected;
+            self.select_peers(k, selected);
+            return selected;
+        }, py::arg("k"))
         .def("__str__", &View::PeerSelector::print);
 
     py::class_<TSLog, PyTSLog, std::shared_ptr<TSLog>>(m, "TSLog")
@@ -227,7 +293,12 @@ PYBIND11_MODULE(_gossip, m) {
 
     py::class_<View::LoggedPeerSelector, View::PeerSelector, PyLoggedPeerSelector, std::shared_ptr<View::LoggedPeerSelector>>(m, "LoggedPeerSelector")
         .def(py::init<std::shared_ptr<TSLog>, const std::string>(), py::arg("log"), py::arg("id"))
-        .def("select_peer", &View::LoggedPeerSelector::select_peer);
+        .def("select_peer", &View::LoggedPeerSelector::select_peer)
+        .def("select_peers", [](View::LoggedPeerSelector& self, std::size_t k) {
+            std::vector<std::shared_ptr<NodeDescriptor>> selected;
+            self.select_peers(k, selected);
+            return selected;
+        }, py::arg("k"));
     
     py::class_<URView::TailPeerSelector, View::PeerSelector, std::shared_ptr<URView::TailPeerSelector>>(m, "TailPeerSelector")
         .def(py::init<std::shared_ptr<URView>>(), py::arg("view"))
@@ -253,12 +324,159 @@ PYBIND11_MODULE(_gossip, m) {
         .def(py::init<std::shared_ptr<URView>, std::shared_ptr<TSLog>>(), py::arg("view"), py::arg("log"))
         .def("__str__", &URView::URNRPeerSelector::print);
 
+    py::class_<Scheduler, std::shared_ptr<Scheduler>>(m, "Scheduler")
+        .def(py::init<unsigned int, std::chrono::milliseconds>(), py::arg("num_workers"), py::arg("tick") = std::chrono::milliseconds(10))
+        .def_static("global_scheduler", &Scheduler::global)
+        .def("stop", &Scheduler::stop, py::call_guard<py::gil_scoped_release>())
+        .def("size", &Scheduler::size)
+        .def("num_workers", &Scheduler::num_workers)
+        .def("tick", &Scheduler::tick);
+
+    py::class_<RttTracker, std::shared_ptr<RttTracker>>(m, "RttTracker")
+        .def(py::init<std::chrono::milliseconds, std::chrono::milliseconds, std::size_t>(),
+             py::arg("min_timeout"), py::arg("max_timeout"), py::arg("max_peers") = 1024)
+        .def("timeout", &RttTracker::timeout, py::arg("address"))
+        .def("srtt", &RttTracker::srtt, py::arg("address"))
+        .def("percentile_rtt", &RttTracker::percentile_rtt, py::arg("address"))
+        .def("forget", &RttTracker::forget, py::arg("address"))
+        .def("contains", &RttTracker::contains, py::arg("address"))
+        .def("size", &RttTracker::size)
+        .def("min_timeout", &RttTracker::min_timeout)
+        .def("max_timeout", &RttTracker::max_timeout)
+        .def("__str__", &RttTracker::print);
+
+    py::class_<FailureDetector, std::shared_ptr<FailureDetector>> failure_detector(m, "FailureDetector");
+    py::enum_<FailureDetector::State>(failure_detector, "State")
+        .value("ALIVE", FailureDetector::State::ALIVE)
+        .value("SUSPECT", FailureDetector::State::SUSPECT)
+        .value("DEAD", FailureDetector::State::DEAD)
+        .export_values();
+    failure_detector
+        .def(py::init<unsigned int, unsigned int, std::size_t>(),
+             py::arg("suspect_after") = 2, py::arg("evict_after") = 4, py::arg("max_peers") = 1024)
+        .def("record_success", &FailureDetector::record_success, py::arg("address"))
+        .def("record_failure", &FailureDetector::record_failure, py::arg("address"))
+        .def("forget", &FailureDetector::forget, py::arg("address"))
+        .def("state", &FailureDetector::state, py::arg("address"))
+        .def("suspected", &FailureDetector::suspected, py::arg("address"))
+        .def("failures", &FailureDetector::failures, py::arg("address"))
+        .def("size", &FailureDetector::size)
+        .def("suspect_after", &FailureDetector::suspect_after)
+        .def("evict_after", &FailureDetector::evict_after)
+        .def("__str__", &FailureDetector::print);
+
+    py::class_<ExchangeStreamPool, std::shared_ptr<ExchangeStreamPool>>(m, "ExchangeStreamPool")
+        .def(py::init([](std::size_t max_streams) {
+                return std::make_shared<ExchangeStreamPool>(nullptr, max_streams);
+             }),
+             py::arg("max_streams") = 64)
+        .def("unary_only", &ExchangeStreamPool::unary_only, py::arg("address"))
+        .def("contains", &ExchangeStreamPool::contains, py::arg("address"))
+        .def("size", &ExchangeStreamPool::size)
+        .def("max_streams", &ExchangeStreamPool::max_streams)
+        .def("close", &ExchangeStreamPool::close, py::arg("address"))
+        .def("clear", &ExchangeStreamPool::clear);
+
+    py::class_<ChannelPool, std::shared_ptr<ChannelPool>>(m, "ChannelPool")
+        .def_static("global_pool", &ChannelPool::global)
+        .def("set_in_process", &ChannelPool::set_in_process, py::arg("in_process"))
+        .def("in_process", &ChannelPool::in_process)
+        .def("contains", &ChannelPool::contains, py::arg("address"))
+        .def("size", &ChannelPool::size)
+        .def("max_channels", &ChannelPool::max_channels)
+        .def("evict", &ChannelPool::evict, py::arg("address"))
+        .def("clear", &ChannelPool::clear)
+        .def("__str__", &ChannelPool::print);
+
+    py::class_<EntrySampler, std::shared_ptr<EntrySampler>>(m, "EntrySampler")
+        .def(py::init<std::shared_ptr<View>, std::chrono::milliseconds, std::size_t, std::size_t>(),
+             py::arg("view"), py::arg("refresh") = std::chrono::milliseconds(100),
+             py::arg("num_samples") = 16, py::arg("reservoir_size") = 256)
+        .def("start", &EntrySampler::start)
+        .def("stop", &EntrySampler::stop)
+        .def("refresh", &EntrySampler::refresh)
+        .def("set_redirects", &EntrySampler::set_redirects, py::arg("redirects"))
+        .def("redirects", &EntrySampler::redirects)
+        .def("active", &EntrySampler::active)
+        .def("reservoir", &EntrySampler::reservoir)
+        .def("offered", &EntrySampler::offered)
+        .def("refresh_interval", &EntrySampler::refresh_interval)
+        .def("num_samples", &EntrySampler::num_samples)
+        .def("reservoir_size", &EntrySampler::reservoir_size);
+
+    py::class_<AdmissionControl, std::shared_ptr<AdmissionControl>>(m, "AdmissionControl")
+        .def(py::init<double, double, std::size_t, std::size_t>(),
+             py::arg("rate"), py::arg("burst"), py::arg("max_in_flight") = 0, py::arg("max_sources") = 4096)
+        .def("admit", &AdmissionControl::admit, py::arg("source"))
+        .def("release", &AdmissionControl::release)
+        .def("in_flight", &AdmissionControl::in_flight)
+        .def("accepted", &AdmissionControl::accepted)
+        .def("rejected", &AdmissionControl::rejected)
+        .def("rejected_rate", &AdmissionControl::rejected_rate)
+        .def("rejected_in_flight", &AdmissionControl::rejected_in_flight)
+        .def("size", &AdmissionControl::size)
+        .def("rate", &AdmissionControl::rate)
+        .def("burst", &AdmissionControl::burst)
+        .def("max_in_flight", &AdmissionControl::max_in_flight)
+        .def("__str__", &AdmissionControl::print);
+
+    py::class_<MergeQueue, std::shared_ptr<MergeQueue>>(m, "MergeQueue")
+        .def(py::init<std::shared_ptr<View>, std::size_t, std::chrono::microseconds, std::size_t>(),
+             py::arg("view"), py::arg("batch_size") = 64, py::arg("max_delay") = std::chrono::microseconds(1000),
+             py::arg("max_pending") = 4096)
+        .def("flush", &MergeQueue::flush, py::call_guard<py::gil_scoped_release>())
+        .def("pending", &MergeQueue::pending)
+        .def("merged", &MergeQueue::merged)
+        .def("batches", &MergeQueue::batches)
+        .def("dropped", &MergeQueue::dropped)
+        .def("batch_size", &MergeQueue::batch_size)
+        .def("max_delay", &MergeQueue::max_delay)
+        .def("max_pending", &MergeQueue::max_pending);
+
+    py::class_<ServerOptions>(m, "ServerOptions")
+        .def(py::init<>())
+        .def_readwrite("memory_quota", &ServerOptions::memory_quota)
+        .def_readwrite("max_concurrent_streams", &ServerOptions::max_concurrent_streams)
+        .def_readwrite("keepalive_time", &ServerOptions::keepalive_time)
+        .def_readwrite("keepalive_timeout", &ServerOptions::keepalive_timeout)
+        .def_readwrite("min_ping_interval", &ServerOptions::min_ping_interval)
+        .def_readwrite("max_connection_idle", &ServerOptions::max_connection_idle)
+        .def_readwrite("shutdown_grace", &ServerOptions::shutdown_grace);
+
+    py::class_<Transport, std::shared_ptr<Transport>>(m, "Transport");
+
+    py::class_<LoopbackTransport, Transport, std::shared_ptr<LoopbackTransport>>(m, "LoopbackTransport")
+        .def(py::init<>())
+        .def("serving", &LoopbackTransport::serving, py::arg("address"))
+        .def("unserve", &LoopbackTransport::unserve, py::arg("address"))
+        .def("size", &LoopbackTransport::size)
+        .def("exchanges", &LoopbackTransport::exchanges);
+
+    py::class_<UdpTransport, Transport, std::shared_ptr<UdpTransport>>(m, "UdpTransport")
+        .def(py::init<std::string, std::size_t>(), py::arg("address"), py::arg("batch_size") = 32)
+        .def("start", &UdpTransport::start)
+        .def("stop", &UdpTransport::stop, py::call_guard<py::gil_scoped_release>())
+        .def("active", &UdpTransport::active)
+        .def("serving", &UdpTransport::serving)
+        .def("pending", &UdpTransport::pending)
+        .def("address", &UdpTransport::address)
+        .def("batch_size", &UdpTransport::batch_size);
+
     // Expose PeerSamplingService class
     py::class_<PeerSamplingService, std::shared_ptr<PeerSamplingService>>(m, "PeerSamplingService")
         .def(py::init<bool, bool, unsigned int, unsigned int, std::vector<std::string>&, std::shared_ptr<View>>(),
              py::arg("push"), py::arg("pull"), py::arg("wait_time"), py::arg("timeout"),
              py::arg("entry_points") = std::vector<std::string>(), py::arg("view"))
-        .def("enter", &PeerSamplingService::enter)
+        // Fractional seconds, kept to the millisecond
+        .def(py::init([](bool push, bool pull, double wait_time, double timeout, std::vector<std::string>& entry_points, std::shared_ptr<View> view) {
+                return std::make_shared<PeerSamplingService>(push, pull,
+                    std::chrono::milliseconds(static_cast<int64_t>(std::llround(wait_time * 1000))),
+                    std::chrono::milliseconds(static_cast<int64_t>(std::llround(timeout * 1000))),
+                    entry_points, view);
+             }),
+             py::arg("push"), py::arg("pull"), py::arg("wait_time"), py::arg("timeout"),
+             py::arg("entry_points") = std::vector<std::string>(), py::arg("view"))
+        .def("enter", &PeerSamplingService::enter, py::call_guard<py::gil_scoped_release>())
         .def("exit", &PeerSamplingService::exit)
         .def("start_server", &PeerSamplingService::start_server)
         .def("stop_server", &PeerSamplingService::stop_server)
@@ -273,8 +491,41 @@ PYBIND11_MODULE(_gossip, m) {
         .def("pull", &PeerSamplingService::pull)
         .def("entered", &PeerSamplingService::entered)
         .def("wait_time", &PeerSamplingService::wait_time)
+        .def("wait_time_ms", &PeerSamplingService::wait_time_ms)
+        .def("set_jitter", &PeerSamplingService::set_jitter, py::arg("jitter"))
+        .def("jitter", &PeerSamplingService::jitter)
+        .def("set_entry_fanout", &PeerSamplingService::set_entry_fanout, py::arg("entry_fanout"))
+        .def("entry_fanout", &PeerSamplingService::entry_fanout)
+        .def("set_fanout", &PeerSamplingService::set_fanout, py::arg("fanout"))
+        .def("fanout", &PeerSamplingService::fanout)
+        .def("set_max_in_flight", &PeerSamplingService::set_max_in_flight, py::arg("max_in_flight"))
+        .def("max_in_flight", &PeerSamplingService::max_in_flight)
         .def("timeout", &PeerSamplingService::timeout)
+        .def("timeout_ms", &PeerSamplingService::timeout_ms)
+        .def("set_rtt_tracker", &PeerSamplingService::set_rtt_tracker, py::arg("rtt_tracker"))
+        .def("rtt_tracker", &PeerSamplingService::rtt_tracker)
+        .def("set_failure_detector", &PeerSamplingService::set_failure_detector, py::arg("failure_detector"))
+        .def("failure_detector", &PeerSamplingService::failure_detector)
+        .def("set_exchange_streams", &PeerSamplingService::set_exchange_streams, py::arg("exchange_streams"))
+        .def("exchange_streams", &PeerSamplingService::exchange_streams)
+        .def("set_transport", &PeerSamplingService::set_transport, py::arg("transport"))
+        .def("transport", &PeerSamplingService::transport)
+        .def("set_local_address", &PeerSamplingService::set_local_address, py::arg("local_address"))
+        .def("local_address", &PeerSamplingService::local_address)
+        .def("add_local_route", &PeerSamplingService::add_local_route, py::arg("address"), py::arg("target"))
+        .def("remove_local_route", &PeerSamplingService::remove_local_route, py::arg("address"))
+        .def("channel_pool", &PeerSamplingService::channel_pool)
+        .def("set_entry_sampler", &PeerSamplingService::set_entry_sampler, py::arg("entry_sampler"))
+        .def("entry_sampler", &PeerSamplingService::entry_sampler)
+        .def("set_admission_control", &PeerSamplingService::set_admission_control, py::arg("admission_control"))
+        .def("admission_control", &PeerSamplingService::admission_control)
+        .def("set_merge_queue", &PeerSamplingService::set_merge_queue, py::arg("merge_queue"))
+        .def("merge_queue", &PeerSamplingService::merge_queue)
+        .def("set_server_options", &PeerSamplingService::set_server_options, py::arg("options"))
+        .def("server_options", &PeerSamplingService::server_options)
         .def("view", &PeerSamplingService::view)
+        .def("set_scheduler", &PeerSamplingService::set_scheduler, py::arg("scheduler"))
+        .def("scheduler", &PeerSamplingService::scheduler)
         .def("__str__", &PeerSamplingService::print);  // Allows the use of str() in Python
 }
 }
\ No newline at end of file
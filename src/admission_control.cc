@@ -0,0 +1,117 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "admission_control.h"
+
+namespace gossip {
+
+bool AdmissionControl::admit(const std::string& source) {
+    // The in flight cap is checked first, it costs no lock
+    std::size_t current = _in_flight.load();
+    do {
+        if (_max_in_flight > 0 && current >= _max_in_flight) {
+            _rejected_in_flight++;
+            return false;
+        }
+    } while (!_in_flight.compare_exchange_weak(current, current + 1));
+
+    if (_rate > 0 && !source.empty() && !take_token(source)) {
+        _in_flight--;
+        _rejected_rate++;
+        return false;
+    }
+    _accepted++;
+    return true;
+}
+
+void AdmissionControl::release() {
+    _in_flight--;
+}
+
+bool AdmissionControl::take_token(const std::string& source) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _buckets.find(source);
+    if (found == _buckets.end()) {
+        if (_buckets.size() >= _max_sources) {
+            remove_refilled(now);
+        }
+        if (_buckets.size() >= _max_sources) {
+            // Every source tracked is still being limited, newcomers wait until one of them refills
+            return false;
+        }
+        _lru.push_front(Bucket{source, _burst, now});
+        found = _buckets.emplace(source, _lru.begin()).first;
+    }
+    else {
+        // Move to front, iterators into a std::list stay valid
+        _lru.splice(_lru.begin(), _lru, found->second);
+    }
+    Bucket& bucket = *found->second;
+    double elapsed = std::chrono::duration<double>(now - bucket.last_refill).count();
+    bucket.tokens = std::min(_burst, bucket.tokens + elapsed * _rate);
+    bucket.last_refill = now;
+    if (bucket.tokens < 1.0) {
+        return false;
+    }
+    bucket.tokens -= 1.0;
+    return true;
+}
+
+bool AdmissionControl::refilled(const Bucket& bucket, std::chrono::steady_clock::time_point now) const {
+    double elapsed = std::chrono::duration<double>(now - bucket.last_refill).count();
+    return bucket.tokens + elapsed * _rate >= _burst;
+}
+
+void AdmissionControl::remove_refilled(std::chrono::steady_clock::time_point now) {
+    // Only the least recently seen are looked at, each bucket is dropped at most once so a full table costs O(1) amortized
+    // per newcomer. A refilled bucket behind one still limited stays until that one is dropped or seen again.
+    while (!_lru.empty() && refilled(_lru.back(), now)) {
+        _buckets.erase(_lru.back().source);
+        _lru.pop_back();
+    }
+}
+
+std::size_t AdmissionControl::size() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _buckets.size();
+}
+
+std::string AdmissionControl::print() const {
+    std::string str = "AdmissionControl(Rate: " + std::to_string(_rate)
+        + ", Burst: " + std::to_string(_burst)
+        + ", MaxInFlight: " + std::to_string(_max_in_flight)
+        + ", InFlight: " + std::to_string(_in_flight)
+        + ", Accepted: " + std::to_string(_accepted)
+        + ", RejectedRate: " + std::to_string(_rejected_rate)
+        + ", RejectedInFlight: " + std::to_string(_rejected_in_flight)
+        + ", Sources: " + std::to_string(size()) + ")";
+    return str;
+}
+
+}
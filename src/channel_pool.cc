@@ -0,0 +1,160 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <string>
+#include <list>
+#include <iterator>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+
+#include <grpcpp/grpcpp.h>
+
+#include "local_channels.h"
+#include "channel_pool.h"
+
+namespace gossip {
+
+std::shared_ptr<ChannelPool> ChannelPool::global() {
+    static std::shared_ptr<ChannelPool> pool = std::make_shared<ChannelPool>(256, std::chrono::seconds(60));
+    return pool;
+}
+
+ChannelPool::~ChannelPool() {
+    // Channels still held by an exchange are released by that exchange now
+    clear();
+}
+
+std::shared_ptr<GossipProtocol::Stub> ChannelPool::stub(const std::string& address) {
+    std::lock_guard<std::mutex> lock(_lock);
+    return acquire(address)->stub;
+}
+
+std::shared_ptr<::grpc::Channel> ChannelPool::channel(const std::string& address) {
+    std::lock_guard<std::mutex> lock(_lock);
+    return acquire(address)->channel;
+}
+
+std::list<ChannelPool::Entry>::iterator ChannelPool::acquire(const std::string& address) {
+    auto now = std::chrono::steady_clock::now();
+    remove_idle(now);
+
+    auto found = _lut.find(address);
+    // An in-process channel outlives the server it leads to only until that server is stopped
+    if (found != _lut.end() && found->second->local_id != 0
+        && !LocalChannels::global().hosts(address, found->second->local_id)) {
+        retire(found->second);
+        _lut.erase(found);
+        found = _lut.end();
+    }
+    if (found != _lut.end()) {
+        // Move to front, iterators into a std::list stay valid
+        _lru.splice(_lru.begin(), _lru, found->second);
+        found->second->last_used = now;
+        return found->second;
+    }
+
+    while (!_lru.empty() && _lru.size() >= _max_channels) {
+        remove_lru();
+    }
+
+    // Stubs are handed out as shared_ptrs so exchanges in flight on an evicted channel keep it alive until they finish
+    uint64_t local_id = 0;
+    std::shared_ptr<::grpc::Channel> channel;
+    if (_in_process) {
+        channel = LocalChannels::global().in_process_channel(address, local_id);
+    }
+    if (!channel) {
+        channel = ::grpc::CreateChannel(LocalChannels::global().route(address), ::grpc::InsecureChannelCredentials());
+    }
+    std::shared_ptr<GossipProtocol::Stub> stub = GossipProtocol::NewStub(channel);
+    _lru.push_front(Entry{address, channel, stub, now, local_id});
+    _lut[address] = _lru.begin();
+    return _lru.begin();
+}
+
+void ChannelPool::remove_idle(std::chrono::steady_clock::time_point now) {
+    while (!_lru.empty() && now - _lru.back().last_used > _idle_timeout) {
+        remove_lru();
+    }
+    release_retired();
+}
+
+void ChannelPool::remove_lru() {
+    _lut.erase(_lru.back().address);
+    retire(std::prev(_lru.end()));
+}
+
+void ChannelPool::retire(std::list<Entry>::iterator entry) {
+    _retired.splice(_retired.end(), _lru, entry);
+}
+
+void ChannelPool::release_retired() {
+    // Only the pool holds the stub once every exchange on it has completed
+    for (auto it = _retired.begin(); it != _retired.end();) {
+        if (it->stub.use_count() == 1) {
+            it = _retired.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void ChannelPool::evict(const std::string& address) {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _lut.find(address);
+    if (found != _lut.end()) {
+        retire(found->second);
+        _lut.erase(found);
+    }
+}
+
+void ChannelPool::clear() {
+    std::lock_guard<std::mutex> lock(_lock);
+    _lut.clear();
+    _retired.splice(_retired.end(), _lru);
+    release_retired();
+}
+
+bool ChannelPool::contains(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _lut.find(address) != _lut.end();
+}
+
+std::size_t ChannelPool::size() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _lru.size();
+}
+
+std::string ChannelPool::print() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    std::string str = "ChannelPool(MaxChannels: " + std::to_string(_max_channels)
+        + ", IdleTimeout: " + std::to_string(_idle_timeout.count()) + "ms"
+        + ", InProcess: " + (_in_process ? "true" : "false")
+        + ", Channels: ";
+    for (auto& entry : _lru) {
+        str += entry.address + ", ";
+    }
+    str += ")";
+    return str;
+}
+
+}
@@ -23,6 +23,12 @@
 #include <thread>
 #include <future>
 #include <atomic>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <random>
+#include <algorithm>
 
 #include <grpcpp/grpcpp.h>
 
@@ -31,133 +37,402 @@
 
 namespace gossip {
 
-::grpc::Status ClientSession::push_view(const ViewProto& tx_buf, std::shared_ptr<::google::protobuf::Empty> dummy_resp) {
-    ::grpc::ClientContext context;
-    auto deadline = std::chrono::system_clock::now() + std::chrono::seconds(_timeout);
-    context.set_deadline(deadline);
+void ClientSession::set_deadline() {
+    auto deadline = std::chrono::system_clock::now() + _timeout;
+    _context.set_deadline(deadline);
+}
 
-    std::promise<::grpc::Status> status_promise;
-    auto status_future = status_promise.get_future();
+void ClientSession::merge(std::shared_ptr<View> view, const ViewProto& rx_buf, bool age) {
+    // Convert ViewProto to std::vector<std::shared_ptr<NodeDescriptor>>
+    std::vector<std::shared_ptr<NodeDescriptor>> new_nodes = ViewProtoHelper<NodeDescriptor>::make_internal(rx_buf);
+    // Pass to view obj
+    view->rx_nodes(new_nodes);
+    if (age) {
+        view->increment_age();
+    }
+}
 
-    _stub->async()->PushView(&context, &tx_buf, dummy_resp.get(), [&status_promise, this](::grpc::Status status) mutable {
-        if (status.ok()) {
-            //std::cout << "Successful Push rpc to: " << _server_address << std::endl;
-        }
-        else {
-            //std::cout << "Failed Push rpc to: " << _server_address << std::endl;
-        }
-        status_promise.set_value(status);
+void ClientSession::push_view(std::shared_ptr<ViewProto> tx_buf, Received done) {
+    set_deadline();
+    _tx_buf = tx_buf;
+    std::shared_ptr<ClientSession> self = shared_from_this();
+    _stub->async()->PushView(&_context, _tx_buf.get(), &_empty_resp, [self, done](::grpc::Status status) {
+        done(status, self->_rx_buf);
     });
-    return status_future.get();
 }
 
-::grpc::Status ClientSession::pull_view(const ::google::protobuf::Empty& dummy_req, std::shared_ptr<ViewProto> rx_buf) {
+void ClientSession::pull_view(Received done) {
+    set_deadline();
+    std::shared_ptr<ClientSession> self = shared_from_this();
+    _stub->async()->PullView(&_context, &_empty_req, &_rx_buf, [self, done](::grpc::Status status) {
+        done(status, self->_rx_buf);
+    });
+}
 
-    ::grpc::ClientContext context;
-    auto deadline = std::chrono::system_clock::now() + std::chrono::seconds(_timeout);
-    context.set_deadline(deadline);
-    
-    std::promise<::grpc::Status> status_promise;
-    auto status_future = status_promise.get_future();
+void ClientSession::push_pull_view(std::shared_ptr<ViewProto> tx_buf, Received done) {
+    set_deadline();
+    _tx_buf = tx_buf;
+    std::shared_ptr<ClientSession> self = shared_from_this();
+    _stub->async()->PushPullView(&_context, _tx_buf.get(), &_rx_buf, [self, done](::grpc::Status status) {
+        done(status, self->_rx_buf);
+    });
+}
 
-    _stub->async()->PullView(&context, &dummy_req, rx_buf.get(), [rx_buf, &status_promise, this](::grpc::Status status) {
-        if (!status.ok()) {
-            //std::cout << "Failed Pull rpc to: " << _server_address << std::endl; 
-        }
-        else {
-            // Convert ViewProto to std::vector<std::shared_ptr<NodeDescriptor>>
-            std::vector<std::shared_ptr<NodeDescriptor>> new_nodes = ViewProtoHelper<NodeDescriptor>::make_internal(*rx_buf);
-            // Pass to view obj
-            _view->rx_nodes(new_nodes);
-            _view->increment_age(); 
-            //std::cout << "Successful Pull rpc to: " << _server_address << std::endl;
-        }
-        status_promise.set_value(status);
+::grpc::Status Client::wait(std::function<void(Callback)> start) {
+    std::shared_ptr<std::promise<::grpc::Status>> status_promise = std::make_shared<std::promise<::grpc::Status>>();
+    auto status_future = status_promise->get_future();
+    start([status_promise](::grpc::Status status) {
+        status_promise->set_value(status);
     });
     return status_future.get();
 }
 
-::grpc::Status ClientSession::push_pull_view(const ViewProto& tx_buf, std::shared_ptr<ViewProto> rx_buf) {
-    // Make data for the push    
-    ::grpc::ClientContext context;
-    auto deadline = std::chrono::system_clock::now() + std::chrono::seconds(_timeout);
-    context.set_deadline(deadline);
+::grpc::Status Client::push_view() {
+    return wait([this](Callback done) { async_push_view(done); });
+}
 
-    std::promise<::grpc::Status> status_promise;
-    auto status_future = status_promise.get_future();
+::grpc::Status Client::pull_view() {
+    return wait([this](Callback done) { async_pull_view(done); });
+}
 
-    _stub->async()->PushPullView(&context, &tx_buf, rx_buf.get(), [rx_buf, &status_promise, this](::grpc::Status status) {
-        if (!status.ok()) { 
-            //std::cout << "Failed PushPull rpc to: " << _server_address << std::endl;
-        }
-        else {
-            // Convert ViewProto to std::vector<std::shared_ptr<NodeDescriptor>>
-            std::vector<std::shared_ptr<NodeDescriptor>> new_nodes = ViewProtoHelper<NodeDescriptor>::make_internal(*rx_buf);
-            // Pass to view obj
-            _view->rx_nodes(new_nodes);
-            _view->increment_age();
-            //std::cout << "Successful PushPull rpc to: " << _server_address << std::endl;
-        }
-        status_promise.set_value(status);
-    });
-    return status_future.get();
+::grpc::Status Client::push_pull_view() {
+    return wait([this](Callback done) { async_push_pull_view(done); });
 }
 
-::grpc::Status Client::push_view() {
+::grpc::Status Client::push_view(std::string address) {
+    return wait([this, &address](Callback done) { async_push_view(address, done); });
+}
+
+::grpc::Status Client::pull_view(std::string address) {
+    return wait([this, &address](Callback done) { async_pull_view(address, done); });
+}
+
+::grpc::Status Client::push_pull_view(std::string address) {
+    return wait([this, &address](Callback done) { async_push_pull_view(address, done); });
+}
+
+void Client::async_push_view(Callback done) {
     std::shared_ptr<NodeDescriptor> peer = _view->select_peer();
     if (!peer) {
-        return ::grpc::Status(::grpc::StatusCode::NOT_FOUND, "No Peer was selected to push view to.");
+        if (done) {
+            done(::grpc::Status(::grpc::StatusCode::NOT_FOUND, "No Peer was selected to push view to."));
+        }
+        return;
     }
-    return push_view(peer->address());
+    async_push_view(peer->address(), done);
 }
 
-::grpc::Status Client::pull_view() {
+void Client::async_pull_view(Callback done) {
     std::shared_ptr<NodeDescriptor> peer = _view->select_peer();
     if (!peer) {
-        return ::grpc::Status(::grpc::StatusCode::NOT_FOUND, "No Peer was selected to pull view from.");
+        if (done) {
+            done(::grpc::Status(::grpc::StatusCode::NOT_FOUND, "No Peer was selected to pull view from."));
+        }
+        return;
     }
-    return pull_view(peer->address());
+    async_pull_view(peer->address(), done);
 }
 
-::grpc::Status Client::push_pull_view() {    
+void Client::async_push_pull_view(Callback done) {
     std::shared_ptr<NodeDescriptor> peer = _view->select_peer();
     if (!peer) {
-        return ::grpc::Status(::grpc::StatusCode::NOT_FOUND, "No Peer was selected to push/pull from.");
+        if (done) {
+            done(::grpc::Status(::grpc::StatusCode::NOT_FOUND, "No Peer was selected to push/pull from."));
+        }
+        return;
     }
-    return push_pull_view(peer->address());
+    async_push_pull_view(peer->address(), done);
 }
 
+void Client::async_push_view(const std::string& address, Callback done) {
+    async_exchange(Exchange::PUSH, address, true, done);
+}
 
-::grpc::Status Client::push_view(std::string address) {
+void Client::async_pull_view(const std::string& address, Callback done) {
+    async_exchange(Exchange::PULL, address, true, done);
+}
+
+void Client::async_push_pull_view(const std::string& address, Callback done) {
+    async_exchange(Exchange::PUSH_PULL, address, true, done);
+}
+
+void Client::async_gossip_round(Callback done) {
+    Exchange type = exchange_type();
+    std::vector<std::string> peers = select_peers(_fanout);
+    if (peers.empty()) {
+        if (done) {
+            done(::grpc::Status(::grpc::StatusCode::NOT_FOUND, "No Peer was selected for the gossip round."));
+        }
+        return;
+    }
+    // One tx buffer for the whole round, every peer is sent the same nodes
+    std::shared_ptr<ViewProto> tx_buffer = make_tx_buffer(type);
+    if (type == Exchange::PUSH) {
+        // Sending is what ages the view on a push, so age once for the round
+        _view->increment_age();
+    }
+
+    // Shared by every exchange of the round, the last to complete reports the round
+    struct Round {
+        std::mutex lock;
+        std::size_t remaining;
+        bool succeeded;
+        ::grpc::Status status;
+    };
+    std::shared_ptr<Round> round = std::make_shared<Round>();
+    round->remaining = peers.size();
+    round->succeeded = false;
+    std::shared_ptr<View> view = _view;
+    Callback exchanged = [round, type, view, done](::grpc::Status status) {
+        {
+            std::lock_guard<std::mutex> lock(round->lock);
+            if (status.ok()) {
+                round->succeeded = true;
+            }
+            else if (!round->succeeded) {
+                round->status = status;
+            }
+            if (--round->remaining > 0) {
+                return;
+            }
+        }
+        if (type != Exchange::PUSH && round->succeeded) {
+            view->increment_age();
+        }
+        if (done) {
+            done(round->succeeded ? ::grpc::Status::OK : round->status);
+        }
+    };
+
+    for (auto& peer : peers) {
+        if (!acquire_slot()) {
+            exchanged(::grpc::Status(::grpc::StatusCode::RESOURCE_EXHAUSTED, "Too many exchanges in flight."));
+            continue;
+        }
+        send_exchange(type, peer, tx_buffer, false, exchanged);
+    }
+}
+
+void Client::async_exchange(Exchange type, const std::string& address, bool age, Callback done) {
+    if (!acquire_slot()) {
+        if (done) {
+            done(::grpc::Status(::grpc::StatusCode::RESOURCE_EXHAUSTED, "Too many exchanges in flight."));
+        }
+        return;
+    }
+    std::shared_ptr<ViewProto> tx_buffer = make_tx_buffer(type);
+    if (type == Exchange::PUSH && age) {
+        _view->increment_age();
+    }
+    send_exchange(type, address, tx_buffer, age, done);
+}
+
+std::shared_ptr<ViewProto> Client::make_tx_buffer(Exchange type) {
+    if (type == Exchange::PULL) {
+        return nullptr;
+    }
     std::vector<std::shared_ptr<NodeDescriptor>> send_nodes = _view->tx_nodes();
-    _view->increment_age();
-    ViewProto tx_buffer = ViewProtoHelper<NodeDescriptor>::make_proto(send_nodes);
-    
-    std::shared_ptr<::google::protobuf::Empty> dummy_resp = std::make_shared<::google::protobuf::Empty>();
+    std::shared_ptr<ViewProto> tx_buffer = std::make_shared<ViewProto>();
+    ViewProtoHelper<NodeDescriptor>::add_to_proto(send_nodes, *tx_buffer);
+    return tx_buffer;
+}
 
-    ClientSession sess(_view, address, _timeout);
+void Client::send_exchange(Exchange type, const std::string& address, std::shared_ptr<ViewProto> tx_buffer, bool age, Callback done) {
+    Transport::Callback received = measure(address, merge(type, age, complete(address, done)));
+    std::shared_ptr<Transport> transport = std::atomic_load(&_transport);
+    if (transport) {
+        transport->exchange(address, request_type(type), tx_buffer, timeout(address), received);
+        return;
+    }
+    std::shared_ptr<ExchangeStreamPool> exchange_streams = std::atomic_load(&_exchange_streams);
+    if (exchange_streams && !exchange_streams->unary_only(address)) {
+        stream_exchange(exchange_streams, type, address, tx_buffer, received);
+        return;
+    }
+    unary_exchange(type, address, tx_buffer, received);
+}
 
-    return sess.push_view(tx_buffer, dummy_resp);
+void Client::unary_exchange(Exchange type, const std::string& address, std::shared_ptr<ViewProto> tx_buf, Transport::Callback done) {
+    std::shared_ptr<ClientSession> sess = std::make_shared<ClientSession>(address, timeout(address), _channel_pool);
+    if (type == Exchange::PULL) {
+        sess->pull_view(done);
+    }
+    else if (type == Exchange::PUSH) {
+        sess->push_view(tx_buf, done);
+    }
+    else {
+        sess->push_pull_view(tx_buf, done);
+    }
 }
 
-::grpc::Status Client::pull_view(std::string address) {
-    ::google::protobuf::Empty dummy_req;
-    std::shared_ptr<ViewProto> rx_buffer = std::make_shared<ViewProto>();
+void Client::stream_exchange(std::shared_ptr<ExchangeStreamPool> exchange_streams, Exchange type, const std::string& address,
+                             std::shared_ptr<ViewProto> tx_buf, Transport::Callback done) {
+    std::shared_ptr<Client> self = shared_from_this();
+    exchange_streams->exchange(address, request_type(type), tx_buf, timeout(address), 
+        [self, type, address, tx_buf, done](::grpc::Status status, const ViewProto& rx_buf) {
+            if (status.error_code() == ::grpc::StatusCode::UNIMPLEMENTED) {
+                // The peer's server predates the stream, the pool has marked it unary only so this is the last attempt
+                self->unary_exchange(type, address, tx_buf, done);
+                return;
+            }
+            done(status, rx_buf);
+        });
+}
 
-    ClientSession sess(_view, address, _timeout);
+Transport::Callback Client::merge(Exchange type, bool age, Callback done) {
+    std::shared_ptr<View> view = _view;
+    return [view, type, age, done](::grpc::Status status, const ViewProto& rx_buf) {
+        if (status.ok() && type != Exchange::PUSH) {
+            ClientSession::merge(view, rx_buf, age);
+        }
+        done(status);
+    };
+}
 
-    return sess.pull_view(dummy_req, rx_buffer);
+ExchangeRequest::Type Client::request_type(Exchange type) {
+    if (type == Exchange::PUSH) {
+        return ExchangeRequest::PUSH;
+    }
+    return type == Exchange::PULL ? ExchangeRequest::PULL : ExchangeRequest::PUSH_PULL;
 }
 
-::grpc::Status Client::push_pull_view(std::string address) {
-    std::vector<std::shared_ptr<NodeDescriptor>> send_nodes = _view->tx_nodes();
-    ViewProto tx_buffer = ViewProtoHelper<NodeDescriptor>::make_proto(send_nodes);
-    
-    std::shared_ptr<ViewProto> rx_buffer = std::make_shared<ViewProto>();
+Client::Exchange Client::exchange_type() const {
+    if (_push && _pull) {
+        return Exchange::PUSH_PULL;
+    }
+    return _push ? Exchange::PUSH : Exchange::PULL;
+}
 
-    ClientSession sess(_view, address, _timeout);
+std::vector<std::string> Client::select_peers(unsigned int count) {
+    std::shared_ptr<FailureDetector> failure_detector = std::atomic_load(&_failure_detector);
+    std::vector<std::string> peers;
+    std::vector<std::string> suspects;
+    std::vector<std::shared_ptr<NodeDescriptor>> selected;
+    // Peers come back distinct, so only passing over suspects can leave the round short. Then draw once more with room
+    // for the suspects seen, up to a bound so a view of nothing but suspects still ends.
+    unsigned int num_select = count;
+    for (int draw = 0; draw < 2 && peers.size() < count; ++draw) {
+        _view->select_peers(num_select, selected);
+        for (auto& peer : selected) {
+            const std::string& address = peer->address();
+            if (peers.size() >= count) {
+                break;
+            }
+            if (std::find(peers.begin(), peers.end(), address) != peers.end() ||
+                std::find(suspects.begin(), suspects.end(), address) != suspects.end()) {
+                continue;
+            }
+            if (failure_detector && failure_detector->suspected(address)) {
+                suspects.push_back(address);
+                continue;
+            }
+            peers.push_back(address);
+        }
+        // Short of num_select means the view holds no more, drawing again would only repeat them
+        if (suspects.empty() || selected.size() < num_select) {
+            break;
+        }
+        num_select = count + std::min<unsigned int>(suspects.size(), 16);
+    }
+    // Fall back on suspects rather than skip the round, probing them is what clears or evicts them
+    for (auto& suspect : suspects) {
+        if (peers.size() >= count) {
+            break;
+        }
+        peers.push_back(suspect);
+    }
+    return peers;
+}
 
-    return sess.push_pull_view(tx_buffer, rx_buffer);
+bool Client::acquire_slot() {
+    unsigned int current = _in_flight.load();
+    do {
+        if (current >= _max_in_flight) {
+            return false;
+        }
+    } while (!_in_flight.compare_exchange_weak(current, current + 1));
+    return true;
+}
+
+std::chrono::milliseconds Client::timeout(const std::string& address) const {
+    std::shared_ptr<RttTracker> rtt_tracker = std::atomic_load(&_rtt_tracker);
+    if (!rtt_tracker) {
+        return _timeout;
+    }
+    return std::min(rtt_tracker->timeout(address), _timeout);
+}
+
+Transport::Callback Client::measure(const std::string& address, Transport::Callback done) {
+    std::shared_ptr<RttTracker> rtt_tracker = std::atomic_load(&_rtt_tracker);
+    if (!rtt_tracker) {
+        return done;
+    }
+    auto start = std::chrono::steady_clock::now();
+    return [address, done, rtt_tracker, start](::grpc::Status status, const ViewProto& rx_buf) {
+        if (status.ok()) {
+            rtt_tracker->record(address, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+        }
+        else if (status.error_code() == ::grpc::StatusCode::DEADLINE_EXCEEDED) {
+            rtt_tracker->record_timeout(address);
+        }
+        done(status, rx_buf);
+    };
+}
+
+Client::Callback Client::complete(const std::string& address, Callback done) {
+    std::shared_ptr<Client> self = shared_from_this();
+    return [self, address, done](::grpc::Status status) {
+        // A pooled channel to an unreachable peer sits in reconnect backoff, drop it so the next exchange dials fresh
+        if (status.error_code() == ::grpc::StatusCode::UNAVAILABLE) {
+            self->_channel_pool->evict(address);
+        }
+        self->track_failure(address, status);
+        self->_in_flight--;
+        if (done) {
+            done(status);
+        }
+    };
+}
+
+void Client::track_failure(const std::string& address, const ::grpc::Status& status) {
+    std::shared_ptr<FailureDetector> failure_detector = std::atomic_load(&_failure_detector);
+    if (!failure_detector) {
+        return;
+    }
+    if (status.ok()) {
+        failure_detector->record_success(address);
+        return;
+    }
+    // Only failures to reach the peer count against it
+    if (status.error_code() != ::grpc::StatusCode::UNAVAILABLE && status.error_code() != ::grpc::StatusCode::DEADLINE_EXCEEDED) {
+        return;
+    }
+    if (failure_detector->record_failure(address) != FailureDetector::State::DEAD) {
+        return;
+    }
+    _view->remove(address);
+    failure_detector->forget(address);
+    _channel_pool->evict(address);
+    std::shared_ptr<RttTracker> rtt_tracker = std::atomic_load(&_rtt_tracker);
+    if (rtt_tracker) {
+        rtt_tracker->forget(address);
+    }
+}
+
+void Client::gossip_round() {
+    if (!_push && !_pull) {
+        return;
+    }
+    async_gossip_round();
+}
+
+std::chrono::milliseconds Client::next_wait_time() const {
+    if (_jitter.count() == 0) {
+        return _wait_time;
+    }
+    thread_local std::mt19937 eng(std::random_device{}());
+    std::uniform_int_distribution<std::chrono::milliseconds::rep> offset(-_jitter.count(), _jitter.count());
+    return _wait_time + std::chrono::milliseconds(offset(eng));
 }
 
 
@@ -166,7 +441,7 @@ Client::Thread::~Thread() {
 }
 
 void Client::Thread::stop() {
-    _active = false;
+    signal();
     if (_thread.joinable()) {
         _thread.join();
         //std::cout << "Client thread stopped" << std::endl;
@@ -174,26 +449,43 @@ void Client::Thread::stop() {
 }
 
 void Client::Thread::signal() {
-    _active = false;
+    {
+        // Flipped under the lock so the thread cannot miss the wake up between checking and waiting
+        std::lock_guard<std::mutex> lock(_lock);
+        _active = false;
+    }
+    _wake.notify_all();
+    if (_scheduler && _task_id) {
+        _scheduler->cancel(_task_id);
+        _task_id = 0;
+    }
 }
 
 void Client::Thread::start() {
     _active = true;
+    if (_scheduler) {
+        std::shared_ptr<Client> client = _client;
+        _task_id = _scheduler->schedule_periodic(_client->_wait_time, [client]() {
+            client->gossip_round();
+        }, _client->_jitter);
+        return;
+    }
     try {
         _thread = std::thread([this]() {
-            auto thread_id = std::this_thread::get_id();
+            auto next_round = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(_lock);
             while (_active) {
-                //std::cout << "Waking Client Thread: " << thread_id << std::endl; 
-                if (_client->_push && _client->_pull) {
-                    _client->push_pull_view();
+                lock.unlock();
+                // Rounds are fired and forgotten, completions merge into the view from gRPC threads
+                _client->gossip_round();
+                next_round += _client->next_wait_time();
+                auto now = std::chrono::steady_clock::now();
+                if (next_round < now) {
+                    // Fell behind, don't burst rounds to catch up
+                    next_round = now;
                 }
-                else if (_client->_push) {
-                    _client->push_view();
-                }
-                else if (_client->_pull) {
-                    _client->pull_view();
-                }
-                std::this_thread::sleep_for(std::chrono::seconds(_client->_wait_time));
+                lock.lock();
+                _wake.wait_until(lock, next_round, [this]() { return !_active; });
             }
         });
         //std::cout << "Client thread creation succeeded." << std::endl;
@@ -204,4 +496,4 @@ void Client::Thread::start() {
     }
 }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,140 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "view_proto_helper.h"
+#include "entry_sampler.h"
+
+namespace gossip {
+
+EntrySampler::~EntrySampler() {
+    stop();
+}
+
+void EntrySampler::start() {
+    refresh();
+    std::weak_ptr<EntrySampler> weak_self = shared_from_this();
+    Scheduler::TaskId task = _scheduler->schedule_periodic(_refresh, [weak_self]() {
+        if (std::shared_ptr<EntrySampler> self = weak_self.lock()) {
+            self->refresh();
+        }
+    });
+    std::lock_guard<std::mutex> lock(_lock);
+    if (_task) {
+        _scheduler->cancel(_task);
+    }
+    _task = task;
+}
+
+void EntrySampler::stop() {
+    std::lock_guard<std::mutex> lock(_lock);
+    if (_task) {
+        _scheduler->cancel(_task);
+        _task = 0;
+    }
+}
+
+bool EntrySampler::active() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _task != 0;
+}
+
+void EntrySampler::refresh() {
+    ViewProto admitted;
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        admitted.Swap(&_reservoir);
+        _seen = 0;
+    }
+    if (admitted.nodes_size() > 0) {
+        std::vector<std::shared_ptr<NodeDescriptor>> new_nodes = ViewProtoHelper<NodeDescriptor>::make_internal(admitted);
+        _view->rx_nodes(new_nodes);
+    }
+    // One round for the entry point however many exchanges it served
+    _view->increment_age();
+
+    std::shared_ptr<const std::vector<std::string>> redirects = std::atomic_load(&_redirects);
+    std::shared_ptr<std::vector<ViewProto>> samples = std::make_shared<std::vector<ViewProto>>(_num_samples);
+    // As many peers as tx_nodes() sends, but tx_nodes() reorders the view for the exchange it is sending
+    const std::size_t num_peers = std::max(_view->size() / 2 - 1, 0);
+    std::vector<std::shared_ptr<NodeDescriptor>> self = {_view->self()};
+    std::vector<std::shared_ptr<NodeDescriptor>> peers;
+    for (auto& sample : *samples) {
+        // Each an independent draw from the view
+        _selector->select_peers(num_peers, peers);
+        ViewProtoHelper<NodeDescriptor>::add_to_proto(self, sample);
+        ViewProtoHelper<NodeDescriptor>::add_to_proto(peers, sample);
+        for (auto& redirect : *redirects) {
+            NodeDescriptorProto* node = sample.add_nodes();
+            node->set_address(redirect);
+            node->set_age(0);
+        }
+    }
+    std::atomic_store(&_samples, std::shared_ptr<const std::vector<ViewProto>>(samples));
+}
+
+void EntrySampler::sample(ViewProto& response) const {
+    std::shared_ptr<const std::vector<ViewProto>> samples = std::atomic_load(&_samples);
+    if (samples->empty()) {
+        return;
+    }
+    // Consecutive joiners are handed different samples
+    response = (*samples)[_next.fetch_add(1, std::memory_order_relaxed) % samples->size()];
+}
+
+void EntrySampler::admit(const ViewProto& request) {
+    _offered.fetch_add(request.nodes_size(), std::memory_order_relaxed);
+    if (_reservoir_size == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_lock);
+    // Algorithm R, every descriptor pushed since the last refresh is equally likely to be kept
+    for (auto& node : request.nodes()) {
+        ++_seen;
+        if (static_cast<std::size_t>(_reservoir.nodes_size()) < _reservoir_size) {
+            *_reservoir.add_nodes() = node;
+            continue;
+        }
+        std::uniform_int_distribution<uint64_t> distr(0, _seen - 1);
+        uint64_t slot = distr(_eng);
+        if (slot < _reservoir_size) {
+            *_reservoir.mutable_nodes(slot) = node;
+        }
+    }
+}
+
+void EntrySampler::set_redirects(const std::vector<std::string>& redirects) {
+    std::atomic_store(&_redirects, std::shared_ptr<const std::vector<std::string>>(std::make_shared<const std::vector<std::string>>(redirects)));
+}
+
+std::size_t EntrySampler::reservoir() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _reservoir.nodes_size();
+}
+
+}
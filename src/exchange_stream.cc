@@ -0,0 +1,284 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <chrono>
+
+#include <grpcpp/grpcpp.h>
+
+#include "exchange_stream.h"
+
+namespace gossip {
+
+std::shared_ptr<ExchangeStream> ExchangeStream::create(std::shared_ptr<GossipProtocol::Stub> stub, 
+                                                       std::shared_ptr<Scheduler> scheduler, Closed closed) {
+    std::shared_ptr<ExchangeStream> stream = std::make_shared<ExchangeStream>(stub, scheduler, closed);
+    stream->start();
+    return stream;
+}
+
+void ExchangeStream::start() {
+    // Released in OnDone, gRPC calls back into the reactor until then
+    _self = shared_from_this();
+    _stub->async()->Exchange(&_context, this);
+    // exchange() starts writes from outside the reactions, the hold keeps OnDone back until the read loop ends
+    AddHold();
+    StartRead(&_rx_buf);
+    StartCall();
+}
+
+void ExchangeStream::exchange(ExchangeRequest::Type type, std::shared_ptr<ViewProto> tx_buf, std::chrono::milliseconds timeout, Callback done) {
+    std::unique_lock<std::mutex> lock(_lock);
+    std::shared_ptr<Scheduler> scheduler = _scheduler.lock();
+    if (_done || !scheduler) {
+        lock.unlock();
+        done(::grpc::Status(::grpc::StatusCode::UNAVAILABLE, "Exchange stream closed."), ViewProto());
+        return;
+    }
+    uint64_t id = _next_id++;
+    std::weak_ptr<ExchangeStream> weak = shared_from_this();
+    Scheduler::TaskId timer = scheduler->schedule(timeout, [weak, id]() {
+        std::shared_ptr<ExchangeStream> stream = weak.lock();
+        if (stream) {
+            stream->expire(id);
+        }
+    });
+    _pending.emplace(id, Pending{done, timer});
+
+    _writes.emplace_back();
+    ExchangeRequest& request = _writes.back();
+    request.set_id(id);
+    request.set_type(type);
+    if (type != ExchangeRequest::PULL && tx_buf) {
+        *request.mutable_view() = *tx_buf;
+    }
+    // One write in flight at a time, the rest queue behind it
+    if (!_writing) {
+        _writing = true;
+        StartWrite(&_writes.front());
+    }
+}
+
+void ExchangeStream::expire(uint64_t id) {
+    Callback done;
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        auto found = _pending.find(id);
+        if (found == _pending.end()) {
+            return;
+        }
+        done = std::move(found->second.done);
+        _pending.erase(found);
+    }
+    // The stream stays up, a late response for this id is dropped
+    done(::grpc::Status(::grpc::StatusCode::DEADLINE_EXCEEDED, "Exchange deadline exceeded."), ViewProto());
+}
+
+void ExchangeStream::close() {
+    _context.TryCancel();
+}
+
+bool ExchangeStream::done() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _done;
+}
+
+std::size_t ExchangeStream::pending() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _pending.size();
+}
+
+void ExchangeStream::OnReadDone(bool ok) {
+    if (!ok) {
+        // The stream is finishing, OnDone reports why. No write may start once the hold is gone
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _done = true;
+        }
+        RemoveHold();
+        return;
+    }
+    Callback done;
+    Scheduler::TaskId timer = 0;
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        auto found = _pending.find(_rx_buf.id());
+        if (found != _pending.end()) {
+            done = std::move(found->second.done);
+            timer = found->second.timer;
+            _pending.erase(found);
+        }
+    }
+    std::shared_ptr<Scheduler> scheduler = _scheduler.lock();
+    if (done && scheduler) {
+        scheduler->cancel(timer);
+    }
+    if (done && _rx_buf.code() != ::grpc::StatusCode::OK) {
+        done(::grpc::Status(static_cast<::grpc::StatusCode>(_rx_buf.code()), "Exchange refused by the server."), ViewProto());
+    }
+    else if (done) {
+        done(::grpc::Status::OK, _rx_buf.view());
+    }
+    _rx_buf.Clear();
+    StartRead(&_rx_buf);
+}
+
+void ExchangeStream::OnWriteDone(bool ok) {
+    std::lock_guard<std::mutex> lock(_lock);
+    _writes.pop_front();
+    if (!ok || _writes.empty()) {
+        // A failed write means the stream is broken, whatever is still queued is failed in OnDone
+        _writing = false;
+        return;
+    }
+    StartWrite(&_writes.front());
+}
+
+void ExchangeStream::OnDone(const ::grpc::Status& status) {
+    std::unordered_map<uint64_t, Pending> pending;
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _done = true;
+        pending.swap(_pending);
+        _writes.clear();
+    }
+    // Reported first so exchanges retried from the callbacks below already see the peer as unary only
+    if (_closed) {
+        _closed(this, status);
+    }
+    ::grpc::Status failed = status.ok() ? ::grpc::Status(::grpc::StatusCode::UNAVAILABLE, "Exchange stream closed.") : status;
+    std::shared_ptr<Scheduler> scheduler = _scheduler.lock();
+    for (auto& entry : pending) {
+        if (scheduler) {
+            scheduler->cancel(entry.second.timer);
+        }
+        entry.second.done(failed, ViewProto());
+    }
+    // The stream may hold the last reference to its channel, which must not be released from inside the channel's own
+    // callback. Let go of it from a scheduler worker instead.
+    std::shared_ptr<ExchangeStream> self = std::move(_self);
+    if (scheduler) {
+        scheduler->schedule(std::chrono::milliseconds(0), [self]() {});
+    }
+}
+
+
+ExchangeStreamPool::~ExchangeStreamPool() {
+    clear();
+}
+
+void ExchangeStreamPool::exchange(const std::string& address, ExchangeRequest::Type type, std::shared_ptr<ViewProto> tx_buf,
+                                  std::chrono::milliseconds timeout, Callback done) {
+    std::vector<std::shared_ptr<ExchangeStream>> evicted;
+    std::shared_ptr<ExchangeStream> stream = acquire(address, evicted);
+    // Closed outside the lock, a cancelled stream may report back into the pool straight away
+    for (auto& old : evicted) {
+        old->close();
+    }
+    stream->exchange(type, tx_buf, timeout, done);
+}
+
+std::shared_ptr<ExchangeStream> ExchangeStreamPool::acquire(const std::string& address, std::vector<std::shared_ptr<ExchangeStream>>& evicted) {
+    std::lock_guard<std::mutex> lock(_state->lock);
+    auto found = _state->lut.find(address);
+    if (found != _state->lut.end()) {
+        if (!found->second->stream->done()) {
+            _state->lru.splice(_state->lru.begin(), _state->lru, found->second);
+            return found->second->stream;
+        }
+        _state->lru.erase(found->second);
+        _state->lut.erase(found);
+    }
+
+    std::weak_ptr<State> weak = _state;
+    std::shared_ptr<ExchangeStream> stream = ExchangeStream::create(_channel_pool->stub(address), _scheduler,
+        [weak, address](ExchangeStream* closed, const ::grpc::Status& status) {
+            std::shared_ptr<State> state = weak.lock();
+            if (!state) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(state->lock);
+            if (status.error_code() == ::grpc::StatusCode::UNIMPLEMENTED) {
+                state->unary_only.insert(address);
+            }
+            auto found = state->lut.find(address);
+            if (found != state->lut.end() && found->second->stream.get() == closed) {
+                // Only the pool's reference is dropped here, the stream releases its own once OnDone returns
+                state->lru.erase(found->second);
+                state->lut.erase(found);
+            }
+        });
+    _state->lru.push_front(Entry{address, stream});
+    _state->lut[address] = _state->lru.begin();
+
+    while (_state->lru.size() > _max_streams) {
+        evicted.push_back(_state->lru.back().stream);
+        _state->lut.erase(_state->lru.back().address);
+        _state->lru.pop_back();
+    }
+    return stream;
+}
+
+bool ExchangeStreamPool::unary_only(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(_state->lock);
+    return _state->unary_only.find(address) != _state->unary_only.end();
+}
+
+bool ExchangeStreamPool::contains(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(_state->lock);
+    return _state->lut.find(address) != _state->lut.end();
+}
+
+std::size_t ExchangeStreamPool::size() const {
+    std::lock_guard<std::mutex> lock(_state->lock);
+    return _state->lru.size();
+}
+
+void ExchangeStreamPool::close(const std::string& address) {
+    std::shared_ptr<ExchangeStream> stream;
+    {
+        std::lock_guard<std::mutex> lock(_state->lock);
+        auto found = _state->lut.find(address);
+        if (found == _state->lut.end()) {
+            return;
+        }
+        stream = found->second->stream;
+        _state->lru.erase(found->second);
+        _state->lut.erase(found);
+    }
+    stream->close();
+}
+
+void ExchangeStreamPool::clear() {
+    std::list<Entry> streams;
+    {
+        std::lock_guard<std::mutex> lock(_state->lock);
+        streams.swap(_state->lru);
+        _state->lut.clear();
+    }
+    for (auto& entry : streams) {
+        entry.stream->close();
+    }
+}
+
+}
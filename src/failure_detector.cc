@@ -0,0 +1,114 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+#include "failure_detector.h"
+
+namespace gossip {
+
+void FailureDetector::record_success(const std::string& address) {
+    std::lock_guard<std::mutex> lock(_lock);
+    // Only failing peers are tracked
+    _peers.erase(address);
+}
+
+FailureDetector::State FailureDetector::record_failure(const std::string& address) {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _peers.find(address);
+    if (found == _peers.end()) {
+        if (_peers.size() >= _max_peers) {
+            remove_lru();
+        }
+        found = _peers.emplace(address, Peer{0, {}}).first;
+    }
+    found->second.failures++;
+    found->second.last_failure = std::chrono::steady_clock::now();
+    return to_state(found->second.failures);
+}
+
+void FailureDetector::forget(const std::string& address) {
+    std::lock_guard<std::mutex> lock(_lock);
+    _peers.erase(address);
+}
+
+FailureDetector::State FailureDetector::state(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _peers.find(address);
+    if (found == _peers.end()) {
+        return State::ALIVE;
+    }
+    return to_state(found->second.failures);
+}
+
+unsigned int FailureDetector::failures(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _peers.find(address);
+    if (found == _peers.end()) {
+        return 0;
+    }
+    return found->second.failures;
+}
+
+FailureDetector::State FailureDetector::to_state(unsigned int failures) const {
+    if (failures >= _evict_after) {
+        return State::DEAD;
+    }
+    if (failures >= _suspect_after) {
+        return State::SUSPECT;
+    }
+    return State::ALIVE;
+}
+
+void FailureDetector::remove_lru() {
+    auto oldest = _peers.begin();
+    for (auto it = _peers.begin(); it != _peers.end(); ++it) {
+        if (it->second.last_failure < oldest->second.last_failure) {
+            oldest = it;
+        }
+    }
+    if (oldest != _peers.end()) {
+        _peers.erase(oldest);
+    }
+}
+
+std::size_t FailureDetector::size() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _peers.size();
+}
+
+std::string FailureDetector::print() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    std::string str = "FailureDetector(SuspectAfter: " + std::to_string(_suspect_after)
+        + ", EvictAfter: " + std::to_string(_evict_after)
+        + ", Failing: ";
+    for (auto& entry : _peers) {
+        str += entry.first + ": " + std::to_string(entry.second.failures) + ", ";
+    }
+    str += ")";
+    return str;
+}
+
+}
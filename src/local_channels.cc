@@ -0,0 +1,97 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+#include <grpcpp/grpcpp.h>
+
+#include "local_channels.h"
+
+namespace gossip {
+
+LocalChannels& LocalChannels::global() {
+    static LocalChannels local_channels;
+    return local_channels;
+}
+
+uint64_t LocalChannels::add_server(const std::string& address, ::grpc::Server* server) {
+    std::lock_guard<std::mutex> lock(_lock);
+    uint64_t id = _next_id++;
+    _servers[address] = Hosted{server, id};
+    return id;
+}
+
+void LocalChannels::remove_server(const std::string& address, uint64_t id) {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _servers.find(address);
+    // A server started since at the same address keeps its listing
+    if (found != _servers.end() && found->second.id == id) {
+        _servers.erase(found);
+    }
+}
+
+std::shared_ptr<::grpc::Channel> LocalChannels::in_process_channel(const std::string& address, uint64_t& id) {
+    // Held while the channel is made, the server can't be removed and shut down underneath it
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _servers.find(address);
+    if (found == _servers.end()) {
+        id = 0;
+        return nullptr;
+    }
+    id = found->second.id;
+    ::grpc::ChannelArguments args;
+    return found->second.server->InProcessChannel(args);
+}
+
+bool LocalChannels::hosts(const std::string& address, uint64_t id) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _servers.find(address);
+    return found != _servers.end() && found->second.id == id;
+}
+
+void LocalChannels::add_route(const std::string& address, const std::string& target) {
+    std::lock_guard<std::mutex> lock(_lock);
+    _routes[address] = target;
+}
+
+void LocalChannels::remove_route(const std::string& address) {
+    std::lock_guard<std::mutex> lock(_lock);
+    _routes.erase(address);
+}
+
+std::string LocalChannels::route(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _routes.find(address);
+    return found != _routes.end() ? found->second : address;
+}
+
+std::size_t LocalChannels::num_servers() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _servers.size();
+}
+
+std::size_t LocalChannels::num_routes() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _routes.size();
+}
+
+}
@@ -0,0 +1,77 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <string>
+#include <mutex>
+#include <chrono>
+
+#include "loopback_transport.h"
+
+namespace gossip {
+
+void LoopbackTransport::exchange(const std::string& address, ExchangeRequest::Type type, std::shared_ptr<ViewProto> tx_buf,
+                                 std::chrono::milliseconds, Callback done) {
+    std::shared_ptr<Server> server;
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        auto found = _servers.find(address);
+        if (found != _servers.end()) {
+            server = found->second;
+        }
+    }
+    if (!server) {
+        done(::grpc::Status(::grpc::StatusCode::UNAVAILABLE, "No node is served at " + address + "."), ViewProto());
+        return;
+    }
+    // Answered outside the lock, the server's view takes its own
+    ViewProto rx_buf;
+    ViewProto empty;
+    // A pushed view leads with the sender's own descriptor, a pull is only held to the in flight cap
+    std::string source = tx_buf && tx_buf->nodes_size() > 0 ? tx_buf->nodes(0).address() : "";
+    ::grpc::Status status = server->serve(source, type, tx_buf ? *tx_buf : empty, rx_buf);
+    if (!status.ok()) {
+        done(status, ViewProto());
+        return;
+    }
+    _exchanges++;
+    done(::grpc::Status::OK, rx_buf);
+}
+
+bool LoopbackTransport::serve(std::shared_ptr<Server> server) {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _servers.emplace(server->view()->self()->address(), server).second;
+}
+
+void LoopbackTransport::unserve(const std::string& address) {
+    std::lock_guard<std::mutex> lock(_lock);
+    _servers.erase(address);
+}
+
+bool LoopbackTransport::serving(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _servers.find(address) != _servers.end();
+}
+
+std::size_t LoopbackTransport::size() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _servers.size();
+}
+
+}
@@ -0,0 +1,139 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "merge_queue.h"
+
+namespace gossip {
+
+MergeQueue::MergeQueue(std::shared_ptr<View> view, std::size_t batch_size, std::chrono::microseconds max_delay, std::size_t max_pending)
+                       : _view(view), _batch_size(std::max<std::size_t>(batch_size, 1)), _max_delay(max_delay),
+                       _max_pending(max_pending), _head(nullptr), _pending(0), _age_pending(false),
+                       _merged(0), _batches(0), _dropped(0), _active(true) {
+    _merger = std::thread([this]() { run_merger(); });
+}
+
+MergeQueue::~MergeQueue() {
+    {
+        std::lock_guard<std::mutex> lock(_sleep_lock);
+        _active = false;
+    }
+    _cv.notify_all();
+    if (_merger.joinable()) {
+        _merger.join();
+    }
+    // Nothing pushed before now is lost
+    flush();
+}
+
+bool MergeQueue::push(const ViewProto& view) {
+    std::size_t pending = _pending.fetch_add(1) + 1;
+    if (pending > _max_pending) {
+        _pending--;
+        _dropped++;
+        return false;
+    }
+    Node* node = new Node{view, nullptr};
+    // Once pushed the node is the merger's to free, only the local copy of the old head is safe to look at
+    Node* head = _head.load(std::memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!_head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+    if (!head) {
+        // First of a batch, the merger may be idle
+        wake();
+    }
+    else if (pending == _batch_size) {
+        // A full batch, no need to hold it any longer. Only ever early, missing it costs at most max_delay.
+        _cv.notify_one();
+    }
+    return true;
+}
+
+void MergeQueue::age() {
+    if (!_age_pending.exchange(true, std::memory_order_relaxed)) {
+        wake();
+    }
+}
+
+void MergeQueue::wake() {
+    // Taken so the notify can't fall between the merger finding nothing queued and going to sleep
+    {
+        std::lock_guard<std::mutex> lock(_sleep_lock);
+    }
+    _cv.notify_one();
+}
+
+void MergeQueue::flush() {
+    std::lock_guard<std::mutex> lock(_lock);
+    merge_batch();
+}
+
+void MergeQueue::merge_batch() {
+    // Called with the lock held
+    Node* head = _head.exchange(nullptr, std::memory_order_acquire);
+    bool aged = _age_pending.exchange(false, std::memory_order_relaxed);
+    if (!head && !aged) {
+        return;
+    }
+    // The stack is newest first, merge in arrival order as they would have been merged one by one
+    std::vector<Node*> batch;
+    for (Node* node = head; node; node = node->next) {
+        batch.push_back(node);
+    }
+    std::vector<std::shared_ptr<NodeDescriptor>> new_nodes;
+    for (auto it = batch.rbegin(); it != batch.rend(); ++it) {
+        for (auto& node : (*it)->view.nodes()) {
+            new_nodes.push_back(std::make_shared<NodeDescriptor>(node));
+        }
+        delete *it;
+    }
+    _pending -= batch.size();
+    _view->merge(new_nodes);
+    _merged += batch.size();
+    _batches++;
+}
+
+void MergeQueue::run_merger() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_sleep_lock);
+            _cv.wait(lock, [this]() {
+                return !_active || _head.load(std::memory_order_relaxed) || _age_pending.load(std::memory_order_relaxed);
+            });
+            if (!_active) {
+                return;
+            }
+            // Something arrived, hold it at most max_delay for the rest of its batch
+            _cv.wait_for(lock, _max_delay, [this]() { return !_active || _pending.load(std::memory_order_relaxed) >= _batch_size; });
+        }
+        flush();
+    }
+}
+
+}
@@ -24,11 +24,38 @@ namespace gossip {
 
 const void NodeDescriptor::make_proto(NodeDescriptorProto* out_proto) const {
     out_proto->set_address(_address);
-    out_proto->set_age(_age);
+    out_proto->set_age(age());
+}
+
+uint32_t NodeDescriptor::age() const {
+    uint64_t age = _age.load(std::memory_order_relaxed);
+    if (age & ATTACHED) {
+        return _clock->load(std::memory_order_relaxed) - static_cast<uint32_t>(age);
+    }
+    return static_cast<uint32_t>(age);
+}
+
+void NodeDescriptor::set_age(uint32_t age) {
+    if (attached()) {
+        _age.store(ATTACHED | static_cast<uint32_t>(_clock->load(std::memory_order_relaxed) - age), std::memory_order_relaxed);
+    }
+    else {
+        _age.store(age, std::memory_order_relaxed);
+    }
+}
+
+void NodeDescriptor::attach(std::shared_ptr<const std::atomic<uint32_t>> clock) {
+    uint32_t current = age();
+    _clock = std::move(clock);
+    _age.store(ATTACHED | static_cast<uint32_t>(_clock->load(std::memory_order_relaxed) - current), std::memory_order_relaxed);
+}
+
+void NodeDescriptor::detach() {
+    _age.store(age(), std::memory_order_relaxed);
 }
 
 std::string NodeDescriptor::print() const { 
-    return "NodeDescriptor(address: " + _address + ", age: " + std::to_string(_age) + ")";
+    return "NodeDescriptor(address: " + _address + ", age: " + std::to_string(age()) + ")";
 }
 
 }
\ No newline at end of file
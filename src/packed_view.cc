@@ -0,0 +1,504 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <memory>
+#include <random>
+#include <mutex>
+#include <numeric>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+
+#include "node_descriptor.h"
+#include "packed_view.h"
+
+namespace gossip {
+
+std::shared_ptr<NodeDescriptor> PackedView::TailPeerSelector::select_peer_impl() {
+    std::lock_guard<std::mutex> lock(_view->_lock);
+    if (!_view->_ids.empty()) {
+        return _view->descriptor(_view->_ids.size() - 1);
+    }
+    return nullptr;
+}
+
+std::size_t PackedView::TailPeerSelector::select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) {
+    out.clear();
+    std::lock_guard<std::mutex> lock(_view->_lock);
+    for (int slot = static_cast<int>(_view->_ids.size()) - 1; slot >= 0 && out.size() < k; --slot) {
+        out.push_back(_view->descriptor(slot));
+    }
+    return out.size();
+}
+
+std::string PackedView::TailPeerSelector::print() const {
+    return "TailPeerSelector(View: " + _view->print() + ")";
+}
+
+std::shared_ptr<NodeDescriptor> PackedView::URPeerSelector::select_peer_impl() {
+    std::lock_guard<std::mutex> lock(_view->_lock);
+    if (!_view->_ids.empty()) {
+        std::uniform_int_distribution<> distr(0, _view->_ids.size() - 1);
+        return _view->descriptor(distr(_view->_eng));
+    }
+    return nullptr;
+}
+
+std::size_t PackedView::URPeerSelector::select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) {
+    out.clear();
+    std::lock_guard<std::mutex> lock(_view->_lock);
+    sample_indices(k, _view->_ids.size(), _view->_eng, _view->_picks);
+    for (uint32_t slot : _view->_picks) {
+        out.push_back(_view->descriptor(slot));
+    }
+    return out.size();
+}
+
+std::string PackedView::URPeerSelector::print() const {
+    return "URPeerSelector(Selecting: all, View: " + _view->print() + ")";
+}
+
+PackedView::URNRPeerSelector::URNRPeerSelector(std::shared_ptr<PackedView> view) : IdPeerSelector(view) {
+    std::lock_guard<std::mutex> lock(_view->_lock);
+    for (uint32_t id : _view->_ids) {
+        on_add(id);
+    }
+}
+
+std::shared_ptr<NodeDescriptor> PackedView::URNRPeerSelector::select_peer_impl() {
+    std::lock_guard<std::mutex> lock(_view->_lock);
+    if (!_unselected.empty()) {
+        // Ids leave _unselected as they leave the view, so whatever is drawn is still in it
+        std::uniform_int_distribution<> distr(0, _unselected.size() - 1);
+        uint32_t id = _unselected[distr(_view->_eng)];
+        on_remove(id);
+        return _view->descriptor(_view->_slots[id]);
+    }
+    if (!_view->_ids.empty()) {
+        std::uniform_int_distribution<> distr(0, _view->_ids.size() - 1);
+        return _view->descriptor(distr(_view->_eng));
+    }
+    return nullptr;
+}
+
+std::size_t PackedView::URNRPeerSelector::select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) {
+    out.clear();
+    std::lock_guard<std::mutex> lock(_view->_lock);
+    std::vector<uint32_t>& drawn = _view->_picks;
+    drawn.clear();
+    while (drawn.size() < k && !_unselected.empty()) {
+        std::uniform_int_distribution<> distr(0, _unselected.size() - 1);
+        uint32_t id = _unselected[distr(_view->_eng)];
+        on_remove(id);
+        drawn.push_back(_view->_slots[id]);
+    }
+    if (drawn.size() < k && drawn.size() < _view->_ids.size()) {
+        // Of k distinct slots at most drawn.size() are repeats, which leaves enough to fill up on
+        _view->_marks.assign(_view->_ids.size(), 0);
+        for (uint32_t slot : drawn) {
+            _view->_marks[slot] = 1;
+        }
+        sample_indices(k, _view->_ids.size(), _view->_eng, _view->_order);
+        for (std::size_t i = 0; i < _view->_order.size() && drawn.size() < k; ++i) {
+            if (!_view->_marks[_view->_order[i]]) {
+                drawn.push_back(_view->_order[i]);
+            }
+        }
+    }
+    for (uint32_t slot : drawn) {
+        out.push_back(_view->descriptor(slot));
+    }
+    return out.size();
+}
+
+void PackedView::URNRPeerSelector::on_add(uint32_t id) {
+    if (id >= _positions.size()) {
+        _positions.resize(id + 1, -1);
+    }
+    if (_positions[id] == -1) {
+        _positions[id] = _unselected.size();
+        _unselected.push_back(id);
+    }
+}
+
+void PackedView::URNRPeerSelector::on_remove(uint32_t id) {
+    if (id >= _positions.size() || _positions[id] == -1) {
+        return;
+    }
+    uint32_t last = _unselected.back();
+    _unselected[_positions[id]] = last;
+    _positions[last] = _positions[id];
+    _unselected.pop_back();
+    _positions[id] = -1;
+}
+
+std::string PackedView::URNRPeerSelector::print() const {
+    std::string str = "URNRPeerSelector(Selecting: ";
+    {
+        std::lock_guard<std::mutex> lock(_view->_lock);
+        for (uint32_t id : _unselected) {
+            str += _view->descriptor(_view->_slots[id])->print() + ", ";
+        }
+    }
+    str += ", View: " + _view->print() + ")";
+    return str;
+}
+
+PackedView::PackedView(std::string address, int size, int healing, int swap) : PackedView(address, size, healing, swap, random_seed()) {}
+
+PackedView::PackedView(std::string address, int size, int healing, int swap, uint64_t seed)
+                    : _seed(seed), _eng(seed), _self(std::make_shared<NodeDescriptor>(address, 0)), _clock(0), _selector(nullptr),
+                    _size(size), _healing(healing), _swap(swap) {
+    // Self is interned but never given a slot, so it is known to the view without ever being in it
+    _addresses.push_back(address);
+    _slots.push_back(NO_SLOT);
+    _interned[address] = SELF_ID;
+}
+
+void PackedView::init_selector(SelectorType type, std::shared_ptr<TSLog> log) {
+    _selector = create_subscriber(type, log);
+}
+
+std::shared_ptr<NodeDescriptor> PackedView::select_peer() {
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (!_selector) {
+            return nullptr;
+        }
+    }
+    return _selector->select_peer();
+}
+
+std::size_t PackedView::select_peers(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) {
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (!_selector) {
+            out.clear();
+            return 0;
+        }
+    }
+    return _selector->select_peers(k, out);
+}
+
+std::vector<std::shared_ptr<NodeDescriptor>> PackedView::tx_nodes() {
+    std::vector<std::shared_ptr<NodeDescriptor>> buf;
+    buf.push_back(_self);
+    std::lock_guard<std::mutex> lock(_lock);
+    move_old_to_back(_healing);
+    sample_head((_size / 2) - 1, static_cast<int>(_ids.size()) - std::max(_healing, 0));
+    int num_get = std::min((_size / 2) - 1, static_cast<int>(_ids.size()));
+    for (int i = 0; i < num_get; ++i) {
+        buf.push_back(descriptor(i));
+    }
+    return buf;
+}
+
+void PackedView::rx_nodes(std::vector<std::shared_ptr<NodeDescriptor>>& nodes) {
+    std::lock_guard<std::mutex> lock(_lock);
+    receive(nodes);
+}
+
+void PackedView::merge(std::vector<std::shared_ptr<NodeDescriptor>>& nodes) {
+    std::lock_guard<std::mutex> lock(_lock);
+    receive(nodes);
+    ++_clock;
+}
+
+void PackedView::increment_age() {
+    std::lock_guard<std::mutex> lock(_lock);
+    ++_clock;
+}
+
+int PackedView::max_size() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _ids.size();
+}
+
+bool PackedView::contains(std::string address) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _interned.find(address) != _interned.end();
+}
+
+std::size_t PackedView::num_ids() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _addresses.size();
+}
+
+void PackedView::manual_insert(std::shared_ptr<NodeDescriptor> new_node) {
+    std::lock_guard<std::mutex> lock(_lock);
+    append(new_node);
+}
+
+void PackedView::manual_insert(std::vector<std::shared_ptr<NodeDescriptor>>& new_nodes) {
+    std::lock_guard<std::mutex> lock(_lock);
+    for (auto& new_node : new_nodes) {
+        append(new_node);
+    }
+}
+
+bool PackedView::remove(const std::string& address) {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _interned.find(address);
+    if (found == _interned.end() || found->second == SELF_ID) {
+        return false;
+    }
+    _marks.assign(_ids.size(), 0);
+    _marks[_slots[found->second]] = 1;
+    remove_marked();
+    return true;
+}
+
+std::shared_ptr<NodeDescriptor> PackedView::descriptor(int slot) const {
+    return std::make_shared<NodeDescriptor>(_addresses[_ids[slot]], age(slot));
+}
+
+uint32_t PackedView::intern(const std::string& address) {
+    uint32_t id;
+    if (!_free_ids.empty()) {
+        id = _free_ids.back();
+        _free_ids.pop_back();
+        _addresses[id] = address;
+    }
+    else {
+        id = _addresses.size();
+        _addresses.push_back(address);
+        _slots.push_back(NO_SLOT);
+    }
+    _interned[address] = id;
+    return id;
+}
+
+void PackedView::release(uint32_t id) {
+    for (auto& sub : _subscribers) {
+        sub->on_remove(id);
+    }
+    _slots[id] = NO_SLOT;
+    _interned.erase(_addresses[id]);
+    _addresses[id].clear();
+    _free_ids.push_back(id);
+}
+
+void PackedView::receive(std::vector<std::shared_ptr<NodeDescriptor>>& nodes) {
+    for (auto& node : nodes) {
+        append(node);
+    }
+    // Dont need remove duplicates as duplicates are never added, just reset age
+    remove_old(std::min(_healing, static_cast<int>(_ids.size()) - _size));
+    remove_head(std::min(_swap, static_cast<int>(_ids.size()) - _size));
+    remove_random(static_cast<int>(_ids.size()) - _size);
+}
+
+void PackedView::append(const std::shared_ptr<NodeDescriptor>& new_peer) {
+    auto found = _interned.find(new_peer->address());
+    if (found == _interned.end()) {
+        uint32_t id = intern(new_peer->address());
+        _slots[id] = _ids.size();
+        _ids.push_back(id);
+        _births.push_back(_clock - new_peer->age());
+        for (auto& sub : _subscribers) {
+            sub->on_add(id);
+        }
+    }
+    else if (_slots[found->second] != NO_SLOT) {
+        // Reset age of already known peer
+        int slot = _slots[found->second];
+        if (age(slot) > new_peer->age()) {
+            _births[slot] = _clock - new_peer->age();
+        }
+    }
+}
+
+/* Marks the num_mark oldest slots in _marks, breaking ties toward the back */
+void PackedView::mark_oldest(int num_mark) {
+    const int n = _ids.size();
+    _marks.assign(n, 0);
+    _scratch.resize(n);
+    for (int i = 0; i < n; ++i) {
+        _scratch[i] = age(i);
+    }
+    std::nth_element(_scratch.begin(), _scratch.begin() + (n - num_mark), _scratch.end());
+    const uint32_t threshold = _scratch[n - num_mark];
+    int ties = num_mark;
+    for (int i = 0; i < n; ++i) {
+        if (age(i) > threshold) {
+            --ties;
+        }
+    }
+    for (int i = n - 1; i >= 0; --i) {
+        if (age(i) > threshold || (age(i) == threshold && ties-- > 0)) {
+            _marks[i] = 1;
+        }
+    }
+}
+
+/* Drops every slot marked in _marks in one pass, keeping the order of the rest */
+void PackedView::remove_marked() {
+    int kept = 0;
+    for (int i = 0; i < static_cast<int>(_ids.size()); ++i) {
+        if (_marks[i]) {
+            release(_ids[i]);
+            continue;
+        }
+        _ids[kept] = _ids[i];
+        _births[kept] = _births[i];
+        _slots[_ids[kept]] = kept;
+        ++kept;
+    }
+    _ids.resize(kept);
+    _births.resize(kept);
+}
+
+void PackedView::move_old_to_back(int num_move) {
+    if (num_move <= 0 || _ids.empty()) {
+        return;
+    }
+    const int n = _ids.size();
+    num_move = std::min(num_move, n);
+    mark_oldest(num_move);
+
+    // Stable partition of the slots, unmarked first
+    _order.clear();
+    for (int i = 0; i < n; ++i) {
+        if (!_marks[i]) {
+            _order.push_back(i);
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        if (_marks[i]) {
+            _order.push_back(i);
+        }
+    }
+    _scratch.resize(n);
+    for (int i = 0; i < n; ++i) {
+        _scratch[i] = _ids[_order[i]];
+    }
+    _ids.swap(_scratch);
+    for (int i = 0; i < n; ++i) {
+        _scratch[i] = _births[_order[i]];
+    }
+    _births.swap(_scratch);
+    for (int i = 0; i < n; ++i) {
+        _slots[_ids[i]] = i;
+    }
+}
+
+void PackedView::remove_old(int num_remove) {
+    if (num_remove <= 0 || _ids.empty()) {
+        return;
+    }
+    mark_oldest(std::min(num_remove, static_cast<int>(_ids.size())));
+    remove_marked();
+}
+
+void PackedView::remove_head(int num_remove) {
+    if (num_remove <= 0 || _ids.empty()) {
+        return;
+    }
+    num_remove = std::min(num_remove, static_cast<int>(_ids.size()));
+    _marks.assign(_ids.size(), 0);
+    std::fill(_marks.begin(), _marks.begin() + num_remove, 1);
+    remove_marked();
+}
+
+void PackedView::remove_random(int num_remove) {
+    if (num_remove <= 0 || _ids.empty()) {
+        return;
+    }
+    const int n = _ids.size();
+    num_remove = std::min(num_remove, n);
+    // Partial Fisher-Yates over the slot indices draws num_remove distinct slots
+    _order.resize(n);
+    std::iota(_order.begin(), _order.end(), 0);
+    _marks.assign(n, 0);
+    for (int i = 0; i < num_remove; ++i) {
+        std::uniform_int_distribution<> distr(i, n - 1);
+        std::swap(_order[i], _order[distr(_eng)]);
+        _marks[_order[i]] = 1;
+    }
+    remove_marked();
+}
+
+/* Partial Fisher-Yates, leaves a uniform sample of num_sample of the first range slots at the head */
+void PackedView::sample_head(int num_sample, int range) {
+    num_sample = std::min(num_sample, range);
+    for (int i = 0; i < num_sample; ++i) {
+        std::uniform_int_distribution<> distr(i, range - 1);
+        int j = distr(_eng);
+        std::swap(_ids[i], _ids[j]);
+        std::swap(_births[i], _births[j]);
+        _slots[_ids[i]] = i;
+        _slots[_ids[j]] = j;
+    }
+}
+
+std::string PackedView::print() const {
+    std::string str = "PackedView(Self: " + _self->print()
+        + ", Size: " + std::to_string(_size)
+        + ", Healing: " + std::to_string(_healing)
+        + ", Swap: " + std::to_string(_swap)
+        + ", Nodes: ";
+    std::lock_guard<std::mutex> lock(_lock);
+    for (int i = 0; i < static_cast<int>(_ids.size()); ++i) {
+        str += descriptor(i)->print() + ", ";
+    }
+    str += ")";
+    return str;
+}
+
+std::shared_ptr<View::PeerSelector> PackedView::create_subscriber(SelectorType type, std::shared_ptr<TSLog> log) {
+    std::shared_ptr<IdPeerSelector> sub;
+
+    switch (type) {
+        case SelectorType::TAIL:
+            sub = std::make_shared<TailPeerSelector>(shared_from_this());
+            break;
+
+        case SelectorType::LOGGED_TAIL:
+            sub = std::make_shared<LoggedTailPeerSelector>(shared_from_this(), log);
+            break;
+
+        case SelectorType::UNIFORM_RANDOM:
+            sub = std::make_shared<URPeerSelector>(shared_from_this());
+            break;
+
+        case SelectorType::LOGGED_UNIFORM_RANDOM:
+            sub = std::make_shared<LoggedURPeerSelector>(shared_from_this(), log);
+            break;
+
+        case SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT:
+            sub = std::make_shared<URNRPeerSelector>(shared_from_this());
+            break;
+
+        case SelectorType::LOGGED_UNIFORM_RANDOM_NO_REPLACEMENT:
+            sub = std::make_shared<LoggedURNRPeerSelector>(shared_from_this(), log);
+            break;
+
+        default:
+            std::cout << "Failed to create subscriber because of invalid type" << std::endl;
+            return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(_lock);
+    _subscribers.push_back(sub);
+    return sub;
+}
+
+}
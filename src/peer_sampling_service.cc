@@ -17,26 +17,84 @@
  * 
  */
 
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <random>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+
 #include <grpcpp/grpcpp.h>
 
 #include "view_proto_helper.h"
+#include "local_channels.h"
 #include "peer_sampling_service.h"
 
 
 namespace gossip {
 
-PeerSamplingService::PeerSamplingService(bool push, bool pull, unsigned int wait_time,
-                                            unsigned int timeout,
+PeerSamplingService::PeerSamplingService(bool push, bool pull, std::chrono::milliseconds wait_time,
+                                            std::chrono::milliseconds timeout,
                                             std::vector<std::string> entry_points,
-                                            std::shared_ptr<View> view) :
-                                            _entered(false), _push(push), _pull(pull), _view(view), _wait_time(wait_time),
-                                            _timeout(timeout), _entry_points(entry_points),
-                                            _gossip_server(std::make_shared<Server>(view)),
-                                            _gossip_client(std::make_shared<Client>(push, pull, wait_time, timeout, view)) {}
+                                            std::shared_ptr<View> view,
+                                            std::shared_ptr<ChannelPool> channel_pool) :
+                                            _entered(false), _push(push), _pull(pull), _wait_time(wait_time),
+                                            _timeout(timeout), _entry_points(entry_points), _entry_fanout(0), _view(view),
+                                            _gossip_client(std::make_shared<Client>(push, pull, wait_time, timeout, view, channel_pool)),
+                                            _gossip_server(std::make_shared<Server>(view)), _served(false) {}
 
 
 PeerSamplingService::~PeerSamplingService() {
     exit();
+    // A transport would otherwise go on answering for this node
+    if (_transport && _served) {
+        _transport->unserve(_view->self()->address());
+    }
+}
+
+struct PeerSamplingService::Bootstrap {
+    std::mutex lock;
+    std::condition_variable done;
+    std::deque<std::string> pending;
+    std::size_t remaining;
+    std::size_t active;
+    bool entered;
+};
+
+void PeerSamplingService::bootstrap_next(std::shared_ptr<Client> client, std::shared_ptr<Bootstrap> bootstrap) {
+    std::string entry_point;
+    {
+        std::lock_guard<std::mutex> lock(bootstrap->lock);
+        if (bootstrap->pending.empty()) {
+            return;
+        }
+        entry_point = bootstrap->pending.front();
+        bootstrap->pending.pop_front();
+        bootstrap->active++;
+    }
+    client->async_push_pull_view(entry_point, [client, bootstrap, entry_point](::grpc::Status status) {
+        bool requeued = false;
+        {
+            std::lock_guard<std::mutex> lock(bootstrap->lock);
+            bootstrap->active--;
+            // Other exchanges hold the slots, retry once one of ours completes rather than count it as failed
+            if (status.error_code() == ::grpc::StatusCode::RESOURCE_EXHAUSTED && bootstrap->active > 0) {
+                bootstrap->pending.push_back(entry_point);
+                requeued = true;
+            }
+            else {
+                bootstrap->entered = bootstrap->entered || status.ok();
+                bootstrap->remaining--;
+            }
+        }
+        if (requeued) {
+            return;
+        }
+        bootstrap->done.notify_all();
+        bootstrap_next(client, bootstrap);
+    });
 }
 
 bool PeerSamplingService::enter() {
@@ -44,18 +102,32 @@ bool PeerSamplingService::enter() {
         _entered = true;
         return _entered;
     }
-    for (auto& ep : _entry_points) {
-        // If haven't gotten responce from at least one entry server, keep track until we do
-        if (!_entered) {
-            if (_gossip_client->push_pull_view(ep).ok()) {
-                _entered = true;
-            }
-        }
-        else {
-        // Keep talking even after 1 success because can help with healthier view.
-            _gossip_client->push_pull_view(ep);
-        }
+
+    std::vector<std::string> entry_points = _entry_points;
+    if (_entry_fanout > 0 && _entry_fanout < entry_points.size()) {
+        // Random subset so a fleet bootstrapping together doesn't all land on the first few entry servers
+        std::mt19937 eng(std::random_device{}());
+        std::shuffle(entry_points.begin(), entry_points.end(), eng);
+        entry_points.resize(_entry_fanout);
     }
+
+    // Outlives enter(), responses after the first success still merge into the view as they arrive
+    std::shared_ptr<Bootstrap> bootstrap = std::make_shared<Bootstrap>();
+    bootstrap->pending.assign(entry_points.begin(), entry_points.end());
+    bootstrap->remaining = entry_points.size();
+    bootstrap->active = 0;
+    bootstrap->entered = false;
+
+    // No more at once than the client lets in flight, each completion starts the next entry point
+    std::size_t window = std::min<std::size_t>(std::max(_gossip_client->max_in_flight(), 1u), entry_points.size());
+    for (std::size_t i = 0; i < window; i++) {
+        bootstrap_next(_gossip_client, bootstrap);
+    }
+
+    // Return on the first success, or once every entry point has failed
+    std::unique_lock<std::mutex> lock(bootstrap->lock);
+    bootstrap->done.wait(lock, [&bootstrap]() { return bootstrap->entered || bootstrap->remaining == 0; });
+    _entered = bootstrap->entered;
     return _entered;
 }
 
@@ -65,6 +137,14 @@ bool PeerSamplingService::exit() {
 }
 
 void PeerSamplingService::start_server() {
+    std::shared_ptr<EntrySampler> sampler = entry_sampler();
+    if (sampler) {
+        sampler->start();
+    }
+    if (_transport) {
+        _served = _transport->serve(_gossip_server);
+        return;
+    }
     _server_thread = _gossip_server->thread();
     _server_thread->start();
 }
@@ -73,11 +153,19 @@ void PeerSamplingService::start_client() {
     if (!_entered) {
         return;
     }
-    _client_thread = _gossip_client->thread();
+    _client_thread = _gossip_client->thread(_scheduler);
     _client_thread->start();
 }
 
 void PeerSamplingService::stop_server() {
+    std::shared_ptr<EntrySampler> sampler = entry_sampler();
+    if (sampler) {
+        sampler->stop();
+    }
+    if (_transport && _served) {
+        _transport->unserve(_view->self()->address());
+        _served = false;
+    }
     //_server_thread->stop();
     _server_thread.reset();
 }
@@ -88,13 +176,35 @@ void PeerSamplingService::stop_client() {
 }
 
 void PeerSamplingService::signal_server() {
-    _server_thread->signal();
+    // Nothing to wake when served through a transport
+    if (_server_thread) {
+        _server_thread->signal();
+    }
 }
 
 void PeerSamplingService::signal_client() {
     _client_thread->signal();
 }
 
+void PeerSamplingService::add_local_route(const std::string& address, const std::string& target) {
+    LocalChannels::global().add_route(address, target);
+    // A channel or stream already dialed over the advertised address would otherwise keep being reused
+    channel_pool()->evict(address);
+    std::shared_ptr<ExchangeStreamPool> streams = exchange_streams();
+    if (streams) {
+        streams->close(address);
+    }
+}
+
+void PeerSamplingService::remove_local_route(const std::string& address) {
+    LocalChannels::global().remove_route(address);
+    channel_pool()->evict(address);
+    std::shared_ptr<ExchangeStreamPool> streams = exchange_streams();
+    if (streams) {
+        streams->close(address);
+    }
+}
+
 void PeerSamplingService::start() {
     start_server();
     start_client();
@@ -113,7 +223,8 @@ void PeerSamplingService::signal() {
 std::string PeerSamplingService::print() const{
     std::string str = "PeerSamplingService(Push: " + std::to_string(_push) 
         + ", Pull: " + std::to_string(_pull)
-        + ", Timeout: " + std::to_string(_timeout)
+        + ", WaitTime: " + std::to_string(_wait_time.count()) + "ms"
+        + ", Timeout: " + std::to_string(_timeout.count()) + "ms"
         + ", View: " + _view->print()
         + ", EntryPoints: ";
     for (auto& ep : _entry_points) {
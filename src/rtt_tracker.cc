@@ -0,0 +1,150 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <array>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+#include "rtt_tracker.h"
+
+namespace gossip {
+
+void RttTracker::record(const std::string& address, std::chrono::microseconds rtt) {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _peers.find(address);
+    if (found == _peers.end()) {
+        if (_peers.size() >= _max_peers) {
+            remove_lru();
+        }
+        found = _peers.emplace(address, Peer{}).first;
+    }
+    Peer& peer = found->second;
+    double sample = static_cast<double>(rtt.count());
+    if (peer.samples == 0) {
+        peer.srtt_us = sample;
+        peer.rttvar_us = sample / 2;
+    }
+    else {
+        // RFC 6298 gains
+        peer.rttvar_us = 0.75 * peer.rttvar_us + 0.25 * std::abs(peer.srtt_us - sample);
+        peer.srtt_us = 0.875 * peer.srtt_us + 0.125 * sample;
+    }
+    peer.window[peer.samples % kWindow] = rtt.count();
+    peer.samples++;
+    peer.backoff = 1;
+    peer.last_used = std::chrono::steady_clock::now();
+}
+
+void RttTracker::record_timeout(const std::string& address) {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _peers.find(address);
+    if (found == _peers.end()) {
+        // Never measured, it is already given the longest deadline
+        return;
+    }
+    found->second.backoff = std::min(found->second.backoff * 2, kMaxBackoff);
+    found->second.last_used = std::chrono::steady_clock::now();
+}
+
+void RttTracker::forget(const std::string& address) {
+    std::lock_guard<std::mutex> lock(_lock);
+    _peers.erase(address);
+}
+
+std::chrono::milliseconds RttTracker::timeout(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _peers.find(address);
+    if (found == _peers.end()) {
+        return _max_timeout;
+    }
+    const Peer& peer = found->second;
+    double deadline_us = std::max(peer.srtt_us + 4 * peer.rttvar_us, static_cast<double>(percentile_us(peer)));
+    deadline_us *= peer.backoff;
+    auto deadline = std::chrono::milliseconds(static_cast<int64_t>(std::ceil(deadline_us / 1000)));
+    return std::min(std::max(deadline, _min_timeout), _max_timeout);
+}
+
+std::chrono::microseconds RttTracker::srtt(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _peers.find(address);
+    if (found == _peers.end()) {
+        return std::chrono::microseconds(0);
+    }
+    return std::chrono::microseconds(static_cast<int64_t>(found->second.srtt_us));
+}
+
+std::chrono::microseconds RttTracker::percentile_rtt(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _peers.find(address);
+    if (found == _peers.end()) {
+        return std::chrono::microseconds(0);
+    }
+    return std::chrono::microseconds(percentile_us(found->second));
+}
+
+int64_t RttTracker::percentile_us(const Peer& peer) const {
+    std::size_t count = std::min(peer.samples, kWindow);
+    std::array<int64_t, kWindow> window = peer.window;
+    // Nearest rank
+    std::size_t rank = static_cast<std::size_t>(std::ceil(kPercentile * count)) - 1;
+    std::nth_element(window.begin(), window.begin() + rank, window.begin() + count);
+    return window[rank];
+}
+
+void RttTracker::remove_lru() {
+    auto oldest = _peers.begin();
+    for (auto it = _peers.begin(); it != _peers.end(); ++it) {
+        if (it->second.last_used < oldest->second.last_used) {
+            oldest = it;
+        }
+    }
+    if (oldest != _peers.end()) {
+        _peers.erase(oldest);
+    }
+}
+
+bool RttTracker::contains(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _peers.find(address) != _peers.end();
+}
+
+std::size_t RttTracker::size() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _peers.size();
+}
+
+std::string RttTracker::print() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    std::string str = "RttTracker(MinTimeout: " + std::to_string(_min_timeout.count()) + "ms"
+        + ", MaxTimeout: " + std::to_string(_max_timeout.count()) + "ms"
+        + ", Peers: ";
+    for (auto& entry : _peers) {
+        str += entry.first + ": " + std::to_string(static_cast<int64_t>(entry.second.srtt_us)) + "us, ";
+    }
+    str += ")";
+    return str;
+}
+
+}
@@ -0,0 +1,258 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+#include "scheduler.h"
+
+namespace gossip {
+
+Scheduler::Scheduler(unsigned int num_workers, std::chrono::milliseconds tick) 
+                    : _active(true), _tick(std::max(tick, std::chrono::milliseconds(1))),
+                    _epoch(std::chrono::steady_clock::now()), _current_tick(0), _target_tick(0), _next_id(1),
+                    _eng(std::random_device{}()) {
+    _timer_thread = std::thread([this]() { run_timer(); });
+    for (unsigned int i = 0; i < std::max(num_workers, 1u); ++i) {
+        _workers.emplace_back([this]() { run_worker(); });
+    }
+}
+
+Scheduler::~Scheduler() {
+    stop();
+}
+
+std::shared_ptr<Scheduler> Scheduler::global() {
+    static std::shared_ptr<Scheduler> scheduler = std::make_shared<Scheduler>(std::max(2u, std::thread::hardware_concurrency() / 2));
+    return scheduler;
+}
+
+Scheduler::TaskId Scheduler::schedule(std::chrono::milliseconds delay, Task task) {
+    return add(to_ticks(delay), 0, 0, task);
+}
+
+Scheduler::TaskId Scheduler::schedule_periodic(std::chrono::milliseconds period, Task task, std::chrono::milliseconds jitter) {
+    uint64_t period_ticks = std::max(to_ticks(period), static_cast<uint64_t>(1));
+    // The offset can never pull a firing back onto or behind the previous one
+    uint64_t jitter_ticks = std::min(to_ticks(jitter), period_ticks - 1);
+    return add(period_ticks, period_ticks, jitter_ticks, task);
+}
+
+void Scheduler::cancel(TaskId id) {
+    std::lock_guard<std::mutex> lock(_lock);
+    auto found = _timers.find(id);
+    if (found != _timers.end()) {
+        // Left in its slot and skipped when it comes due
+        found->second->cancelled = true;
+        _timers.erase(found);
+    }
+}
+
+void Scheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (!_active) {
+            return;
+        }
+        _active = false;
+    }
+    _timer_cv.notify_all();
+    _worker_cv.notify_all();
+    if (_timer_thread.joinable()) {
+        _timer_thread.join();
+    }
+    for (auto& worker : _workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    std::lock_guard<std::mutex> lock(_lock);
+    _timers.clear();
+    _ready.clear();
+    for (auto& level : _wheel) {
+        for (auto& slot : level) {
+            slot.clear();
+        }
+    }
+}
+
+std::size_t Scheduler::size() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _timers.size();
+}
+
+Scheduler::TaskId Scheduler::add(uint64_t delay_ticks, uint64_t period_ticks, uint64_t jitter_ticks, Task task) {
+    std::shared_ptr<Timer> timer = std::make_shared<Timer>();
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_timers.empty()) {
+            // Nothing is on the wheel, so it is safe to jump straight to the present after being idle
+            _current_tick = std::max(_current_tick, now_tick());
+        }
+        timer->id = _next_id++;
+        timer->period = period_ticks;
+        timer->jitter = jitter_ticks;
+        timer->expiry = _current_tick + (period_ticks > 0 ? next_period(*timer) : std::max(delay_ticks, static_cast<uint64_t>(1)));
+        timer->task = task;
+        timer->queued = false;
+        timer->running = false;
+        timer->cancelled = false;
+        _timers[timer->id] = timer;
+        insert(timer);
+    }
+    _timer_cv.notify_one();
+    return timer->id;
+}
+
+uint64_t Scheduler::to_ticks(std::chrono::milliseconds duration) const {
+    if (duration.count() <= 0) {
+        return 0;
+    }
+    // Round up so a task never fires early
+    return (duration.count() + _tick.count() - 1) / _tick.count();
+}
+
+uint64_t Scheduler::now_tick() const {
+    return (std::chrono::steady_clock::now() - _epoch) / _tick;
+}
+
+void Scheduler::insert(std::shared_ptr<Timer> timer) {
+    if (timer->expiry <= _current_tick) {
+        // Only reachable from a cascade landing on the current tick
+        fire(timer);
+        return;
+    }
+    uint64_t delta = timer->expiry - _current_tick;
+    for (int level = 0; level < kLevels; ++level) {
+        uint64_t span = static_cast<uint64_t>(1) << ((level + 1) * kSlotBits);
+        if (delta < span || level == kLevels - 1) {
+            // Past the top level the timer is parked and re-inserted each time its slot cascades
+            uint64_t slot = (timer->expiry >> (level * kSlotBits)) & kSlotMask;
+            _wheel[level][slot].push_back(timer);
+            return;
+        }
+    }
+}
+
+void Scheduler::cascade(int level) {
+    uint64_t slot = (_current_tick >> (level * kSlotBits)) & kSlotMask;
+    std::list<std::shared_ptr<Timer>> timers;
+    timers.swap(_wheel[level][slot]);
+    for (auto& timer : timers) {
+        if (!timer->cancelled) {
+            insert(timer);
+        }
+    }
+}
+
+void Scheduler::advance() {
+    ++_current_tick;
+    for (int level = 1; level < kLevels; ++level) {
+        uint64_t lower_mask = (static_cast<uint64_t>(1) << (level * kSlotBits)) - 1;
+        if ((_current_tick & lower_mask) != 0) {
+            break;
+        }
+        cascade(level);
+    }
+
+    std::list<std::shared_ptr<Timer>> due;
+    due.swap(_wheel[0][_current_tick & kSlotMask]);
+    for (auto& timer : due) {
+        if (!timer->cancelled) {
+            fire(timer);
+        }
+    }
+}
+
+void Scheduler::fire(std::shared_ptr<Timer> timer) {
+    if (!timer->queued) {
+        timer->queued = true;
+        _ready.push_back(timer);
+    }
+    if (timer->period > 0) {
+        // Re-armed from the tick being caught up to, a wheel that fell behind fires it once rather than once per
+        // period missed
+        timer->expiry = std::max(timer->expiry, _target_tick) + next_period(*timer);
+        insert(timer);
+    }
+    else {
+        _timers.erase(timer->id);
+    }
+}
+
+uint64_t Scheduler::next_period(const Timer& timer) {
+    if (timer.jitter == 0) {
+        return timer.period;
+    }
+    std::uniform_int_distribution<uint64_t> offset(0, 2 * timer.jitter);
+    return timer.period - timer.jitter + offset(_eng);
+}
+
+void Scheduler::run_timer() {
+    std::unique_lock<std::mutex> lock(_lock);
+    while (_active) {
+        if (_timers.empty()) {
+            _timer_cv.wait(lock, [this]() { return !_active || !_timers.empty(); });
+            continue;
+        }
+        auto next_tick = _epoch + _tick * (_current_tick + 1);
+        _timer_cv.wait_until(lock, next_tick);
+        _target_tick = now_tick();
+        while (_current_tick < _target_tick) {
+            advance();
+        }
+        if (!_ready.empty()) {
+            _worker_cv.notify_all();
+        }
+    }
+}
+
+void Scheduler::run_worker() {
+    std::unique_lock<std::mutex> lock(_lock);
+    while (true) {
+        _worker_cv.wait(lock, [this]() { return !_active || !_ready.empty(); });
+        if (!_active) {
+            return;
+        }
+        std::shared_ptr<Timer> timer = _ready.front();
+        _ready.pop_front();
+        timer->queued = false;
+        if (timer->cancelled || timer->running.exchange(true)) {
+            continue;
+        }
+        lock.unlock();
+        timer->task();
+        timer->running = false;
+        lock.lock();
+    }
+}
+
+}
@@ -20,26 +20,90 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <deque>
+#include <mutex>
 
 #include <grpcpp/grpcpp.h>
 
 #include "view_proto_helper.h"
 
+#include "local_channels.h"
 #include "server.h"
 
 namespace gossip {
 
+void Server::answer(ExchangeRequest::Type type, const ViewProto& request, ViewProto& response) {
+    std::shared_ptr<EntrySampler> entry_sampler = std::atomic_load(&_entry_sampler);
+    if (entry_sampler) {
+        // The view is merged into and aged by the sampler's refresh, not per exchange
+        if (type != ExchangeRequest::PUSH) {
+            entry_sampler->sample(response);
+        }
+        if (type != ExchangeRequest::PULL) {
+            entry_sampler->admit(request);
+        }
+        return;
+    }
+    if (type != ExchangeRequest::PUSH) {
+        // Must send ours before processing thiers to prevent sending back the info they just sent us
+        std::vector<std::shared_ptr<NodeDescriptor>> send_nodes = _view->tx_nodes();
+        // Convert std::vector<std::shared_ptr<NodeDescriptor>> to ViewProto
+        ViewProtoHelper<NodeDescriptor>::add_to_proto(send_nodes, response);
+    }
+    std::shared_ptr<MergeQueue> merge_queue = std::atomic_load(&_merge_queue);
+    if (merge_queue) {
+        // Merged and aged with the rest of its batch
+        if (type != ExchangeRequest::PULL) {
+            merge_queue->push(request);
+        }
+        else {
+            merge_queue->age();
+        }
+        return;
+    }
+    if (type != ExchangeRequest::PULL) {
+        // Convert ViewProto to std::vector<std::shared_ptr<NodeDescriptor>>
+        std::vector<std::shared_ptr<NodeDescriptor>> new_nodes = ViewProtoHelper<NodeDescriptor>::make_internal(request);
+        // Pass to view obj
+        _view->rx_nodes(new_nodes);
+    }
+    _view->increment_age();
+}
+
+::grpc::Status Server::serve(const std::string& peer, ExchangeRequest::Type type, const ViewProto& request, ViewProto& response) {
+    std::shared_ptr<AdmissionControl> admission_control = std::atomic_load(&_admission_control);
+    if (!admission_control) {
+        answer(type, request, response);
+        return ::grpc::Status::OK;
+    }
+    // Refused before a single descriptor is made from the request
+    if (!admission_control->admit(admission_control->per_host() ? source(peer) : peer)) {
+        return ::grpc::Status(::grpc::StatusCode::RESOURCE_EXHAUSTED, "Exchange refused by admission control.");
+    }
+    answer(type, request, response);
+    admission_control->release();
+    return ::grpc::Status::OK;
+}
+
+std::string Server::source(const std::string& peer) {
+    // ipv4:host:port, ipv6:[host]:port, unix sockets have no port to strip
+    if (peer.compare(0, 5, "unix:") == 0) {
+        return peer;
+    }
+    std::size_t port = peer.rfind(':');
+    if (port == std::string::npos || peer.find(':') == port) {
+        return peer;
+    }
+    return peer.substr(0, port);
+}
+
 /* Rx Only on Server */
 ::grpc::ServerUnaryReactor* Server::PushView(::grpc::CallbackServerContext* context, const ::gossip::ViewProto* request, ::google::protobuf::Empty* response){
     class Reactor : public grpc::ServerUnaryReactor {
         public:
-            Reactor(std::shared_ptr<View> view, const ::gossip::ViewProto* request) {
-                // Convert ViewProto to std::vector<std::shared_ptr<NodeDescriptor>>
-                std::vector<std::shared_ptr<NodeDescriptor>> new_nodes = ViewProtoHelper<NodeDescriptor>::make_internal(*request);
-                // Pass to view obj
-                view->rx_nodes(new_nodes);
-                view->increment_age();
-                Finish(grpc::Status::OK);
+            Reactor(Server* server, const std::string& peer, const ::gossip::ViewProto* request) {
+                ::gossip::ViewProto unused;
+                Finish(server->serve(peer, ExchangeRequest::PUSH, *request, unused));
             }
 
         private:
@@ -53,19 +117,15 @@ namespace gossip {
             }
     };
 
-    return new Reactor(_view, request);
+    return new Reactor(this, context->peer(), request);
 }
 
 /* Tx Only on Server */
 ::grpc::ServerUnaryReactor* Server::PullView(::grpc::CallbackServerContext* context, const ::google::protobuf::Empty* request, ::gossip::ViewProto* response) {
     class Reactor : public grpc::ServerUnaryReactor {
         public:
-            Reactor(std::shared_ptr<View> view, ::gossip::ViewProto* response) {
-                std::vector<std::shared_ptr<NodeDescriptor>> send_nodes = view->tx_nodes();
-                view->increment_age();
-                // Convert std::vector<std::shared_ptr<NodeDescriptor>> to ViewProto
-                ViewProtoHelper<NodeDescriptor>::add_to_proto(send_nodes, *response);
-                Finish(grpc::Status::OK);
+            Reactor(Server* server, const std::string& peer, ::gossip::ViewProto* response) {
+                Finish(server->serve(peer, ExchangeRequest::PULL, ::gossip::ViewProto::default_instance(), *response));
             }
 
         private:
@@ -79,23 +139,15 @@ namespace gossip {
             }
     };
 
-    return new Reactor(_view, response);
+    return new Reactor(this, context->peer(), response);
 }
 
 
 ::grpc::ServerUnaryReactor* Server::PushPullView(::grpc::CallbackServerContext* context, const ::gossip::ViewProto* request, ::gossip::ViewProto* response) {
     class Reactor : public grpc::ServerUnaryReactor {
         public:
-            Reactor(std::shared_ptr<View> view, const ::gossip::ViewProto* request, ::gossip::ViewProto* response) {
-                // Must send ours before processing thiers to prevent sending back the info they just sent us
-                std::vector<std::shared_ptr<NodeDescriptor>> send_nodes = view->tx_nodes();
-                ViewProtoHelper<NodeDescriptor>::add_to_proto(send_nodes, *response);
-                // Convert ViewProto to std::vector<std::shared_ptr<NodeDescriptor>>
-                std::vector<std::shared_ptr<NodeDescriptor>> new_nodes = ViewProtoHelper<NodeDescriptor>::make_internal(*request);
-                // Pass to view obj
-                view->rx_nodes(new_nodes);
-                view->increment_age();
-                Finish(::grpc::Status::OK);
+            Reactor(Server* server, const std::string& peer, const ::gossip::ViewProto* request, ::gossip::ViewProto* response) {
+                Finish(server->serve(peer, ExchangeRequest::PUSH_PULL, *request, *response));
             }
 
         private:
@@ -109,7 +161,89 @@ namespace gossip {
             }
     };
 
-    return new Reactor(_view, request, response);
+    return new Reactor(this, context->peer(), request, response);
+}
+
+::grpc::ServerBidiReactor<::gossip::ExchangeRequest, ::gossip::ExchangeResponse>* Server::Exchange(::grpc::CallbackServerContext* context) {
+    class Reactor : public ::grpc::ServerBidiReactor<::gossip::ExchangeRequest, ::gossip::ExchangeResponse> {
+        public:
+            Reactor(Server* server, const std::string& peer) : _server(server), _peer(peer), _reading(true), _writing(false), _finished(false) {
+                StartRead(&_rx_buf);
+            }
+
+        private:
+            Server* _server;
+            const std::string _peer;
+            ::gossip::ExchangeRequest _rx_buf;
+
+            std::mutex _lock;
+            std::deque<::gossip::ExchangeResponse> _writes; // Front is the write in flight
+            bool _reading;
+            bool _writing;
+            bool _finished;
+
+            void finish() {
+                // Called with the lock held, once nothing is left to read or write
+                if (!_finished && !_reading && !_writing) {
+                    _finished = true;
+                    Finish(::grpc::Status::OK);
+                }
+            }
+
+            void OnReadDone(bool ok) override {
+                if (!ok) {
+                    // The client closed its side, finish once the answers still queued are out
+                    std::lock_guard<std::mutex> lock(_lock);
+                    _reading = false;
+                    finish();
+                    return;
+                }
+                ::gossip::ExchangeResponse response;
+                response.set_id(_rx_buf.id());
+                ::grpc::Status status = _server->serve(_peer, _rx_buf.type(), _rx_buf.view(), *response.mutable_view());
+                // A refused exchange fails on its own, the stream and the others on it carry on
+                response.set_code(status.error_code());
+                if (_rx_buf.type() == ::gossip::ExchangeRequest::PUSH) {
+                    response.clear_view();
+                }
+                _rx_buf.Clear();
+                {
+                    std::lock_guard<std::mutex> lock(_lock);
+                    _writes.push_back(std::move(response));
+                    // One write in flight at a time, the rest queue behind it
+                    if (!_writing) {
+                        _writing = true;
+                        StartWrite(&_writes.front());
+                    }
+                }
+                StartRead(&_rx_buf);
+            }
+
+            void OnWriteDone(bool ok) override {
+                std::lock_guard<std::mutex> lock(_lock);
+                _writes.pop_front();
+                if (!ok) {
+                    // The stream is broken, the pending read fails too and finishes the call
+                    _writes.clear();
+                }
+                if (_writes.empty()) {
+                    _writing = false;
+                    finish();
+                    return;
+                }
+                StartWrite(&_writes.front());
+            }
+
+            void OnDone() override {
+                delete this;
+            }
+
+            void OnCancel() override {
+                //LOG(ERROR) << "RPC Cancelled";
+            }
+    };
+
+    return new Reactor(this, context->peer());
 }
 
 Server::Thread::~Thread() {
@@ -119,9 +253,17 @@ Server::Thread::~Thread() {
 void Server::Thread::stop() {
     _stop_flag = true;
 
-    if (_thread.joinable()) {
-        _thread.join();
-        //std::cout << "Server thread stopped" << std::endl;
+    // Unlisted first so no new in-process channel is made to a server shutting down
+    for (auto& listed : _listed) {
+        LocalChannels::global().remove_server(listed.first, listed.second);
+    }
+    _listed.clear();
+
+    if (_grpc_server) {
+        // Waits for exchanges in flight until the deadline, then cancels whatever is left
+        _grpc_server->Shutdown(std::chrono::system_clock::now() + _server->_options.shutdown_grace);
+        _grpc_server.reset();
+        //std::cout << "Server stopped" << std::endl;
     }
 }
 
@@ -129,22 +271,50 @@ void Server::Thread::signal() {
     _stop_flag = true;
 }
 
+void Server::Thread::configure(::grpc::ServerBuilder& builder, const ServerOptions& options) {
+    if (options.memory_quota > 0) {
+        ::grpc::ResourceQuota quota("gossip_server");
+        quota.Resize(options.memory_quota);
+        builder.SetResourceQuota(quota);
+    }
+    if (options.max_concurrent_streams > 0) {
+        builder.AddChannelArgument(GRPC_ARG_MAX_CONCURRENT_STREAMS, options.max_concurrent_streams);
+    }
+    if (options.keepalive_time.count() > 0) {
+        builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIME_MS, static_cast<int>(options.keepalive_time.count()));
+    }
+    if (options.keepalive_timeout.count() > 0) {
+        builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, static_cast<int>(options.keepalive_timeout.count()));
+    }
+    if (options.min_ping_interval.count() > 0) {
+        builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+        builder.AddChannelArgument(GRPC_ARG_HTTP2_MIN_RECV_PING_INTERVAL_WITHOUT_DATA_MS, static_cast<int>(options.min_ping_interval.count()));
+    }
+    if (options.max_connection_idle.count() > 0) {
+        builder.AddChannelArgument(GRPC_ARG_MAX_CONNECTION_IDLE_MS, static_cast<int>(options.max_connection_idle.count()));
+    }
+}
+
 void Server::Thread::start() {
-    try {
-        _thread = std::thread([this]() {
-            ::grpc::ServerBuilder builder;
-            builder.AddListeningPort(_server->_view->self()->address(), ::grpc::InsecureServerCredentials());
-            builder.RegisterService(_server.get());
-            _grpc_server = builder.BuildAndStart();
-            
-            while (!_stop_flag) {
-                std::this_thread::sleep_for(std::chrono::seconds(1));  // Optionally, add logic to periodically check the stop flag
-            }
-        });
-        //std::cout << "Server thread creation succeeded." << std::endl;
+    _stop_flag = false;
+    ::grpc::ServerBuilder builder;
+    std::vector<std::string> addresses = {_server->_view->self()->address()};
+    if (!_server->_local_address.empty()) {
+        addresses.push_back(_server->_local_address);
+    }
+    for (auto& address : addresses) {
+        builder.AddListeningPort(address, ::grpc::InsecureServerCredentials());
+    }
+    builder.RegisterService(_server.get());
+    configure(builder, _server->_options);
+    // Listening before returning means peers can be contacted as soon as start() does
+    _grpc_server = builder.BuildAndStart();
+    if (!_grpc_server) {
+        std::cout << "Server failed to start on: " << _server->_view->self()->address() << std::endl;
+        return;
     }
-    catch (const std::system_error& e) {
-        std::cout << "Server thread creation failed: " << e.what() << std::endl;
+    for (auto& address : addresses) {
+        _listed.emplace_back(address, LocalChannels::global().add_server(address, _grpc_server.get()));
     }
 }
 
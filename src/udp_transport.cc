@@ -0,0 +1,505 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "udp_transport.h"
+
+namespace gossip {
+
+namespace {
+
+// Receive threads poll so stop() is noticed within this long
+constexpr int kPollMs = 100;
+// Generous kernel buffers absorb bursts arriving between batches
+constexpr int kSocketBuffer = 4 * 1024 * 1024;
+constexpr std::size_t kMaxResolved = 4096;
+
+#if defined(__linux__)
+using Message = mmsghdr;
+
+int send_messages(int fd, Message* msgs, unsigned int count) {
+    return sendmmsg(fd, msgs, count, 0);
+}
+
+int receive_messages(int fd, Message* msgs, unsigned int count) {
+    return recvmmsg(fd, msgs, count, MSG_DONTWAIT, nullptr);
+}
+#else
+// Shaped like mmsghdr so the batches are built the same way
+struct Message {
+    msghdr msg_hdr;
+    unsigned int msg_len;
+};
+
+int send_messages(int fd, Message* msgs, unsigned int count) {
+    unsigned int sent = 0;
+    for (; sent < count; ++sent) {
+        if (sendmsg(fd, &msgs[sent].msg_hdr, 0) < 0) {
+            return sent > 0 ? sent : -1;
+        }
+    }
+    return sent;
+}
+
+int receive_messages(int fd, Message* msgs, unsigned int count) {
+    unsigned int received = 0;
+    for (; received < count; ++received) {
+        ssize_t len = recvmsg(fd, &msgs[received].msg_hdr, MSG_DONTWAIT);
+        if (len < 0) {
+            return received > 0 ? received : -1;
+        }
+        msgs[received].msg_len = len;
+    }
+    return received;
+}
+#endif
+
+}
+
+UdpTransport::~UdpTransport() {
+    stop();
+}
+
+bool UdpTransport::resolve(const std::string& address, int family, sockaddr_storage& out, socklen_t& len) {
+    std::size_t colon = address.rfind(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    std::string host = address.substr(0, colon);
+    std::string port = address.substr(colon + 1);
+    // Bracketed IPv6 literals, [::1]:5000
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = family;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = host.empty() ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+        return false;
+    }
+    std::memcpy(&out, result->ai_addr, result->ai_addrlen);
+    len = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+std::string UdpTransport::peer(const sockaddr_storage& addr, socklen_t len) {
+    char host[NI_MAXHOST];
+    char port[NI_MAXSERV];
+    if (getnameinfo(reinterpret_cast<const sockaddr*>(&addr), len, host, sizeof(host), port, sizeof(port),
+                    NI_NUMERICHOST | NI_NUMERICSERV) != 0) {
+        return "";
+    }
+    if (addr.ss_family == AF_INET6) {
+        return std::string("ipv6:[") + host + "]:" + port;
+    }
+    return std::string("ipv4:") + host + ":" + port;
+}
+
+bool UdpTransport::same_peer(const sockaddr_storage& sent_to, const sockaddr_storage& from) {
+    if (sent_to.ss_family != from.ss_family) {
+        return false;
+    }
+    // Sent to the wildcard address the datagram is delivered locally, and answered from whichever local address
+    if (sent_to.ss_family == AF_INET) {
+        const sockaddr_in& to = reinterpret_cast<const sockaddr_in&>(sent_to);
+        const sockaddr_in& sender = reinterpret_cast<const sockaddr_in&>(from);
+        return to.sin_port == sender.sin_port
+            && (to.sin_addr.s_addr == sender.sin_addr.s_addr || to.sin_addr.s_addr == htonl(INADDR_ANY));
+    }
+    if (sent_to.ss_family == AF_INET6) {
+        const sockaddr_in6& to = reinterpret_cast<const sockaddr_in6&>(sent_to);
+        const sockaddr_in6& sender = reinterpret_cast<const sockaddr_in6&>(from);
+        return to.sin6_port == sender.sin6_port
+            && (std::memcmp(&to.sin6_addr, &sender.sin6_addr, sizeof(in6_addr)) == 0 || IN6_IS_ADDR_UNSPECIFIED(&to.sin6_addr));
+    }
+    return false;
+}
+
+bool UdpTransport::lookup(const std::string& address, sockaddr_storage& out, socklen_t& len) {
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        auto found = _resolved.find(address);
+        if (found != _resolved.end()) {
+            out = found->second.addr;
+            len = found->second.len;
+            return true;
+        }
+    }
+    // Resolved outside the lock, a slow lookup must not stall the receive thread
+    if (!resolve(address, _family, out, len)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(_lock);
+    if (_resolved.size() >= kMaxResolved) {
+        _resolved.clear();
+    }
+    _resolved[address] = Resolved{out, len};
+    return true;
+}
+
+bool UdpTransport::start() {
+    std::lock_guard<std::mutex> lock(_lock);
+    if (_active) {
+        return true;
+    }
+    sockaddr_storage local;
+    socklen_t local_len;
+    if (!resolve(_address, AF_UNSPEC, local, local_len)) {
+        std::cout << "UDP transport could not resolve: " << _address << std::endl;
+        return false;
+    }
+#if defined(SOCK_CLOEXEC)
+    int fd = socket(local.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+#else
+    int fd = socket(local.ss_family, SOCK_DGRAM, 0);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
+    if (fd < 0) {
+        return false;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &kSocketBuffer, sizeof(kSocketBuffer));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &kSocketBuffer, sizeof(kSocketBuffer));
+    if (bind(fd, reinterpret_cast<sockaddr*>(&local), local_len) != 0) {
+        std::cout << "UDP transport failed to bind: " << _address << std::endl;
+        close(fd);
+        return false;
+    }
+
+    _fd = fd;
+    _family = local.ss_family;
+    // Ids start at random so a restarted peer's late responses don't match new exchanges
+    _next_id = std::mt19937_64(std::random_device{}())();
+    _active = true;
+    std::shared_ptr<std::atomic<bool>> orphaned = std::make_shared<std::atomic<bool>>(false);
+    _receiver_orphaned = orphaned;
+    _receiver = std::thread([this, orphaned]() { run_receiver(*orphaned); });
+    _sender = std::thread([this]() { run_sender(); });
+    return true;
+}
+
+void UdpTransport::stop() {
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        std::lock_guard<std::mutex> send_lock(_send_lock);
+        if (!_active) {
+            return;
+        }
+        _active = false;
+    }
+    _send_cv.notify_all();
+    if (_receiver.get_id() == std::this_thread::get_id()) {
+        // A response callback let go of the last reference, the receive thread returns without touching the transport
+        *_receiver_orphaned = true;
+        _receiver.detach();
+    }
+    else if (_receiver.joinable()) {
+        _receiver.join();
+    }
+    if (_sender.joinable()) {
+        _sender.join();
+    }
+
+    std::unordered_map<uint64_t, Pending> pending;
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        close(_fd);
+        _fd = -1;
+        pending.swap(_pending);
+        std::lock_guard<std::mutex> send_lock(_send_lock);
+        _sends.clear();
+    }
+    for (auto& entry : pending) {
+        _scheduler->cancel(entry.second.timer);
+        entry.second.done(::grpc::Status(::grpc::StatusCode::CANCELLED, "UDP transport stopped."), ViewProto());
+    }
+}
+
+bool UdpTransport::serve(std::shared_ptr<Server> server) {
+    if (!start()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(_lock);
+    if (_server) {
+        return false;
+    }
+    _server = server;
+    return true;
+}
+
+void UdpTransport::unserve(const std::string& address) {
+    std::lock_guard<std::mutex> lock(_lock);
+    if (_server && _server->view()->self()->address() == address) {
+        _server.reset();
+    }
+}
+
+bool UdpTransport::serving() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _server != nullptr;
+}
+
+std::size_t UdpTransport::pending() const {
+    std::lock_guard<std::mutex> lock(_lock);
+    return _pending.size();
+}
+
+void UdpTransport::exchange(const std::string& address, ExchangeRequest::Type type, std::shared_ptr<ViewProto> tx_buf,
+                            std::chrono::milliseconds timeout, Callback done) {
+    if (!start()) {
+        done(::grpc::Status(::grpc::StatusCode::UNAVAILABLE, "UDP transport could not bind " + _address + "."), ViewProto());
+        return;
+    }
+    std::vector<Outgoing> batch(1);
+    Outgoing& out = batch.front();
+    if (!lookup(address, out.to, out.to_len)) {
+        done(::grpc::Status(::grpc::StatusCode::UNAVAILABLE, "Could not resolve " + address + "."), ViewProto());
+        return;
+    }
+
+    DatagramProto datagram;
+    ExchangeRequest* request = datagram.mutable_request();
+    request->set_type(type);
+    if (type != ExchangeRequest::PULL && tx_buf) {
+        *request->mutable_view() = *tx_buf;
+    }
+    // Sized with the id still unset, it and the length prefix it lengthens add at most 16 bytes
+    if (datagram.ByteSizeLong() + 16 > _max_datagram) {
+        done(::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT, "View does not fit in one datagram."), ViewProto());
+        return;
+    }
+
+    std::weak_ptr<UdpTransport> weak = shared_from_this();
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        uint64_t id = _next_id++;
+        request->set_id(id);
+        Scheduler::TaskId timer = _scheduler->schedule(timeout, [weak, id]() {
+            std::shared_ptr<UdpTransport> transport = weak.lock();
+            if (transport) {
+                transport->expire(id);
+            }
+        });
+        _pending.emplace(id, Pending{done, timer, out.to});
+    }
+    datagram.SerializeToString(&out.data);
+    enqueue(batch);
+}
+
+void UdpTransport::expire(uint64_t id) {
+    Callback done;
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        auto found = _pending.find(id);
+        if (found == _pending.end()) {
+            return;
+        }
+        done = std::move(found->second.done);
+        _pending.erase(found);
+    }
+    // Lost either way, a late response for this id is dropped
+    done(::grpc::Status(::grpc::StatusCode::DEADLINE_EXCEEDED, "Exchange deadline exceeded."), ViewProto());
+}
+
+void UdpTransport::respond(const ExchangeResponse& response, const sockaddr_storage& from) {
+    Callback done;
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        auto found = _pending.find(response.id());
+        if (found == _pending.end() || !same_peer(found->second.peer, from)) {
+            return;
+        }
+        done = std::move(found->second.done);
+        _scheduler->cancel(found->second.timer);
+        _pending.erase(found);
+    }
+    if (response.code() != ::grpc::StatusCode::OK) {
+        done(::grpc::Status(static_cast<::grpc::StatusCode>(response.code()), "Exchange refused by the server."), ViewProto());
+        return;
+    }
+    done(::grpc::Status::OK, response.view());
+}
+
+void UdpTransport::enqueue(std::vector<Outgoing>& batch) {
+    {
+        std::lock_guard<std::mutex> lock(_send_lock);
+        if (!_active) {
+            // Anything pending is failed by stop()
+            return;
+        }
+        for (auto& out : batch) {
+            _sends.push_back(std::move(out));
+        }
+    }
+    _send_cv.notify_one();
+}
+
+void UdpTransport::run_sender() {
+    std::vector<Message> msgs(_batch_size);
+    std::vector<iovec> iovs(_batch_size);
+    std::deque<Outgoing> sends;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_send_lock);
+            _send_cv.wait(lock, [this]() { return !_sends.empty() || !_active; });
+            if (!_active) {
+                return;
+            }
+            // Take everything queued, whatever piled up while the last batch went out leaves together
+            sends.swap(_sends);
+        }
+        while (!sends.empty()) {
+            std::size_t count = std::min(sends.size(), _batch_size);
+            for (std::size_t i = 0; i < count; ++i) {
+                iovs[i].iov_base = const_cast<char*>(sends[i].data.data());
+                iovs[i].iov_len = sends[i].data.size();
+                std::memset(&msgs[i], 0, sizeof(Message));
+                msgs[i].msg_hdr.msg_name = &sends[i].to;
+                msgs[i].msg_hdr.msg_namelen = sends[i].to_len;
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int sent = send_messages(_fd, msgs.data(), count);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                // The first datagram was refused, drop it and let its exchange time out
+                sent = 1;
+            }
+            sends.erase(sends.begin(), sends.begin() + sent);
+        }
+    }
+}
+
+void UdpTransport::run_receiver(const std::atomic<bool>& orphaned) {
+    std::vector<char> buffer(_batch_size * _max_datagram);
+    std::vector<Message> msgs(_batch_size);
+    std::vector<iovec> iovs(_batch_size);
+    std::vector<sockaddr_storage> from(_batch_size);
+    while (_active) {
+        pollfd pfd;
+        pfd.fd = _fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, kPollMs) <= 0) {
+            continue;
+        }
+        for (std::size_t i = 0; i < _batch_size; ++i) {
+            iovs[i].iov_base = buffer.data() + i * _max_datagram;
+            iovs[i].iov_len = _max_datagram;
+            std::memset(&msgs[i], 0, sizeof(Message));
+            msgs[i].msg_hdr.msg_name = &from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int received = receive_messages(_fd, msgs.data(), _batch_size);
+        if (received <= 0) {
+            continue;
+        }
+
+        std::shared_ptr<Server> server;
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            server = _server;
+        }
+        std::vector<Outgoing> answers;
+        for (int i = 0; i < received; ++i) {
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                // Longer than max_datagram, its requester times out
+                continue;
+            }
+            DatagramProto datagram;
+            if (!datagram.ParseFromArray(iovs[i].iov_base, msgs[i].msg_len)) {
+                // Not one of ours
+                continue;
+            }
+            if (datagram.has_response()) {
+                respond(datagram.response(), from[i]);
+                if (orphaned) {
+                    return;
+                }
+                continue;
+            }
+            if (!datagram.has_request() || !server) {
+                // Not serving, the requester times out
+                continue;
+            }
+            const ExchangeRequest& request = datagram.request();
+            DatagramProto reply;
+            ExchangeResponse* response = reply.mutable_response();
+            response->set_id(request.id());
+            // Named as gRPC names its peers, the port is the requesting node's own
+            std::string requester = peer(from[i], msgs[i].msg_hdr.msg_namelen);
+            ::grpc::Status status;
+            if (request.type() == ExchangeRequest::PUSH) {
+                ViewProto unused;
+                status = server->serve(requester, request.type(), request.view(), unused);
+            }
+            else {
+                status = server->serve(requester, request.type(), request.view(), *response->mutable_view());
+            }
+            response->set_code(status.error_code());
+            if (reply.ByteSizeLong() > _max_datagram) {
+                // The request is merged by now, but the requester learns straight away instead of timing out
+                response->clear_view();
+                response->set_code(::grpc::StatusCode::RESOURCE_EXHAUSTED);
+            }
+            answers.emplace_back();
+            answers.back().to = from[i];
+            answers.back().to_len = msgs[i].msg_hdr.msg_namelen;
+            reply.SerializeToString(&answers.back().data);
+        }
+        // A whole batch of answers goes back out together
+        if (!answers.empty()) {
+            enqueue(answers);
+        }
+    }
+}
+
+}
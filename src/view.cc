@@ -18,13 +18,15 @@
  */
 
 #include <vector>
-#include <unordered_map>
 #include <deque>
+#include <unordered_map>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <random>
 #include <mutex>
-#include <queue>
+#include <algorithm>
+#include <numeric>
 #include <cstdint>
 
 #include "node_descriptor.h"
@@ -56,6 +58,58 @@ std::string VectorLog::to_string() const {
     return output;
 }
 
+/* Floyd's algorithm while k is small enough to check picks by scanning them, a partial Fisher-Yates over all n
+   otherwise */
+void sample_indices(std::size_t k, std::size_t n, Engine& eng, std::vector<uint32_t>& picks) {
+    k = std::min(k, n);
+    picks.clear();
+    if (k <= 16) {
+        for (std::size_t j = n - k; j < n; ++j) {
+            std::uniform_int_distribution<std::size_t> distr(0, j);
+            uint32_t pick = distr(eng);
+            if (std::find(picks.begin(), picks.end(), pick) != picks.end()) {
+                pick = j;
+            }
+            picks.push_back(pick);
+        }
+        // Floyd's picks the set uniformly but leaves the higher indices toward the back
+        std::shuffle(picks.begin(), picks.end(), eng);
+        return;
+    }
+    picks.resize(n);
+    std::iota(picks.begin(), picks.end(), 0);
+    for (std::size_t i = 0; i < k; ++i) {
+        std::uniform_int_distribution<std::size_t> distr(i, n - 1);
+        std::swap(picks[i], picks[distr(eng)]);
+    }
+    picks.resize(k);
+}
+
+/* Up to k calls to select, keeping the first of each address */
+template <class Select>
+static std::size_t select_distinct(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out, Select select) {
+    out.clear();
+    for (std::size_t i = 0; i < k; ++i) {
+        std::shared_ptr<NodeDescriptor> selected = select();
+        if (!selected) {
+            break;
+        }
+        auto same = [&selected](const std::shared_ptr<NodeDescriptor>& node) { return node->address() == selected->address(); };
+        if (std::none_of(out.begin(), out.end(), same)) {
+            out.push_back(selected);
+        }
+    }
+    return out.size();
+}
+
+std::size_t View::select_peers(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) {
+    return select_distinct(k, out, [this]() { return select_peer(); });
+}
+
+std::size_t View::PeerSelector::select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) {
+    return select_distinct(k, out, [this]() { return select_peer_impl(); });
+}
+
 std::shared_ptr<NodeDescriptor> View::LoggedPeerSelector::select_peer() {
     std::shared_ptr<NodeDescriptor> selected = select_peer_impl();
     uint64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
@@ -67,30 +121,69 @@ std::shared_ptr<NodeDescriptor> View::LoggedPeerSelector::select_peer() {
     return selected;
 }
 
+std::size_t View::LoggedPeerSelector::select_peers(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) {
+    select_peers_impl(k, out);
+    uint64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    if (out.empty()) {
+        _log->push_back(_id, "", ms);
+    }
+    for (auto& selected : out) {
+        _log->push_back(_id, selected->address(), ms);
+    }
+    return out.size();
+}
+
+static std::vector<uint32_t>& reader_picks() {
+    thread_local std::vector<uint32_t> picks;
+    return picks;
+}
+
 std::shared_ptr<NodeDescriptor> URView::TailPeerSelector::select_peer_impl() {
-    std::lock_guard<std::mutex> lock(_view->_lock);
-    if (!_view->_view.empty()) {
-        return _view->_view.back();
+    std::shared_ptr<const Snapshot> snapshot = _view->snapshot();
+    if (!snapshot->nodes.empty()) {
+        return snapshot->nodes.back();
     }
     return nullptr;
 }
 
+std::size_t URView::TailPeerSelector::select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) {
+    std::shared_ptr<const Snapshot> snapshot = _view->snapshot();
+    out.clear();
+    for (auto it = snapshot->nodes.rbegin(); it != snapshot->nodes.rend() && out.size() < k; ++it) {
+        out.push_back(*it);
+    }
+    return out.size();
+}
+
 std::string URView::TailPeerSelector::print() const {
-    std::string str = "TailPeerSelector(Selecting: " + _view->_view.back()->print() +
+    std::shared_ptr<const Snapshot> snapshot = _view->snapshot();
+    std::string str = "TailPeerSelector(Selecting: " + (snapshot->nodes.empty() ? "none" : snapshot->nodes.back()->print()) +
     ", View: " + _view->print() + ")";
     return str;
 }
 
 std::shared_ptr<NodeDescriptor> URView::URPeerSelector::select_peer_impl() {
-    std::lock_guard<std::mutex> lock(_view->_lock);
-    std::uniform_int_distribution<> distr(0, _view->_view.size() - 1); // This has to be inside dummy, size could change leading to oom access
-    //std::cout << "Selected Number UR select_peer_impl" << std::endl;
-    if (!_view->_view.empty()) {
-        return _view->_view[distr(_view->_eng)];
+    std::shared_ptr<const Snapshot> snapshot = _view->snapshot();
+    if (!snapshot->nodes.empty()) {
+        Engine eng = _view->reader_engine();
+        std::uniform_int_distribution<> distr(0, snapshot->nodes.size() - 1);
+        return snapshot->nodes[distr(eng)];
     }
     return nullptr;
 }
 
+std::size_t URView::URPeerSelector::select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) {
+    std::shared_ptr<const Snapshot> snapshot = _view->snapshot();
+    std::vector<uint32_t>& picks = reader_picks();
+    Engine eng = _view->reader_engine();
+    sample_indices(k, snapshot->nodes.size(), eng, picks);
+    out.clear();
+    for (uint32_t i : picks) {
+        out.push_back(snapshot->nodes[i]);
+    }
+    return out.size();
+}
+
 std::string URView::URPeerSelector::print() const {
     std::string str = "URPeerSelector(Selecting: all, View: " + _view->print() + ")";
     return str;
@@ -98,65 +191,131 @@ std::string URView::URPeerSelector::print() const {
 
 URView::URNRPeerSelector::URNRPeerSelector(std::shared_ptr<URView> view) : _view(view) {
     std::lock_guard<std::mutex> lock(_view->_lock);
-    for (auto node : _view->_view) {
-        _qos_queue.push_back(node);
+    for (auto& node : _view->_view) {
+        add(node);
     }
 }
 
 std::shared_ptr<NodeDescriptor> URView::URNRPeerSelector::select_peer_impl() {
     { // Removing these scoped braces will cause deadlock
         std::lock_guard<std::mutex> lock(_view->_lock);
-        while(!_qos_queue.empty()) {
-            std::shared_ptr<NodeDescriptor> selected_peer = _qos_queue.front();
-            if (_view->_node_lut.find(selected_peer->address()) != _view->_node_lut.end()) {
-                _qos_queue.pop_front();
-                return selected_peer;
-            }
-            _qos_queue.pop_front();
+        if (!_unselected.empty()) {
+            // Peers leave the pool as they leave the view, so whatever is drawn is still in it
+            return draw();
         }
     }
     return random_selection();
 }
 
+std::size_t URView::URNRPeerSelector::select_peers_impl(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) {
+    out.clear();
+    std::lock_guard<std::mutex> lock(_view->_lock);
+    while (out.size() < k && !_unselected.empty()) {
+        out.push_back(draw());
+    }
+    if (out.size() < k) {
+        // Published under the lock, so it holds everything just drawn from the pool. Of k distinct picks at most
+        // that many are repeats, which leaves enough to fill out
+        std::shared_ptr<const Snapshot> snapshot = _view->locked_snapshot();
+        const std::size_t drawn = out.size();
+        std::vector<uint32_t>& picks = reader_picks();
+        sample_indices(k, snapshot->nodes.size(), _view->_eng, picks);
+        for (std::size_t i = 0; i < picks.size() && out.size() < k; ++i) {
+            const std::shared_ptr<NodeDescriptor>& node = snapshot->nodes[picks[i]];
+            if (std::find(out.begin(), out.begin() + drawn, node) == out.begin() + drawn) {
+                out.push_back(node);
+            }
+        }
+    }
+    return out.size();
+}
+
 std::string URView::URNRPeerSelector::print() const {
     std::string str = "URNRPeerSelector(Selecting: ";
-    for (auto node : _qos_queue) {
-        str += node->print() + ", ";
+    {
+        std::lock_guard<std::mutex> lock(_view->_lock);
+        for (auto& node : _unselected) {
+            str += node->print() + ", ";
+        }
     }
     str += ", View: " + _view->print() + ")";
     return str;
 }
 
 std::shared_ptr<NodeDescriptor> URView::URNRPeerSelector::random_selection() {
-    std::uniform_int_distribution<> distr(0, _view->_view.size() - 1);
-    std::lock_guard<std::mutex> lock(_view->_lock);
-    if (!_view->_view.empty()) {
-        return _view->_view[distr(_view->_eng)];
+    std::shared_ptr<const Snapshot> snapshot = _view->snapshot();
+    if (!snapshot->nodes.empty()) {
+        Engine eng = _view->reader_engine();
+        std::uniform_int_distribution<> distr(0, snapshot->nodes.size() - 1);
+        return snapshot->nodes[distr(eng)];
     }
     return nullptr;
 }
 
-void URView::URNRPeerSelector::permute_qos_queue() {
-    std::shuffle(_qos_queue.begin(), _qos_queue.end(), _view->_eng);
+void URView::URNRPeerSelector::add(const std::shared_ptr<NodeDescriptor>& node) {
+    auto found = _positions.find(node->address());
+    if (found != _positions.end()) {
+        // Already waiting under this address, hold the descriptor now in the view and key by its address
+        std::size_t position = found->second;
+        _positions.erase(found);
+        _unselected[position] = node;
+        _positions.emplace(_unselected[position]->address(), position);
+        return;
+    }
+    _positions.emplace(node->address(), _unselected.size());
+    _unselected.push_back(node);
+}
+
+void URView::URNRPeerSelector::remove(std::string_view address) {
+    auto found = _positions.find(address);
+    if (found == _positions.end()) {
+        return;
+    }
+    std::size_t position = found->second;
+    _positions.erase(found);
+    if (position != _unselected.size() - 1) {
+        _unselected[position] = std::move(_unselected.back());
+        _positions[_unselected[position]->address()] = position;
+    }
+    _unselected.pop_back();
+}
+
+/* Under the view's lock, with _unselected not empty */
+std::shared_ptr<NodeDescriptor> URView::URNRPeerSelector::draw() {
+    std::uniform_int_distribution<std::size_t> distr(0, _unselected.size() - 1);
+    std::shared_ptr<NodeDescriptor> selected = _unselected[distr(_view->_eng)];
+    remove(selected->address());
+    return selected;
 }
 
 void URView::URNRPeerSelector::notify_add(std::shared_ptr<NodeDescriptor> new_node) {
-    _qos_queue.push_back(new_node);
-    permute_qos_queue();
+    add(new_node);
 }
 
 void URView::URNRPeerSelector::notify_add(std::vector<std::shared_ptr<NodeDescriptor>>& new_nodes) {
     for (auto& node : new_nodes) {
-        //std::cout << "Notify add: Adding " << *node << " to urnr qos_queue";
-        _qos_queue.push_back(node);
+        add(node);
     }
-    permute_qos_queue();
 }
 
-URView::URView(std::string address, int size, int healing, int swap) 
-                    : _self(std::make_shared<NodeDescriptor>(address, 0)),
-                    _size(size), _healing(healing), _swap(swap), _eng(_rd()), _selector(nullptr) {
+void URView::URNRPeerSelector::notify_delete(std::string& del_address) {
+    remove(del_address);
+}
+
+void URView::URNRPeerSelector::notify_delete(std::vector<std::string>& del_addresses) {
+    for (auto& address : del_addresses) {
+        remove(address);
+    }
+}
+
+URView::URView(std::string address, int size, int healing, int swap) : URView(address, size, healing, swap, random_seed()) {}
+
+URView::URView(std::string address, int size, int healing, int swap, uint64_t seed)
+                    : _seed(seed), _eng(seed), _streams(0), _self(std::make_shared<NodeDescriptor>(address, 0)),
+                    _stale(false), _members_changed(true), _clock(std::make_shared<std::atomic<uint32_t>>(0)), _selector(nullptr),
+                    _size(size), _healing(healing), _swap(swap) {
     _node_lut[address] = _self;
+    publish();
 }
 
 void URView::init_selector(SelectorType type, std::shared_ptr<TSLog> log) {
@@ -173,19 +332,93 @@ std::shared_ptr<NodeDescriptor> URView::select_peer() {
     return _selector->select_peer();
 }
 
+std::size_t URView::select_peers(std::size_t k, std::vector<std::shared_ptr<NodeDescriptor>>& out) {
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (!_selector) {
+            out.clear();
+            return 0;
+        }
+    }
+    return _selector->select_peers(k, out);
+}
+
 std::vector<std::shared_ptr<NodeDescriptor>> URView::tx_nodes() {
     std::vector<std::shared_ptr<NodeDescriptor>> buf;
     buf.push_back(_self);
     std::lock_guard<std::mutex> lock(_lock);
-    permute();
     move_old_to_back(_healing);
-    std::vector<std::shared_ptr<NodeDescriptor>> to_send = head((_size / 2) - 1);
+    const int num_send = (_size / 2) - 1;
+    sample_head(num_send, static_cast<int>(_view.size()) - std::max(_healing, 0));
+    std::vector<std::shared_ptr<NodeDescriptor>> to_send = head(num_send);
     buf.insert(buf.end(), to_send.begin(), to_send.end());
+    changed();
     return buf;
 }
 
 void URView::rx_nodes(std::vector<std::shared_ptr<NodeDescriptor>>& nodes) {
     std::lock_guard<std::mutex> lock(_lock);
+    receive(nodes);
+    changed();
+}
+
+void URView::merge(std::vector<std::shared_ptr<NodeDescriptor>>& nodes) {
+    std::lock_guard<std::mutex> lock(_lock);
+    receive(nodes);
+    changed();
+    _clock->fetch_add(1, std::memory_order_relaxed);
+}
+
+int URView::max_size() const {
+    return snapshot()->nodes.size();
+}
+
+bool URView::contains(std::string address) const {
+    if (address == _self->address()) {
+        return true;
+    }
+    std::shared_ptr<const Snapshot> current = snapshot();
+    std::shared_ptr<const std::unordered_set<std::string_view>> members = std::atomic_load(&current->members);
+    if (!members) {
+        // Racing readers may each build it, they build the same set
+        std::shared_ptr<std::unordered_set<std::string_view>> built = std::make_shared<std::unordered_set<std::string_view>>();
+        built->reserve(current->nodes.size());
+        for (auto& node : current->nodes) {
+            built->insert(node->address());
+        }
+        members = built;
+        std::atomic_store(&current->members, members);
+    }
+    return members->find(address) != members->end();
+}
+
+std::shared_ptr<const URView::Snapshot> URView::snapshot() const {
+    if (_stale.load()) {
+        std::lock_guard<std::mutex> lock(_lock);
+        return locked_snapshot();
+    }
+    return std::atomic_load(&_snapshot);
+}
+
+std::shared_ptr<const URView::Snapshot> URView::locked_snapshot() const {
+    if (_stale.load()) {
+        publish();
+    }
+    return std::atomic_load(&_snapshot);
+}
+
+void URView::publish() const {
+    std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>();
+    next->nodes.assign(_view.begin(), _view.end());
+    if (!_members_changed && _snapshot) {
+        next->members = std::atomic_load(&_snapshot->members);
+    }
+    _members_changed = false;
+    std::atomic_store(&_snapshot, std::shared_ptr<const Snapshot>(next));
+    _stale.store(false);
+}
+
+void URView::receive(std::vector<std::shared_ptr<NodeDescriptor>>& nodes) {
     append(nodes);
     // Dont need remove duplicates as duplicates are never added, just reset age
     remove_old(std::min(_healing, static_cast<int>(_view.size()) - _size));
@@ -206,15 +439,14 @@ std::vector<std::shared_ptr<NodeDescriptor>> URView::head(int num_get) const {
 }
 
 void URView::increment_age() {
-    std::lock_guard<std::mutex> _(_lock);
-    for (auto& node : _view) {
-        node->age()++;
-    }
+    _clock->fetch_add(1, std::memory_order_relaxed);
 }
 
 void URView::append(std::shared_ptr<NodeDescriptor> new_peer) {
     if (_node_lut.find(new_peer->address()) == _node_lut.end()) {
+        new_peer->attach(_clock);
         _view.push_back(new_peer);
+        _members_changed = true;
         for (auto& sub : _subscribers) {
             sub->notify_add(new_peer);
         }
@@ -224,7 +456,7 @@ void URView::append(std::shared_ptr<NodeDescriptor> new_peer) {
     else {
         // Reset age of already known peer
         if (_node_lut[new_peer->address()]->age() > new_peer->age()) {
-            _node_lut[new_peer->address()]->age() = new_peer->age();
+            _node_lut[new_peer->address()]->set_age(new_peer->age());
         }
     }
 }
@@ -233,14 +465,16 @@ void URView::append(std::vector<std::shared_ptr<NodeDescriptor>>& new_peers) {
     std::vector<std::shared_ptr<NodeDescriptor>> added;
     for (auto new_peer : new_peers) {
         if (_node_lut.find(new_peer->address()) == _node_lut.end()) {
+            new_peer->attach(_clock);
             _view.push_back(new_peer);
+            _members_changed = true;
             _node_lut[new_peer->address()] = new_peer;
             added.push_back(new_peer);
         }
         else {
             // Reset age of already known peer
             if (_node_lut[new_peer->address()]->age() > new_peer->age()) {
-                _node_lut[new_peer->address()]->age() = new_peer->age();
+                _node_lut[new_peer->address()]->set_age(new_peer->age());
             }
         }
     }
@@ -252,11 +486,35 @@ void URView::append(std::vector<std::shared_ptr<NodeDescriptor>>& new_peers) {
 void URView::manual_insert(std::shared_ptr<NodeDescriptor> new_node) {
     std::lock_guard<std::mutex> _(_lock);
     append(new_node);
+    changed();
 }
 
 void URView::manual_insert(std::vector<std::shared_ptr<NodeDescriptor>>& new_nodes) {
     std::lock_guard<std::mutex> _(_lock);
     append(new_nodes);
+    changed();
+}
+
+bool URView::remove(const std::string& address) {
+    std::lock_guard<std::mutex> _(_lock);
+    if (address == _self->address() || _node_lut.find(address) == _node_lut.end()) {
+        return false;
+    }
+    auto found = std::find_if(_view.begin(), _view.end(), [&address](const std::shared_ptr<NodeDescriptor>& node) {
+        return node->address() == address;
+    });
+    if (found != _view.end()) {
+        (*found)->detach();
+        _view.erase(found);
+    }
+    _node_lut.erase(address);
+    _members_changed = true;
+    changed();
+    std::string removed = address;
+    for (auto& sub : _subscribers) {
+        sub->notify_delete(removed);
+    }
+    return true;
 }
 
 void URView::move_old_to_back(int num_move) {
@@ -267,37 +525,36 @@ void URView::move_old_to_back(int num_move) {
     if (num_move > _view.size()) {
         num_move = _view.size();
     }
-
-    struct GossipNodeAgeComparator {
-        bool operator()(const std::shared_ptr<NodeDescriptor>& lhs,
-                        const std::shared_ptr<NodeDescriptor>& rhs) const {
-            return lhs->age() < rhs->age();  // Older nodes have higher priority
+    const int n = _view.size();
+
+    // Ages are read once, the clock can tick under us
+    _ages.resize(n);
+    for (int i = 0; i < n; ++i) {
+        _ages[i] = _view[i]->age();
+    }
+    // Selection rather than a sort finds the age of the num_move'th oldest
+    _select_ages.assign(_ages.begin(), _ages.end());
+    std::nth_element(_select_ages.begin(), _select_ages.begin() + (n - num_move), _select_ages.end());
+    const uint32_t threshold = _select_ages[n - num_move];
+    int ties = num_move;
+    for (uint32_t age : _ages) {
+        if (age > threshold) {
+            --ties;
         }
-    };
-
-    std::priority_queue<std::shared_ptr<NodeDescriptor>, 
-                        std::vector<std::shared_ptr<NodeDescriptor>>, 
-                        GossipNodeAgeComparator> age_q;
-
-    std::unordered_map<std::string, int> idx_lut;
-
-    for (int i = 0; i < _view.size(); ++i) {
-        age_q.push(_view[i]);
-        idx_lut[_view[i]->address()] = i;
     }
-    
-    int back = _view.size() - 1;
 
-    for (int i = 0; i < num_move && !age_q.empty(); ++i) {
-        int oldest_idx = idx_lut[age_q.top()->address()];
-        age_q.pop();
-        
-        if (oldest_idx != back) {
-            std::swap(_view[oldest_idx], _view[back]);
-            idx_lut[_view[oldest_idx]->address()] = oldest_idx;
+    // Stable, so neither side is reordered
+    int kept = 0;
+    for (int i = 0; i < n; ++i) {
+        if (_ages[i] > threshold || (_ages[i] == threshold && ties-- > 0)) {
+            _oldest.push_back(std::move(_view[i]));
+        }
+        else if (kept++ != i) {
+            _view[kept - 1] = std::move(_view[i]);
         }
-        --back;
     }
+    std::move(_oldest.begin(), _oldest.end(), _view.begin() + kept);
+    _oldest.clear();
 }
 
 void URView::remove_old(int num_remove) {
@@ -311,8 +568,7 @@ void URView::remove_old(int num_remove) {
     move_old_to_back(num_remove);
     std::vector<std::string> removed;
     for (int i=0; i < num_remove; ++i) {
-        removed.push_back(_view.back()->address());
-        _node_lut.erase(_view.back()->address());
+        forget(_view.back(), removed);
         _view.pop_back();
     }
     for (auto& sub : _subscribers) {
@@ -320,6 +576,14 @@ void URView::remove_old(int num_remove) {
     }
 }
 
+/* Drops node from the lookup table and stops it aging, the caller takes it out of _view and notifies */
+void URView::forget(const std::shared_ptr<NodeDescriptor>& node, std::vector<std::string>& removed) {
+    removed.push_back(node->address());
+    _node_lut.erase(node->address());
+    node->detach();
+    _members_changed = true;
+}
+
 void URView::remove_head(int num_remove) {
     if (num_remove <= 0 || _view.empty()) {
         // ToDo: Add Logging
@@ -330,10 +594,9 @@ void URView::remove_head(int num_remove) {
     }
     std::vector<std::string> removed;
     for (int i=0; i < num_remove; ++i) {
-        removed.push_back(_view.front()->address());
-        _node_lut.erase(_view.front()->address());
+        forget(_view.front(), removed);
+        _view.pop_front();
     }
-    _view.erase(_view.begin(), _view.begin() + num_remove);
 
     for (auto& sub : _subscribers) {
         sub->notify_delete(removed);
@@ -348,21 +611,36 @@ void URView::remove_random(int num_remove) {
     if (num_remove > _view.size()) {
         num_remove = _view.size();
     }
+    sample_indices(num_remove, _view.size(), _eng, _picks);
+    std::sort(_picks.begin(), _picks.end());
     std::vector<std::string> removed;
-    for (int i=0; i < num_remove; ++i) {
-        std::uniform_int_distribution<> distr(0, _view.size() - 1);
-        int rand = distr(_eng);
-        removed.push_back(_view[rand]->address());
-        _view.erase(_view.begin() + rand);
+    // One stable pass from the first pick, the nodes kept stay in order for the tail and the head
+    auto pick = _picks.begin();
+    std::size_t kept = *pick;
+    for (std::size_t i = *pick; i < _view.size(); ++i) {
+        if (pick != _picks.end() && *pick == i) {
+            forget(_view[i], removed);
+            ++pick;
+        }
+        else {
+            _view[kept++] = std::move(_view[i]);
+        }
     }
+    _view.erase(_view.begin() + kept, _view.end());
 
     for (auto& sub : _subscribers) {
         sub->notify_delete(removed);
     }
 }
 
-void URView::permute() {
-    std::shuffle(_view.begin(), _view.end(), _eng);
+/* Partial Fisher-Yates, leaves a uniform sample of num_sample of the first range nodes at the head without
+   shuffling the rest */
+void URView::sample_head(int num_sample, int range) {
+    num_sample = std::min(num_sample, range);
+    for (int i = 0; i < num_sample; ++i) {
+        std::uniform_int_distribution<> distr(i, range - 1);
+        std::swap(_view[i], _view[distr(_eng)]);
+    }
 }
 
 std::string URView::print() const {
@@ -371,7 +649,7 @@ std::string URView::print() const {
         + ", Healing: " + std::to_string( _healing) 
         + ", Swap: " + std::to_string(_swap)
         + ", Nodes: ";
-    for (auto& node : _view) {
+    for (auto& node : snapshot()->nodes) {
         str += node->print() + ", ";
     }
     str += ")";
@@ -0,0 +1,167 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "admission_control.h"
+#include "loopback_transport.h"
+#include "client.h"
+#include "server.h"
+
+using namespace gossip;
+
+TEST(_AdmissionControl_, construction) {
+    AdmissionControl admission_control(10.0, 5.0, 100);
+    ASSERT_EQ(admission_control.rate(), 10.0);
+    ASSERT_EQ(admission_control.burst(), 5.0);
+    ASSERT_EQ(admission_control.max_in_flight(), 100);
+    ASSERT_EQ(admission_control.size(), 0);
+    ASSERT_EQ(admission_control.in_flight(), 0);
+}
+
+TEST(_AdmissionControl_, rate) {
+    AdmissionControl admission_control(20.0, 2.0, 0);
+    ASSERT_TRUE(admission_control.admit("ipv4:10.0.0.1"));
+    admission_control.release();
+    ASSERT_TRUE(admission_control.admit("ipv4:10.0.0.1"));
+    admission_control.release();
+    ASSERT_FALSE(admission_control.admit("ipv4:10.0.0.1"));
+    ASSERT_EQ(admission_control.rejected_rate(), 1);
+
+    // Sources are limited independently
+    ASSERT_TRUE(admission_control.admit("ipv4:10.0.0.2"));
+    admission_control.release();
+    ASSERT_EQ(admission_control.size(), 2);
+
+    // A token is back after 1 / rate
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(admission_control.admit("ipv4:10.0.0.1"));
+    admission_control.release();
+    ASSERT_EQ(admission_control.accepted(), 4);
+    ASSERT_EQ(admission_control.in_flight(), 0);
+}
+
+TEST(_AdmissionControl_, in_flight) {
+    AdmissionControl admission_control(0.0, 1.0, 2);
+    ASSERT_TRUE(admission_control.admit("ipv4:10.0.0.1"));
+    ASSERT_TRUE(admission_control.admit(""));
+    ASSERT_FALSE(admission_control.admit("ipv4:10.0.0.2"));
+    ASSERT_EQ(admission_control.rejected_in_flight(), 1);
+    ASSERT_EQ(admission_control.in_flight(), 2);
+
+    admission_control.release();
+    ASSERT_TRUE(admission_control.admit("ipv4:10.0.0.2"));
+    ASSERT_EQ(admission_control.rejected(), 1);
+    // No rate, no sources tracked
+    ASSERT_EQ(admission_control.size(), 0);
+}
+
+TEST(_AdmissionControl_, max_sources) {
+    AdmissionControl admission_control(1.0, 1.0, 0, 2);
+    ASSERT_TRUE(admission_control.admit("a"));
+    ASSERT_TRUE(admission_control.admit("b"));
+    // Both still limited, nothing can make room
+    ASSERT_FALSE(admission_control.admit("c"));
+    ASSERT_EQ(admission_control.size(), 2);
+
+    // Refilled buckets are dropped to make room
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    ASSERT_TRUE(admission_control.admit("c"));
+    ASSERT_EQ(admission_control.size(), 1);
+}
+
+TEST(_AdmissionControl_, max_sources_lru) {
+    AdmissionControl admission_control(1.0, 1.0, 0, 2);
+    ASSERT_TRUE(admission_control.admit("a"));
+    ASSERT_TRUE(admission_control.admit("b"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    // a is seen again and limited once more, b is now the least recently seen and has refilled
+    ASSERT_TRUE(admission_control.admit("a"));
+    ASSERT_TRUE(admission_control.admit("c"));
+    ASSERT_EQ(admission_control.size(), 2);
+
+    // a is the least recently seen and still limited, the sweep stops there
+    ASSERT_FALSE(admission_control.admit("d"));
+    ASSERT_EQ(admission_control.size(), 2);
+    // b was dropped, had it been kept its refilled bucket would have let it in
+    ASSERT_FALSE(admission_control.admit("b"));
+}
+
+TEST(_Server_, source) {
+    ASSERT_EQ(Server::source("ipv4:10.0.0.1:50000"), "ipv4:10.0.0.1");
+    ASSERT_EQ(Server::source("ipv6:[::1]:50000"), "ipv6:[::1]");
+    ASSERT_EQ(Server::source("unix:/tmp/node.sock"), "unix:/tmp/node.sock");
+    ASSERT_EQ(Server::source("inproc"), "inproc");
+}
+
+TEST(_Server_, admission_per_peer) {
+    std::shared_ptr<URView> view = std::make_shared<URView>("node:0", 10, 5, 5);
+    view->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view);
+    std::shared_ptr<AdmissionControl> admission_control = std::make_shared<AdmissionControl>(0.1, 1.0, 0);
+    server->set_admission_control(admission_control);
+    ViewProto request;
+    ViewProto response;
+
+    // Two nodes on one host are limited apart
+    ASSERT_TRUE(server->serve("ipv4:10.0.0.1:50000", ExchangeRequest::PUSH, request, response).ok());
+    ASSERT_TRUE(server->serve("ipv4:10.0.0.1:50001", ExchangeRequest::PUSH, request, response).ok());
+    ASSERT_EQ(server->serve("ipv4:10.0.0.1:50000", ExchangeRequest::PUSH, request, response).error_code(),
+              ::grpc::StatusCode::RESOURCE_EXHAUSTED);
+    ASSERT_EQ(admission_control->size(), 2);
+
+    // Per host they share one bucket
+    admission_control = std::make_shared<AdmissionControl>(0.1, 1.0, 0);
+    admission_control->set_per_host(true);
+    ASSERT_TRUE(admission_control->per_host());
+    server->set_admission_control(admission_control);
+    ASSERT_TRUE(server->serve("ipv4:10.0.0.1:50000", ExchangeRequest::PUSH, request, response).ok());
+    ASSERT_EQ(server->serve("ipv4:10.0.0.1:50001", ExchangeRequest::PUSH, request, response).error_code(),
+              ::grpc::StatusCode::RESOURCE_EXHAUSTED);
+    ASSERT_EQ(admission_control->size(), 1);
+}
+
+TEST(_Server_, admission_control) {
+    std::shared_ptr<LoopbackTransport> transport = std::make_shared<LoopbackTransport>();
+    std::shared_ptr<URView> view_server = std::make_shared<URView>("node:0", 10, 5, 5);
+    view_server->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view_server);
+    std::shared_ptr<AdmissionControl> admission_control = std::make_shared<AdmissionControl>(0.1, 1.0, 0);
+    server->set_admission_control(admission_control);
+    ASSERT_EQ(server->admission_control(), admission_control);
+    transport->serve(server);
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("node:1", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view_client);
+    client->set_transport(transport);
+
+    ASSERT_TRUE(client->push_view("node:0").ok());
+    ASSERT_TRUE(view_server->contains("node:1"));
+    // The second push is over node:1's rate
+    ASSERT_EQ(client->push_view("node:0").error_code(), ::grpc::StatusCode::RESOURCE_EXHAUSTED);
+    ASSERT_EQ(admission_control->accepted(), 1);
+    ASSERT_EQ(admission_control->rejected(), 1);
+    ASSERT_EQ(client->in_flight(), 0);
+}
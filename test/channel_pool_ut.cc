@@ -0,0 +1,118 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "channel_pool.h"
+
+using namespace gossip;
+
+TEST(_ChannelPool_, reuse_channel) {
+    ChannelPool pool(4, std::chrono::seconds(60));
+    auto first = pool.stub("127.0.0.1:7000");
+    auto second = pool.stub("127.0.0.1:7000");
+    ASSERT_EQ(first, second);
+    ASSERT_EQ(pool.channel("127.0.0.1:7000"), pool.channel("127.0.0.1:7000"));
+    ASSERT_EQ(pool.size(), 1);
+}
+
+TEST(_ChannelPool_, distinct_addresses) {
+    ChannelPool pool(4, std::chrono::seconds(60));
+    auto first = pool.stub("127.0.0.1:7000");
+    auto second = pool.stub("127.0.0.1:7001");
+    ASSERT_NE(first, second);
+    ASSERT_EQ(pool.size(), 2);
+}
+
+TEST(_ChannelPool_, lru_eviction) {
+    ChannelPool pool(2, std::chrono::seconds(60));
+    pool.stub("127.0.0.1:7000");
+    pool.stub("127.0.0.1:7001");
+    // Touch 7000 so 7001 is the least recently used
+    pool.stub("127.0.0.1:7000");
+    pool.stub("127.0.0.1:7002");
+    ASSERT_EQ(pool.size(), 2);
+    ASSERT_TRUE(pool.contains("127.0.0.1:7000"));
+    ASSERT_FALSE(pool.contains("127.0.0.1:7001"));
+    ASSERT_TRUE(pool.contains("127.0.0.1:7002"));
+}
+
+TEST(_ChannelPool_, idle_timeout) {
+    ChannelPool pool(4, std::chrono::milliseconds(20));
+    pool.stub("127.0.0.1:7000");
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    pool.stub("127.0.0.1:7001");
+    ASSERT_FALSE(pool.contains("127.0.0.1:7000"));
+    ASSERT_TRUE(pool.contains("127.0.0.1:7001"));
+}
+
+TEST(_ChannelPool_, evicted_stub_outlives_pool_entry) {
+    ChannelPool pool(1, std::chrono::seconds(60));
+    auto held = pool.stub("127.0.0.1:7000");
+    pool.stub("127.0.0.1:7001");
+    ASSERT_FALSE(pool.contains("127.0.0.1:7000"));
+    ASSERT_NE(held, nullptr);
+    ASSERT_NE(pool.stub("127.0.0.1:7000"), held);
+}
+
+TEST(_ChannelPool_, evict_and_clear) {
+    ChannelPool pool(4, std::chrono::seconds(60));
+    pool.stub("127.0.0.1:7000");
+    pool.stub("127.0.0.1:7001");
+    pool.evict("127.0.0.1:7000");
+    ASSERT_FALSE(pool.contains("127.0.0.1:7000"));
+    ASSERT_EQ(pool.size(), 1);
+    pool.clear();
+    ASSERT_EQ(pool.size(), 0);
+}
+
+TEST(_ChannelPool_, clear_releases_retired) {
+    ChannelPool pool(4, std::chrono::seconds(60));
+    auto held = pool.stub("127.0.0.1:7000");
+    std::weak_ptr<GossipProtocol::Stub> retired = held;
+    pool.evict("127.0.0.1:7000");
+    // Still held by an exchange, so only retired
+    ASSERT_FALSE(retired.expired());
+    held.reset();
+    pool.clear();
+    ASSERT_TRUE(retired.expired());
+}
+
+TEST(_ChannelPool_, idle_sweep_releases_retired) {
+    ChannelPool pool(4, std::chrono::milliseconds(20));
+    std::weak_ptr<GossipProtocol::Stub> idle = pool.stub("127.0.0.1:7000");
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    pool.stub("127.0.0.1:7001");
+    ASSERT_TRUE(idle.expired());
+}
+
+TEST(_ChannelPool_, global) {
+    ASSERT_EQ(ChannelPool::global(), ChannelPool::global());
+}
+
+TEST(_ChannelPool_, print) {
+    ChannelPool pool(4, std::chrono::seconds(60));
+    pool.stub("127.0.0.1:7000");
+    std::cout << pool << std::endl;
+}
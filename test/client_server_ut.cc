@@ -17,6 +17,10 @@
  * 
  */
 
+#include <future>
+#include <thread>
+#include <chrono>
+
 #include <gtest/gtest.h>
 
 #include <grpcpp/grpcpp.h>
@@ -152,6 +156,81 @@ TEST(_Client_, thread_full_view_single) {
     std::this_thread::sleep_for(std::chrono::seconds(timeout+1));
 }
 
+TEST(_Client_, async_push_pull_view_non_blocking) {
+    const bool push = true;
+    const bool pull = true;
+    unsigned int wait_time = 1;
+    unsigned int timeout = 1;
+    int size = 10;
+    int healing = 5;
+    int swap = 5;
+
+    std::shared_ptr<URView> view = std::make_shared<URView>("localhost:50051", size, healing, swap);
+    view->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(push, pull, wait_time, timeout, view);
+
+    std::promise<::grpc::Status> done;
+    auto start = std::chrono::steady_clock::now();
+    client->async_push_pull_view("192.168.225.1:7000", [&done](::grpc::Status status) { done.set_value(status); });
+    // Unroutable peer, returning must not wait on the deadline
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    ASSERT_FALSE(done.get_future().get().ok());
+    ASSERT_EQ(client->in_flight(), 0);
+}
+
+TEST(_Client_, max_in_flight) {
+    const bool push = true;
+    const bool pull = true;
+    unsigned int wait_time = 1;
+    unsigned int timeout = 1;
+    int size = 10;
+    int healing = 5;
+    int swap = 5;
+
+    std::shared_ptr<URView> view = std::make_shared<URView>("localhost:50051", size, healing, swap);
+    view->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(push, pull, wait_time, timeout, view);
+    ASSERT_EQ(client->max_in_flight(), 16);
+    client->set_max_in_flight(1);
+    ASSERT_EQ(client->max_in_flight(), 1);
+
+    std::promise<::grpc::Status> first;
+    client->async_push_pull_view("192.168.225.1:7000", [&first](::grpc::Status status) { first.set_value(status); });
+    ::grpc::Status second = client->push_pull_view("192.168.225.1:7001");
+    ASSERT_EQ(second.error_code(), ::grpc::StatusCode::RESOURCE_EXHAUSTED);
+    first.get_future().wait();
+}
+
+TEST(_Client_, construction_ms) {
+    std::shared_ptr<URView> view = std::make_shared<URView>("localhost:50051", 10, 5, 5);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, std::chrono::milliseconds(100), std::chrono::milliseconds(250), view);
+    ASSERT_EQ(client->wait_time(), std::chrono::milliseconds(100));
+    ASSERT_EQ(client->timeout(), std::chrono::milliseconds(250));
+    ASSERT_EQ(client->jitter(), std::chrono::milliseconds(0));
+    client->set_jitter(std::chrono::milliseconds(20));
+    ASSERT_EQ(client->jitter(), std::chrono::milliseconds(20));
+    // Never jitters a round onto the previous one
+    client->set_jitter(std::chrono::milliseconds(500));
+    ASSERT_EQ(client->jitter(), std::chrono::milliseconds(99));
+
+    std::shared_ptr<Client> client_s = std::make_shared<Client>(true, true, 2, 1, view);
+    ASSERT_EQ(client_s->wait_time(), std::chrono::milliseconds(2000));
+    ASSERT_EQ(client_s->timeout(), std::chrono::milliseconds(1000));
+}
+
+TEST(_Client_, thread_stop_immediate) {
+    std::shared_ptr<URView> view = std::make_shared<URView>("localhost:50051", 10, 5, 5);
+    view->init_selector(SelectorType::TAIL);
+    // A long period, stopping must not wait it out
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 30, 1, view);
+    auto thread = client->thread();
+    thread->start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto start = std::chrono::steady_clock::now();
+    thread->stop();
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+}
+
 /*
 In the below server.Wait() isnt called, but doesn't matter because the server never leaves scope and so is active for the client requests
 */
@@ -226,4 +305,195 @@ TEST(_ClientServer_, push_pull) {
     ::grpc::Status result = client->push_pull_view("0.0.0.0:50051");
 
     ASSERT_TRUE(result.ok());
-}
\ No newline at end of file
+}
+
+TEST(_ClientServer_, fanout_round) {
+    const int num_servers = 3;
+    std::vector<std::shared_ptr<URView>> server_views;
+    std::vector<std::shared_ptr<Server::Thread>> server_threads;
+    std::vector<std::shared_ptr<NodeDescriptor>> peers;
+    for (int i = 0; i < num_servers; ++i) {
+        std::string address = "0.0.0.0:" + std::to_string(50061 + i);
+        std::shared_ptr<URView> view_server = std::make_shared<URView>(address, 10, 5, 5);
+        view_server->init_selector(SelectorType::TAIL);
+        std::shared_ptr<Server> server = std::make_shared<Server>(view_server);
+        server_threads.push_back(server->thread());
+        server_threads.back()->start();
+        server_views.push_back(view_server);
+        peers.push_back(std::make_shared<NodeDescriptor>(address, 0));
+    }
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("clienthost:50060", 10, 5, 5);
+    view_client->init_selector(SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT);
+    view_client->rx_nodes(peers);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, false, 1, 1, view_client);
+    client->set_fanout(num_servers);
+    ASSERT_EQ(client->fanout(), num_servers);
+
+    std::promise<::grpc::Status> done;
+    client->async_gossip_round([&done](::grpc::Status status) { done.set_value(status); });
+    ASSERT_TRUE(done.get_future().get().ok());
+    // Every exchange of the round completed before it was reported
+    ASSERT_EQ(client->in_flight(), 0);
+    for (auto& view_server : server_views) {
+        ASSERT_TRUE(view_server->contains("clienthost:50060"));
+    }
+}
+
+TEST(_Client_, fanout_round_no_peers) {
+    std::shared_ptr<URView> view = std::make_shared<URView>("localhost:50051", 10, 5, 5);
+    view->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view);
+    client->set_fanout(0);
+    ASSERT_EQ(client->fanout(), 1);
+
+    std::promise<::grpc::Status> done;
+    client->async_gossip_round([&done](::grpc::Status status) { done.set_value(status); });
+    ASSERT_EQ(done.get_future().get().error_code(), ::grpc::StatusCode::NOT_FOUND);
+}
+
+TEST(_ClientServer_, adaptive_timeout) {
+    std::string address = "0.0.0.0:50065";
+    std::shared_ptr<URView> view_server = std::make_shared<URView>(address, 10, 5, 5);
+    view_server->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view_server);
+    std::shared_ptr<Server::Thread> server_thread = server->thread();
+    server_thread->start();
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("clienthost:50066", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 2, view_client);
+    std::shared_ptr<RttTracker> rtt_tracker = std::make_shared<RttTracker>(std::chrono::milliseconds(20), std::chrono::seconds(10));
+    client->set_rtt_tracker(rtt_tracker);
+    ASSERT_EQ(client->rtt_tracker(), rtt_tracker);
+    // Unmeasured peers get the client's own timeout, the tracker's bound is looser
+    ASSERT_EQ(client->timeout(address), std::chrono::milliseconds(2000));
+
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(client->push_pull_view(address).ok());
+    }
+    ASSERT_TRUE(rtt_tracker->contains(address));
+    // Loopback round trips are well under the floor
+    ASSERT_EQ(client->timeout(address), std::chrono::milliseconds(20));
+}
+
+/* Merges slowly, as a large view would */
+class SlowMergeView final : public View {
+    public:
+        SlowMergeView(std::shared_ptr<URView> view, std::chrono::milliseconds delay) : _view(view), _delay(delay) {}
+
+        std::shared_ptr<NodeDescriptor> select_peer() override { return _view->select_peer(); }
+        std::vector<std::shared_ptr<NodeDescriptor>> tx_nodes() override { return _view->tx_nodes(); }
+        void rx_nodes(std::vector<std::shared_ptr<NodeDescriptor>>& nodes) override {
+            std::this_thread::sleep_for(_delay);
+            _view->rx_nodes(nodes);
+        }
+        void increment_age() override { _view->increment_age(); }
+        void init_selector(SelectorType type, std::shared_ptr<TSLog> log=nullptr) override { _view->init_selector(type, log); }
+        const std::shared_ptr<NodeDescriptor> self() const override { return _view->self(); }
+        int size() const override { return _view->size(); }
+        bool contains(std::string address) const override { return _view->contains(address); }
+        std::string print() const override { return _view->print(); }
+        std::shared_ptr<PeerSelector> create_subscriber(SelectorType type, std::shared_ptr<TSLog> log=nullptr) override { 
+            return _view->create_subscriber(type, log); 
+        }
+        void manual_insert(std::shared_ptr<NodeDescriptor> new_node) override { _view->manual_insert(new_node); }
+        void manual_insert(std::vector<std::shared_ptr<NodeDescriptor>>& new_nodes) override { _view->manual_insert(new_nodes); }
+
+    private:
+        std::shared_ptr<URView> _view;
+        std::chrono::milliseconds _delay;
+};
+
+TEST(_ClientServer_, rtt_excludes_merge) {
+    std::string address = "0.0.0.0:50112";
+    std::shared_ptr<URView> view_server = std::make_shared<URView>(address, 10, 5, 5);
+    view_server->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view_server);
+    std::shared_ptr<Server::Thread> server_thread = server->thread();
+    server_thread->start();
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("clienthost:50113", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<View> slow_view = std::make_shared<SlowMergeView>(view_client, std::chrono::milliseconds(200));
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 2, slow_view);
+    std::shared_ptr<RttTracker> rtt_tracker = std::make_shared<RttTracker>(std::chrono::milliseconds(20), std::chrono::seconds(10));
+    client->set_rtt_tracker(rtt_tracker);
+
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_TRUE(client->push_pull_view(address).ok());
+    }
+    // Sampled when the response arrives, the merge that follows isn't part of the round trip
+    ASSERT_LT(rtt_tracker->srtt(address), std::chrono::milliseconds(200));
+}
+
+TEST(_ClientServer_, failure_detector_evicts) {
+    std::string live = "0.0.0.0:50067";
+    std::string dead = "127.0.0.1:1";
+    std::shared_ptr<URView> view_server = std::make_shared<URView>(live, 10, 5, 5);
+    view_server->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view_server);
+    std::shared_ptr<Server::Thread> server_thread = server->thread();
+    server_thread->start();
+
+    std::vector<std::shared_ptr<NodeDescriptor>> peers = {std::make_shared<NodeDescriptor>(live, 0),
+                                                           std::make_shared<NodeDescriptor>(dead, 0)};
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("clienthost:50068", 10, 5, 5);
+    view_client->init_selector(SelectorType::UNIFORM_RANDOM);
+    view_client->rx_nodes(peers);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, false, 1, 1, view_client);
+    std::shared_ptr<FailureDetector> failure_detector = std::make_shared<FailureDetector>(1, 3);
+    client->set_failure_detector(failure_detector);
+    ASSERT_EQ(client->failure_detector(), failure_detector);
+
+    // Nothing listens on the dead address, every exchange with it is refused
+    ASSERT_FALSE(client->push_view(dead).ok());
+    ASSERT_TRUE(failure_detector->suspected(dead));
+    ASSERT_TRUE(view_client->contains(dead));
+
+    // Suspects are passed over while a healthy peer is available
+    for (int i = 0; i < 10; ++i) {
+        std::promise<::grpc::Status> done;
+        client->async_gossip_round([&done](::grpc::Status status) { done.set_value(status); });
+        ASSERT_TRUE(done.get_future().get().ok());
+    }
+    ASSERT_EQ(failure_detector->failures(dead), 1);
+
+    ASSERT_FALSE(client->push_view(dead).ok());
+    ASSERT_FALSE(client->push_view(dead).ok());
+    ASSERT_FALSE(view_client->contains(dead));
+    ASSERT_TRUE(view_client->contains(live));
+    ASSERT_EQ(failure_detector->size(), 0);
+}
+
+TEST(_Server_, options) {
+    std::string address = "0.0.0.0:50110";
+    std::shared_ptr<URView> view_server = std::make_shared<URView>(address, 10, 5, 5);
+    view_server->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view_server);
+    ServerOptions options;
+    options.memory_quota = 16 * 1024 * 1024;
+    options.max_concurrent_streams = 16;
+    options.keepalive_time = std::chrono::seconds(10);
+    options.keepalive_timeout = std::chrono::seconds(2);
+    options.min_ping_interval = std::chrono::seconds(5);
+    options.max_connection_idle = std::chrono::seconds(30);
+    options.shutdown_grace = std::chrono::milliseconds(200);
+    server->set_options(options);
+    ASSERT_EQ(server->options().max_concurrent_streams, 16);
+    std::shared_ptr<Server::Thread> server_thread = server->thread();
+    server_thread->start();
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("clienthost:50111", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view_client);
+    std::shared_ptr<ExchangeStreamPool> exchange_streams = std::make_shared<ExchangeStreamPool>(client->channel_pool());
+    client->set_exchange_streams(exchange_streams);
+    ASSERT_TRUE(client->push_pull_view(address).ok());
+    ASSERT_TRUE(view_server->contains("clienthost:50111"));
+
+    // The exchange stream is still open, stopping cancels it once the grace period is up rather than waiting on it
+    auto start = std::chrono::steady_clock::now();
+    server_thread->stop();
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
@@ -0,0 +1,169 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "entry_sampler.h"
+#include "loopback_transport.h"
+#include "client.h"
+#include "server.h"
+
+using namespace gossip;
+
+namespace {
+
+std::shared_ptr<URView> make_view(const std::string& address, int num_peers) {
+    std::shared_ptr<URView> view = std::make_shared<URView>(address, 10, 5, 5);
+    view->init_selector(SelectorType::TAIL);
+    std::vector<std::shared_ptr<NodeDescriptor>> peers;
+    for (int i = 0; i < num_peers; ++i) {
+        peers.push_back(std::make_shared<NodeDescriptor>("peer:" + std::to_string(i), 0));
+    }
+    view->manual_insert(peers);
+    return view;
+}
+
+bool has_address(const ViewProto& view, const std::string& address) {
+    for (auto& node : view.nodes()) {
+        if (node.address() == address) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+TEST(_EntrySampler_, construction) {
+    std::shared_ptr<EntrySampler> sampler = std::make_shared<EntrySampler>(make_view("entry:0", 0), std::chrono::milliseconds(50), 4, 8);
+    ASSERT_EQ(sampler->refresh_interval(), std::chrono::milliseconds(50));
+    ASSERT_EQ(sampler->num_samples(), 4);
+    ASSERT_EQ(sampler->reservoir_size(), 8);
+    ASSERT_FALSE(sampler->active());
+
+    // Nothing drawn before the first refresh
+    ViewProto response;
+    sampler->sample(response);
+    ASSERT_EQ(response.nodes_size(), 0);
+}
+
+TEST(_EntrySampler_, sample) {
+    std::shared_ptr<EntrySampler> sampler = std::make_shared<EntrySampler>(make_view("entry:0", 8), std::chrono::milliseconds(50), 4, 8);
+    sampler->refresh();
+
+    ViewProto response;
+    sampler->sample(response);
+    ASSERT_GT(response.nodes_size(), 1);
+    ASSERT_EQ(response.nodes(0).address(), "entry:0");
+}
+
+TEST(_EntrySampler_, refresh_keeps_view_order) {
+    std::shared_ptr<URView> view = make_view("entry:0", 8);
+    std::shared_ptr<View::PeerSelector> tail = view->create_subscriber(SelectorType::TAIL);
+    std::vector<std::shared_ptr<NodeDescriptor>> before;
+    tail->select_peers(8, before);
+    std::shared_ptr<EntrySampler> sampler = std::make_shared<EntrySampler>(view, std::chrono::milliseconds(50), 4, 8);
+    sampler->refresh();
+
+    // Sampling left the order later swaps and healing go by alone
+    std::vector<std::shared_ptr<NodeDescriptor>> after;
+    tail->select_peers(8, after);
+    ASSERT_EQ(before, after);
+    // As many peers as an exchange sends, after the entry point itself
+    ViewProto response;
+    sampler->sample(response);
+    ASSERT_EQ(response.nodes_size(), 1 + view->size() / 2 - 1);
+    ASSERT_EQ(response.nodes(0).address(), "entry:0");
+}
+
+TEST(_EntrySampler_, reservoir) {
+    std::shared_ptr<URView> view = make_view("entry:0", 0);
+    std::shared_ptr<EntrySampler> sampler = std::make_shared<EntrySampler>(view, std::chrono::milliseconds(50), 4, 8);
+
+    ViewProto request;
+    for (int i = 0; i < 100; ++i) {
+        NodeDescriptorProto* node = request.add_nodes();
+        node->set_address("joiner:" + std::to_string(i));
+        node->set_age(0);
+    }
+    sampler->admit(request);
+    ASSERT_EQ(sampler->reservoir(), 8);
+    ASSERT_EQ(sampler->offered(), 100);
+
+    // The view only changes on refresh
+    ASSERT_FALSE(view->contains("joiner:0"));
+    sampler->refresh();
+    ASSERT_EQ(sampler->reservoir(), 0);
+    ASSERT_NE(view->select_peer(), nullptr);
+}
+
+TEST(_EntrySampler_, redirects) {
+    std::shared_ptr<EntrySampler> sampler = std::make_shared<EntrySampler>(make_view("entry:0", 2), std::chrono::milliseconds(50), 2, 8);
+    sampler->set_redirects({"entry:1", "entry:2"});
+    ASSERT_EQ(sampler->redirects().size(), 2);
+
+    sampler->refresh();
+    for (int i = 0; i < 2; ++i) {
+        ViewProto response;
+        sampler->sample(response);
+        ASSERT_TRUE(has_address(response, "entry:1"));
+        ASSERT_TRUE(has_address(response, "entry:2"));
+    }
+}
+
+TEST(_EntrySampler_, start_stop) {
+    std::shared_ptr<EntrySampler> sampler = std::make_shared<EntrySampler>(make_view("entry:0", 2), std::chrono::milliseconds(20), 2, 8);
+    sampler->start();
+    ASSERT_TRUE(sampler->active());
+    ViewProto response;
+    sampler->sample(response);
+    ASSERT_GT(response.nodes_size(), 0);
+
+    sampler->stop();
+    ASSERT_FALSE(sampler->active());
+}
+
+TEST(_EntrySampler_, server) {
+    std::shared_ptr<LoopbackTransport> transport = std::make_shared<LoopbackTransport>();
+    std::shared_ptr<URView> view_server = make_view("entry:0", 8);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view_server);
+    std::shared_ptr<EntrySampler> sampler = std::make_shared<EntrySampler>(view_server, std::chrono::milliseconds(50), 4, 8);
+    server->set_entry_sampler(sampler);
+    ASSERT_EQ(server->entry_sampler(), sampler);
+    sampler->refresh();
+    transport->serve(server);
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("joiner:0", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view_client);
+    client->set_transport(transport);
+
+    ASSERT_TRUE(client->push_pull_view("entry:0").ok());
+    ASSERT_TRUE(view_client->contains("entry:0"));
+    ASSERT_EQ(sampler->offered(), 1);
+    ASSERT_FALSE(view_server->contains("joiner:0"));
+
+    sampler->refresh();
+    ASSERT_TRUE(view_server->contains("joiner:0"));
+}
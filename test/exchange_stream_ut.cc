@@ -0,0 +1,247 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <future>
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include <grpcpp/grpcpp.h>
+
+#include "exchange_stream.h"
+#include "client.h"
+#include "server.h"
+
+using namespace gossip;
+
+namespace {
+
+/* Stands in for a server built before the Exchange stream, the stream is left UNIMPLEMENTED */
+class UnaryOnlyService final : public GossipProtocol::CallbackService {
+    public:
+        ::grpc::ServerUnaryReactor* PushView(::grpc::CallbackServerContext* context, const ViewProto*, ::google::protobuf::Empty*) override {
+            ::grpc::ServerUnaryReactor* reactor = context->DefaultReactor();
+            reactor->Finish(::grpc::Status::OK);
+            return reactor;
+        }
+
+        ::grpc::ServerUnaryReactor* PushPullView(::grpc::CallbackServerContext* context, const ViewProto*, ViewProto* response) override {
+            NodeDescriptorProto* node = response->add_nodes();
+            node->set_address("unaryhost:50114");
+            node->set_age(0);
+            ::grpc::ServerUnaryReactor* reactor = context->DefaultReactor();
+            reactor->Finish(::grpc::Status::OK);
+            return reactor;
+        }
+};
+
+std::shared_ptr<Server::Thread> start_server(const std::string& address, std::shared_ptr<URView>* view_out=nullptr) {
+    std::shared_ptr<URView> view = std::make_shared<URView>(address, 10, 5, 5);
+    view->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view);
+    std::shared_ptr<Server::Thread> server_thread = server->thread();
+    server_thread->start();
+    if (view_out) {
+        *view_out = view;
+    }
+    return server_thread;
+}
+
+std::shared_ptr<ViewProto> make_tx_buf(const std::string& address) {
+    std::shared_ptr<ViewProto> tx_buf = std::make_shared<ViewProto>();
+    NodeDescriptorProto* node = tx_buf->add_nodes();
+    node->set_address(address);
+    node->set_age(0);
+    return tx_buf;
+}
+
+::grpc::Status exchange(ExchangeStreamPool& pool, const std::string& address, ExchangeRequest::Type type,
+                        std::shared_ptr<ViewProto> tx_buf, ViewProto* rx_buf=nullptr) {
+    std::promise<::grpc::Status> done;
+    pool.exchange(address, type, tx_buf, std::chrono::seconds(1), [&done, rx_buf](::grpc::Status status, const ViewProto& view) {
+        if (rx_buf) {
+            *rx_buf = view;
+        }
+        done.set_value(status);
+    });
+    return done.get_future().get();
+}
+
+}
+
+TEST(_ExchangeStreamPool_, construction) {
+    ExchangeStreamPool pool(nullptr, 4);
+    ASSERT_EQ(pool.max_streams(), 4);
+    ASSERT_EQ(pool.size(), 0);
+    ASSERT_FALSE(pool.contains("127.0.0.1:7000"));
+    ASSERT_FALSE(pool.unary_only("127.0.0.1:7000"));
+}
+
+TEST(_ExchangeStreamPool_, push_pull) {
+    std::string address = "0.0.0.0:50070";
+    std::shared_ptr<URView> view_server;
+    std::shared_ptr<Server::Thread> server_thread = start_server(address, &view_server);
+
+    ExchangeStreamPool pool(nullptr, 4);
+    ASSERT_TRUE(exchange(pool, address, ExchangeRequest::PUSH, make_tx_buf("clienthost:50071")).ok());
+    ASSERT_TRUE(view_server->contains("clienthost:50071"));
+
+    ViewProto rx_buf;
+    ASSERT_TRUE(exchange(pool, address, ExchangeRequest::PULL, nullptr, &rx_buf).ok());
+    ASSERT_GT(rx_buf.nodes_size(), 0);
+
+    ASSERT_TRUE(exchange(pool, address, ExchangeRequest::PUSH_PULL, make_tx_buf("clienthost:50072"), &rx_buf).ok());
+    ASSERT_TRUE(view_server->contains("clienthost:50072"));
+
+    // Every exchange rode the one stream
+    ASSERT_EQ(pool.size(), 1);
+    ASSERT_TRUE(pool.contains(address));
+}
+
+TEST(_ExchangeStreamPool_, multiplexed) {
+    std::string address = "0.0.0.0:50073";
+    std::shared_ptr<Server::Thread> server_thread = start_server(address);
+
+    ExchangeStreamPool pool(nullptr, 4);
+    const int num_exchanges = 64;
+    std::vector<std::promise<::grpc::Status>> done(num_exchanges);
+    for (int i = 0; i < num_exchanges; ++i) {
+        std::promise<::grpc::Status>* promise = &done[i];
+        pool.exchange(address, ExchangeRequest::PUSH_PULL, make_tx_buf("clienthost:" + std::to_string(51000 + i)),
+                      std::chrono::seconds(2), [promise](::grpc::Status status, const ViewProto&) {
+            promise->set_value(status);
+        });
+    }
+    for (auto& promise : done) {
+        ASSERT_TRUE(promise.get_future().get().ok());
+    }
+    ASSERT_EQ(pool.size(), 1);
+}
+
+TEST(_ExchangeStreamPool_, lru_eviction) {
+    std::string first = "0.0.0.0:50074";
+    std::string second = "0.0.0.0:50075";
+    std::shared_ptr<Server::Thread> first_thread = start_server(first);
+    std::shared_ptr<Server::Thread> second_thread = start_server(second);
+
+    ExchangeStreamPool pool(nullptr, 1);
+    ASSERT_TRUE(exchange(pool, first, ExchangeRequest::PULL, nullptr).ok());
+    ASSERT_TRUE(exchange(pool, second, ExchangeRequest::PULL, nullptr).ok());
+    ASSERT_EQ(pool.size(), 1);
+    ASSERT_FALSE(pool.contains(first));
+    ASSERT_TRUE(pool.contains(second));
+
+    pool.close(second);
+    ASSERT_EQ(pool.size(), 0);
+}
+
+TEST(_ExchangeStreamPool_, unreachable) {
+    ExchangeStreamPool pool(nullptr, 4);
+    // Nothing listens here, the stream fails and is dropped from the pool
+    ::grpc::Status status = exchange(pool, "127.0.0.1:1", ExchangeRequest::PULL, nullptr);
+    ASSERT_FALSE(status.ok());
+    ASSERT_FALSE(pool.unary_only("127.0.0.1:1"));
+}
+
+TEST(_ExchangeStreamPool_, unary_only) {
+    std::string address = "0.0.0.0:50076";
+    UnaryOnlyService service;
+    ::grpc::ServerBuilder builder;
+    builder.AddListeningPort(address, ::grpc::InsecureServerCredentials());
+    builder.RegisterService(&service);
+    std::unique_ptr<::grpc::Server> server = builder.BuildAndStart();
+    ASSERT_TRUE(server);
+
+    ExchangeStreamPool pool(nullptr, 4);
+    ::grpc::Status status = exchange(pool, address, ExchangeRequest::PUSH, make_tx_buf("clienthost:50077"));
+    ASSERT_EQ(status.error_code(), ::grpc::StatusCode::UNIMPLEMENTED);
+    ASSERT_TRUE(pool.unary_only(address));
+    ASSERT_FALSE(pool.contains(address));
+    server->Shutdown();
+}
+
+TEST(_ClientServer_, stream_exchanges) {
+    std::string address = "0.0.0.0:50078";
+    std::shared_ptr<URView> view_server;
+    std::shared_ptr<Server::Thread> server_thread = start_server(address, &view_server);
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("clienthost:50079", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view_client);
+    std::shared_ptr<ExchangeStreamPool> exchange_streams = std::make_shared<ExchangeStreamPool>(client->channel_pool());
+    client->set_exchange_streams(exchange_streams);
+    ASSERT_EQ(client->exchange_streams(), exchange_streams);
+
+    ASSERT_TRUE(client->push_view(address).ok());
+    ASSERT_TRUE(client->pull_view(address).ok());
+    ASSERT_TRUE(client->push_pull_view(address).ok());
+    ASSERT_TRUE(view_server->contains("clienthost:50079"));
+    ASSERT_TRUE(view_client->contains(address));
+    ASSERT_TRUE(exchange_streams->contains(address));
+    ASSERT_EQ(client->in_flight(), 0);
+}
+
+TEST(_ClientServer_, stream_falls_back_to_unary) {
+    std::string address = "0.0.0.0:50080";
+    UnaryOnlyService service;
+    ::grpc::ServerBuilder builder;
+    builder.AddListeningPort(address, ::grpc::InsecureServerCredentials());
+    builder.RegisterService(&service);
+    std::unique_ptr<::grpc::Server> server = builder.BuildAndStart();
+    ASSERT_TRUE(server);
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("clienthost:50081", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, false, 1, 1, view_client);
+    std::shared_ptr<ExchangeStreamPool> exchange_streams = std::make_shared<ExchangeStreamPool>(client->channel_pool());
+    client->set_exchange_streams(exchange_streams);
+
+    // The first push is refused by the stream and retried unary, later ones go straight to unary
+    ASSERT_TRUE(client->push_view(address).ok());
+    ASSERT_TRUE(exchange_streams->unary_only(address));
+    ASSERT_TRUE(client->push_view(address).ok());
+    ASSERT_FALSE(exchange_streams->contains(address));
+    server->Shutdown();
+}
+
+TEST(_ClientServer_, stream_falls_back_to_unary_push_pull) {
+    std::string address = "0.0.0.0:50115";
+    UnaryOnlyService service;
+    ::grpc::ServerBuilder builder;
+    builder.AddListeningPort(address, ::grpc::InsecureServerCredentials());
+    builder.RegisterService(&service);
+    std::unique_ptr<::grpc::Server> server = builder.BuildAndStart();
+    ASSERT_TRUE(server);
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("clienthost:50116", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view_client);
+    std::shared_ptr<ExchangeStreamPool> exchange_streams = std::make_shared<ExchangeStreamPool>(client->channel_pool());
+    client->set_exchange_streams(exchange_streams);
+
+    // The unary retry's response is merged like a streamed one
+    ASSERT_TRUE(client->push_pull_view(address).ok());
+    ASSERT_TRUE(exchange_streams->unary_only(address));
+    ASSERT_TRUE(view_client->contains("unaryhost:50114"));
+    ASSERT_EQ(client->in_flight(), 0);
+    server->Shutdown();
+}
@@ -0,0 +1,77 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "failure_detector.h"
+
+using namespace gossip;
+
+TEST(_FailureDetector_, construction) {
+    FailureDetector detector(2, 4);
+    ASSERT_EQ(detector.suspect_after(), 2);
+    ASSERT_EQ(detector.evict_after(), 4);
+    ASSERT_EQ(detector.size(), 0);
+    // Can't be evicted before being suspected
+    FailureDetector clamped(3, 1);
+    ASSERT_EQ(clamped.evict_after(), 3);
+}
+
+TEST(_FailureDetector_, states) {
+    FailureDetector detector(2, 3);
+    ASSERT_EQ(detector.state("127.0.0.1:7000"), FailureDetector::State::ALIVE);
+    ASSERT_EQ(detector.record_failure("127.0.0.1:7000"), FailureDetector::State::ALIVE);
+    ASSERT_FALSE(detector.suspected("127.0.0.1:7000"));
+    ASSERT_EQ(detector.record_failure("127.0.0.1:7000"), FailureDetector::State::SUSPECT);
+    ASSERT_TRUE(detector.suspected("127.0.0.1:7000"));
+    ASSERT_EQ(detector.record_failure("127.0.0.1:7000"), FailureDetector::State::DEAD);
+    ASSERT_EQ(detector.failures("127.0.0.1:7000"), 3);
+}
+
+TEST(_FailureDetector_, success_clears) {
+    FailureDetector detector(2, 3);
+    detector.record_failure("127.0.0.1:7000");
+    detector.record_failure("127.0.0.1:7000");
+    ASSERT_TRUE(detector.suspected("127.0.0.1:7000"));
+    detector.record_success("127.0.0.1:7000");
+    ASSERT_EQ(detector.state("127.0.0.1:7000"), FailureDetector::State::ALIVE);
+    ASSERT_EQ(detector.failures("127.0.0.1:7000"), 0);
+    ASSERT_EQ(detector.size(), 0);
+}
+
+TEST(_FailureDetector_, max_peers) {
+    FailureDetector detector(1, 2, 2);
+    detector.record_failure("127.0.0.1:7000");
+    detector.record_failure("127.0.0.1:7001");
+    detector.record_failure("127.0.0.1:7000");
+    detector.record_failure("127.0.0.1:7002");
+    ASSERT_EQ(detector.size(), 2);
+    ASSERT_EQ(detector.failures("127.0.0.1:7001"), 0);
+    detector.forget("127.0.0.1:7000");
+    ASSERT_EQ(detector.failures("127.0.0.1:7000"), 0);
+}
+
+TEST(_FailureDetector_, print) {
+    FailureDetector detector;
+    detector.record_failure("127.0.0.1:7000");
+    std::cout << detector << std::endl;
+}
@@ -0,0 +1,160 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <string>
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include <grpcpp/grpcpp.h>
+
+#include "local_channels.h"
+#include "channel_pool.h"
+#include "client.h"
+#include "server.h"
+#include "peer_sampling_service.h"
+
+using namespace gossip;
+
+namespace {
+
+std::shared_ptr<Server> make_server(const std::string& address, const std::string& local_address="") {
+    std::shared_ptr<URView> view = std::make_shared<URView>(address, 10, 5, 5);
+    view->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Server> server = std::make_shared<Server>(view);
+    server->set_local_address(local_address);
+    return server;
+}
+
+std::shared_ptr<Client> make_client(const std::string& address, std::shared_ptr<ChannelPool> channel_pool,
+                                    std::shared_ptr<URView>* view_out=nullptr) {
+    std::shared_ptr<URView> view = std::make_shared<URView>(address, 10, 5, 5);
+    view->init_selector(SelectorType::TAIL);
+    if (view_out) {
+        *view_out = view;
+    }
+    return std::make_shared<Client>(true, true, 1, 1, view, channel_pool);
+}
+
+}
+
+TEST(_LocalChannels_, routes) {
+    LocalChannels local_channels;
+    ASSERT_EQ(local_channels.route("peerhost:7000"), "peerhost:7000");
+
+    local_channels.add_route("peerhost:7000", "unix:///tmp/peerhost_7000.sock");
+    ASSERT_EQ(local_channels.route("peerhost:7000"), "unix:///tmp/peerhost_7000.sock");
+    ASSERT_EQ(local_channels.num_routes(), 1);
+
+    local_channels.remove_route("peerhost:7000");
+    ASSERT_EQ(local_channels.route("peerhost:7000"), "peerhost:7000");
+    ASSERT_EQ(local_channels.num_routes(), 0);
+}
+
+TEST(_LocalChannels_, servers) {
+    LocalChannels local_channels;
+    uint64_t id = 0;
+    ASSERT_EQ(local_channels.in_process_channel("0.0.0.0:50100", id), nullptr);
+    ASSERT_EQ(id, 0);
+
+    // Never dereferenced, only a server that is listed can be reached
+    ::grpc::Server* server = nullptr;
+    uint64_t first = local_channels.add_server("0.0.0.0:50100", server);
+    ASSERT_TRUE(local_channels.hosts("0.0.0.0:50100", first));
+
+    // A restarted server replaces the listing, removing the stale one leaves it be
+    uint64_t second = local_channels.add_server("0.0.0.0:50100", server);
+    ASSERT_NE(first, second);
+    ASSERT_FALSE(local_channels.hosts("0.0.0.0:50100", first));
+    local_channels.remove_server("0.0.0.0:50100", first);
+    ASSERT_TRUE(local_channels.hosts("0.0.0.0:50100", second));
+
+    local_channels.remove_server("0.0.0.0:50100", second);
+    ASSERT_EQ(local_channels.num_servers(), 0);
+}
+
+TEST(_ChannelPool_, in_process) {
+    std::string address = "0.0.0.0:50101";
+    std::shared_ptr<Server> server = make_server(address);
+    std::shared_ptr<Server::Thread> server_thread = server->thread();
+    server_thread->start();
+
+    std::shared_ptr<ChannelPool> channel_pool = std::make_shared<ChannelPool>(4, std::chrono::seconds(60));
+    channel_pool->set_in_process(true);
+    ASSERT_TRUE(channel_pool->in_process());
+
+    std::shared_ptr<URView> view_client;
+    std::shared_ptr<Client> client = make_client("clienthost:50102", channel_pool, &view_client);
+    ASSERT_TRUE(client->push_pull_view(address).ok());
+    ASSERT_TRUE(server->view()->contains("clienthost:50102"));
+    ASSERT_TRUE(view_client->contains(address));
+    ASSERT_TRUE(channel_pool->contains(address));
+
+    // Once the server stops the in-process channel is dropped rather than reused
+    server_thread->stop();
+    ASSERT_FALSE(client->pull_view(address).ok());
+}
+
+TEST(_ChannelPool_, unix_socket_route) {
+    std::string address = "127.0.0.1:50103";
+    std::string local_address = "unix:///tmp/gossip_ut_50103.sock";
+    std::shared_ptr<Server> server = make_server(address, local_address);
+    std::shared_ptr<Server::Thread> server_thread = server->thread();
+    server_thread->start();
+
+    // Nothing listens on the advertised address, only the route can reach the server
+    std::string advertised = "127.0.0.1:50104";
+    LocalChannels::global().add_route(advertised, local_address);
+
+    std::shared_ptr<ChannelPool> channel_pool = std::make_shared<ChannelPool>(4, std::chrono::seconds(60));
+    std::shared_ptr<Client> client = make_client("clienthost:50105", channel_pool);
+    ASSERT_TRUE(client->push_view(advertised).ok());
+    ASSERT_TRUE(server->view()->contains("clienthost:50105"));
+
+    // The socket itself is reachable without a route too
+    ASSERT_TRUE(client->pull_view(local_address).ok());
+
+    LocalChannels::global().remove_route(advertised);
+    server_thread->stop();
+}
+
+TEST(_LocalChannels_, peer_sampling_service) {
+    std::string address = "127.0.0.1:50106";
+    std::string local_address = "unix:///tmp/gossip_ut_50106.sock";
+    std::shared_ptr<URView> view_server = std::make_shared<URView>(address, 10, 5, 5);
+    view_server->init_selector(SelectorType::TAIL);
+    std::shared_ptr<PeerSamplingService> server = std::make_shared<PeerSamplingService>(true, true, 1, 1, std::vector<std::string>(), view_server);
+    server->set_local_address(local_address);
+    ASSERT_EQ(server->local_address(), local_address);
+    server->start_server();
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("127.0.0.1:50107", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<ChannelPool> channel_pool = std::make_shared<ChannelPool>(4, std::chrono::seconds(60));
+    std::shared_ptr<PeerSamplingService> client = std::make_shared<PeerSamplingService>(true, true, 1, 1, std::vector<std::string>{address}, view_client, channel_pool);
+    client->add_local_route(address, local_address);
+    ASSERT_EQ(LocalChannels::global().route(address), local_address);
+    ASSERT_TRUE(client->enter());
+    ASSERT_TRUE(view_client->contains(address));
+
+    client->remove_local_route(address);
+    ASSERT_EQ(LocalChannels::global().route(address), address);
+    server->stop_server();
+}
@@ -0,0 +1,155 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "loopback_transport.h"
+#include "client.h"
+#include "server.h"
+#include "peer_sampling_service.h"
+
+using namespace gossip;
+
+namespace {
+
+std::shared_ptr<Server> make_server(const std::string& address) {
+    std::shared_ptr<URView> view = std::make_shared<URView>(address, 10, 5, 5);
+    view->init_selector(SelectorType::TAIL);
+    return std::make_shared<Server>(view);
+}
+
+}
+
+TEST(_LoopbackTransport_, serve_unserve) {
+    LoopbackTransport transport;
+    std::shared_ptr<Server> server = make_server("node:0");
+    ASSERT_TRUE(transport.serve(server));
+    ASSERT_FALSE(transport.serve(make_server("node:0")));
+    ASSERT_TRUE(transport.serving("node:0"));
+    ASSERT_EQ(transport.size(), 1);
+
+    transport.unserve("node:0");
+    ASSERT_FALSE(transport.serving("node:0"));
+    ASSERT_EQ(transport.size(), 0);
+}
+
+TEST(_LoopbackTransport_, exchange) {
+    LoopbackTransport transport;
+    std::shared_ptr<Server> server = make_server("node:0");
+    transport.serve(server);
+
+    std::shared_ptr<ViewProto> tx_buf = std::make_shared<ViewProto>();
+    NodeDescriptorProto* node = tx_buf->add_nodes();
+    node->set_address("node:1");
+    node->set_age(0);
+
+    ::grpc::Status result;
+    ViewProto rx_buf;
+    auto done = [&result, &rx_buf](::grpc::Status status, const ViewProto& view) {
+        result = status;
+        rx_buf = view;
+    };
+
+    // Completes before exchange returns
+    transport.exchange("node:0", ExchangeRequest::PUSH, tx_buf, std::chrono::seconds(1), done);
+    ASSERT_TRUE(result.ok());
+    ASSERT_EQ(rx_buf.nodes_size(), 0);
+    ASSERT_TRUE(server->view()->contains("node:1"));
+
+    transport.exchange("node:0", ExchangeRequest::PULL, nullptr, std::chrono::seconds(1), done);
+    ASSERT_TRUE(result.ok());
+    ASSERT_GT(rx_buf.nodes_size(), 0);
+    ASSERT_EQ(rx_buf.nodes(0).address(), "node:0");
+    ASSERT_EQ(transport.exchanges(), 2);
+
+    transport.exchange("node:2", ExchangeRequest::PULL, nullptr, std::chrono::seconds(1), done);
+    ASSERT_EQ(result.error_code(), ::grpc::StatusCode::UNAVAILABLE);
+    ASSERT_EQ(transport.exchanges(), 2);
+}
+
+TEST(_LoopbackTransport_, client) {
+    std::shared_ptr<LoopbackTransport> transport = std::make_shared<LoopbackTransport>();
+    std::shared_ptr<Server> server = make_server("node:0");
+    transport->serve(server);
+
+    std::shared_ptr<URView> view_client = std::make_shared<URView>("node:1", 10, 5, 5);
+    view_client->init_selector(SelectorType::TAIL);
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view_client);
+    client->set_transport(transport);
+    ASSERT_EQ(client->transport(), transport);
+
+    ASSERT_TRUE(client->push_view("node:0").ok());
+    ASSERT_TRUE(client->pull_view("node:0").ok());
+    ASSERT_TRUE(client->push_pull_view("node:0").ok());
+    ASSERT_TRUE(server->view()->contains("node:1"));
+    ASSERT_TRUE(view_client->contains("node:0"));
+    ASSERT_EQ(client->in_flight(), 0);
+
+    ASSERT_EQ(client->push_view("node:2").error_code(), ::grpc::StatusCode::UNAVAILABLE);
+}
+
+TEST(_LoopbackTransport_, network) {
+    const int num_nodes = 1000;
+    std::shared_ptr<LoopbackTransport> transport = std::make_shared<LoopbackTransport>();
+    std::vector<std::shared_ptr<PeerSamplingService>> nodes;
+    for (int i = 0; i < num_nodes; ++i) {
+        std::vector<std::string> entry_points;
+        if (i > 0) {
+            entry_points.push_back("node:0");
+        }
+        std::shared_ptr<URView> view = std::make_shared<URView>("node:" + std::to_string(i), 10, 5, 5);
+        view->init_selector(SelectorType::UNIFORM_RANDOM);
+        std::shared_ptr<PeerSamplingService> node = std::make_shared<PeerSamplingService>(true, true, 1, 1, entry_points, view);
+        node->set_transport(transport);
+        node->start_server();
+        ASSERT_TRUE(node->enter());
+        nodes.push_back(node);
+    }
+    ASSERT_EQ(transport->size(), num_nodes);
+
+    // Drive the rounds by hand through a client per node, a few are enough to spread every node beyond the entry point
+    std::vector<std::shared_ptr<Client>> clients;
+    for (auto& node : nodes) {
+        clients.push_back(std::make_shared<Client>(true, true, 1, 1, node->view()));
+        clients.back()->set_transport(transport);
+    }
+    for (int round = 0; round < 5; ++round) {
+        for (auto& client : clients) {
+            ASSERT_TRUE(client->push_pull_view().ok());
+        }
+    }
+    int knows_others = 0;
+    for (auto& node : nodes) {
+        std::shared_ptr<NodeDescriptor> peer = node->view()->select_peer();
+        if (peer && peer->address() != "node:0") {
+            knows_others++;
+        }
+    }
+    ASSERT_GT(knows_others, 0);
+
+    nodes.front()->stop_server();
+    ASSERT_FALSE(transport->serving("node:0"));
+    nodes.clear();
+    ASSERT_EQ(transport->size(), 0);
+}
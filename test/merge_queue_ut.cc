@@ -0,0 +1,153 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "merge_queue.h"
+#include "loopback_transport.h"
+#include "client.h"
+#include "server.h"
+
+using namespace gossip;
+
+namespace {
+
+std::shared_ptr<URView> make_view(const std::string& address, int size=10) {
+    std::shared_ptr<URView> view = std::make_shared<URView>(address, size, 5, 5);
+    view->init_selector(SelectorType::TAIL);
+    return view;
+}
+
+ViewProto make_push(const std::string& address, int age=0) {
+    ViewProto view;
+    NodeDescriptorProto* node = view.add_nodes();
+    node->set_address(address);
+    node->set_age(age);
+    return view;
+}
+
+}
+
+TEST(_MergeQueue_, construction) {
+    MergeQueue merge_queue(make_view("node:0"), 8, std::chrono::microseconds(500), 16);
+    ASSERT_EQ(merge_queue.batch_size(), 8);
+    ASSERT_EQ(merge_queue.max_delay(), std::chrono::microseconds(500));
+    ASSERT_EQ(merge_queue.max_pending(), 16);
+    ASSERT_EQ(merge_queue.pending(), 0);
+}
+
+TEST(_MergeQueue_, flush) {
+    std::shared_ptr<URView> view = make_view("node:0");
+    // Held long enough that only flush() merges
+    MergeQueue merge_queue(view, 64, std::chrono::seconds(10));
+    ASSERT_TRUE(merge_queue.push(make_push("node:1")));
+    ASSERT_TRUE(merge_queue.push(make_push("node:2")));
+    ASSERT_EQ(merge_queue.pending(), 2);
+    ASSERT_FALSE(view->contains("node:1"));
+
+    merge_queue.flush();
+    ASSERT_EQ(merge_queue.pending(), 0);
+    ASSERT_TRUE(view->contains("node:1"));
+    ASSERT_TRUE(view->contains("node:2"));
+    ASSERT_EQ(merge_queue.merged(), 2);
+    ASSERT_EQ(merge_queue.batches(), 1);
+}
+
+TEST(_MergeQueue_, max_delay) {
+    std::shared_ptr<URView> view = make_view("node:0");
+    MergeQueue merge_queue(view, 64, std::chrono::microseconds(1000));
+    merge_queue.push(make_push("node:1"));
+    // One push never fills the batch, it is merged once max_delay is up
+    for (int i = 0; i < 100 && merge_queue.merged() == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(view->contains("node:1"));
+}
+
+TEST(_MergeQueue_, full_batch) {
+    std::shared_ptr<URView> view = make_view("node:0", 100);
+    MergeQueue merge_queue(view, 4, std::chrono::seconds(10));
+    for (int i = 1; i <= 4; ++i) {
+        merge_queue.push(make_push("node:" + std::to_string(i)));
+    }
+    // A full batch doesn't wait out max_delay
+    for (int i = 0; i < 100 && merge_queue.batches() == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(merge_queue.batches(), 1);
+    ASSERT_EQ(merge_queue.merged(), 4);
+}
+
+TEST(_MergeQueue_, max_pending) {
+    std::shared_ptr<URView> view = make_view("node:0");
+    MergeQueue merge_queue(view, 64, std::chrono::seconds(10), 2);
+    ASSERT_TRUE(merge_queue.push(make_push("node:1")));
+    ASSERT_TRUE(merge_queue.push(make_push("node:2")));
+    ASSERT_FALSE(merge_queue.push(make_push("node:3")));
+    ASSERT_EQ(merge_queue.dropped(), 1);
+    ASSERT_EQ(merge_queue.pending(), 2);
+}
+
+TEST(_MergeQueue_, concurrent) {
+    std::shared_ptr<URView> view = make_view("node:0", 1000);
+    std::shared_ptr<MergeQueue> merge_queue = std::make_shared<MergeQueue>(view, 32, std::chrono::microseconds(500));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([merge_queue, t]() {
+            for (int i = 0; i < 100; ++i) {
+                merge_queue->push(make_push("node:" + std::to_string(1 + t * 100 + i)));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    merge_queue->flush();
+    ASSERT_EQ(merge_queue->merged(), 800);
+    ASSERT_EQ(merge_queue->pending(), 0);
+    ASSERT_LT(merge_queue->batches(), 800);
+    ASSERT_TRUE(view->contains("node:1"));
+    ASSERT_TRUE(view->contains("node:800"));
+}
+
+TEST(_MergeQueue_, server) {
+    std::shared_ptr<LoopbackTransport> transport = std::make_shared<LoopbackTransport>();
+    std::shared_ptr<URView> view_server = make_view("node:0");
+    std::shared_ptr<Server> server = std::make_shared<Server>(view_server);
+    std::shared_ptr<MergeQueue> merge_queue = std::make_shared<MergeQueue>(view_server, 64, std::chrono::seconds(10));
+    server->set_merge_queue(merge_queue);
+    ASSERT_EQ(server->merge_queue(), merge_queue);
+    transport->serve(server);
+
+    std::shared_ptr<URView> view_client = make_view("node:1");
+    std::shared_ptr<Client> client = std::make_shared<Client>(true, true, 1, 1, view_client);
+    client->set_transport(transport);
+
+    ASSERT_TRUE(client->push_pull_view("node:0").ok());
+    ASSERT_TRUE(view_client->contains("node:0"));
+    ASSERT_EQ(merge_queue->pending(), 1);
+    merge_queue->flush();
+    ASSERT_TRUE(view_server->contains("node:1"));
+}
@@ -19,6 +19,8 @@
 
 
 #include <string>
+#include <memory>
+#include <atomic>
 #include <stdint.h>
 
 #include <gtest/gtest.h>
@@ -62,6 +64,29 @@ TEST(_NodeDescriptor_, to_proto) {
     ASSERT_EQ(test_proto.age(), age);
 }
 
+TEST(_NodeDescriptor_, attach) {
+    std::shared_ptr<std::atomic<uint32_t>> clock = std::make_shared<std::atomic<uint32_t>>(UINT32_MAX - 1);
+    NodeDescriptor test("192.168.225.1:5012", 3);
+    test.attach(clock);
+    ASSERT_EQ(test.age(), 3);
+
+    // Ages with the clock, through its wrap around
+    clock->fetch_add(2);
+    ASSERT_EQ(test.age(), 5);
+    test.set_age(1);
+    ASSERT_EQ(test.age(), 1);
+    clock->fetch_add(1);
+
+    ::gossip::NodeDescriptorProto test_proto;
+    test.make_proto(&test_proto);
+    ASSERT_EQ(test_proto.age(), 2);
+
+    test.detach();
+    clock->fetch_add(1);
+    ASSERT_FALSE(test.attached());
+    ASSERT_EQ(test.age(), 2);
+}
+
 TEST(_NodeDescriptor_, print) {
     std::string address = "192.168.225.1:5012";
     uint32_t age = 0;
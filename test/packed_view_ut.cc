@@ -0,0 +1,249 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_set>
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include <packed_view.h>
+
+using namespace gossip;
+
+struct _PackedView_ : public ::testing::Test {
+    const std::string ip = "192.168.225.1";
+    const std::string port = "5012";
+    const std::string my_address = ip + ":" + port;
+    const int size = 10;
+    const int healing = 5;
+    const int swap = 5;
+
+    std::shared_ptr<PackedView> packed_view(SelectorType type, std::shared_ptr<TSLog> log=nullptr) {
+        auto view = std::make_shared<PackedView>(my_address, size, healing, swap);
+        view->init_selector(type, log);
+        return view;
+    }
+
+    std::vector<std::shared_ptr<NodeDescriptor>> vector_of_nodes(int num_nodes, int first=0) {
+        std::vector<std::shared_ptr<NodeDescriptor>> nodes;
+        for (int i = first; i < first + num_nodes; ++i) {
+            nodes.push_back(std::make_shared<NodeDescriptor>(ip + ":" + std::to_string((std::stoi(port) + i + 1)), i));
+        }
+        return nodes;
+    }
+};
+
+TEST_F(_PackedView_, select_empty_view) {
+    std::shared_ptr<VectorLog> log = std::make_shared<VectorLog>();
+    for (SelectorType type : {SelectorType::TAIL, SelectorType::UNIFORM_RANDOM, SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT,
+                              SelectorType::LOGGED_TAIL, SelectorType::LOGGED_UNIFORM_RANDOM,
+                              SelectorType::LOGGED_UNIFORM_RANDOM_NO_REPLACEMENT}) {
+        std::shared_ptr<PackedView> test_view = packed_view(type, log);
+        ASSERT_EQ(test_view->select_peer(), nullptr);
+    }
+    ASSERT_EQ(log->data_copy().size(), 3);
+}
+
+TEST_F(_PackedView_, rx_nodes_contains) {
+    std::shared_ptr<PackedView> test_view = packed_view(SelectorType::UNIFORM_RANDOM);
+    std::vector<std::shared_ptr<NodeDescriptor>> rx_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(rx_nodes);
+    ASSERT_EQ(test_view->max_size(), size);
+    for (auto& node : rx_nodes) {
+        ASSERT_TRUE(test_view->contains(node->address()));
+    }
+    ASSERT_TRUE(test_view->contains(my_address));
+    // Self is never taken into the view
+    std::vector<std::shared_ptr<NodeDescriptor>> self{std::make_shared<NodeDescriptor>(my_address, 0)};
+    test_view->rx_nodes(self);
+    ASSERT_EQ(test_view->max_size(), size);
+}
+
+TEST_F(_PackedView_, rx_nodes_keeps_youngest_age) {
+    std::shared_ptr<PackedView> test_view = packed_view(SelectorType::TAIL);
+    std::vector<std::shared_ptr<NodeDescriptor>> older{std::make_shared<NodeDescriptor>("node:1", 7)};
+    std::vector<std::shared_ptr<NodeDescriptor>> younger{std::make_shared<NodeDescriptor>("node:1", 2)};
+    test_view->rx_nodes(older);
+    test_view->rx_nodes(younger);
+    test_view->rx_nodes(older);
+    ASSERT_EQ(test_view->max_size(), 1);
+    ASSERT_EQ(test_view->select_peer()->age(), 2);
+}
+
+TEST_F(_PackedView_, evictions_release_ids) {
+    std::shared_ptr<PackedView> test_view = packed_view(SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT);
+    std::unordered_set<std::string> seen;
+    for (int round = 0; round < 100; ++round) {
+        std::vector<std::shared_ptr<NodeDescriptor>> rx_nodes = vector_of_nodes(size / 2, round * size);
+        test_view->rx_nodes(rx_nodes);
+        test_view->increment_age();
+        for (auto& node : rx_nodes) {
+            seen.insert(node->address());
+        }
+        ASSERT_LE(test_view->max_size(), size);
+    }
+    int contained = 0;
+    for (auto& address : seen) {
+        contained += test_view->contains(address);
+    }
+    // Evicted addresses are forgotten and their ids reused, so neither grows with churn
+    ASSERT_EQ(contained, test_view->max_size());
+    ASSERT_LE(test_view->num_ids(), 1 + size + size / 2);
+}
+
+TEST_F(_PackedView_, healing_evicts_oldest) {
+    auto test_view = std::make_shared<PackedView>(my_address, size, size, 0);
+    test_view->init_selector(SelectorType::UNIFORM_RANDOM);
+    std::vector<std::shared_ptr<NodeDescriptor>> old_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(old_nodes);
+    for (int i = 0; i < 100; ++i) {
+        test_view->increment_age();
+    }
+    std::vector<std::shared_ptr<NodeDescriptor>> new_nodes = vector_of_nodes(size / 2, size);
+    test_view->rx_nodes(new_nodes);
+    ASSERT_EQ(test_view->max_size(), size);
+    for (auto& node : new_nodes) {
+        ASSERT_TRUE(test_view->contains(node->address()));
+    }
+    // The oldest half went, the youngest of the old nodes stayed
+    for (int i = 0; i < size / 2; ++i) {
+        ASSERT_TRUE(test_view->contains(old_nodes[i]->address()));
+        ASSERT_FALSE(test_view->contains(old_nodes[size / 2 + i]->address()));
+    }
+}
+
+TEST_F(_PackedView_, tx_nodes) {
+    std::shared_ptr<PackedView> test_view = packed_view(SelectorType::UNIFORM_RANDOM);
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(dummy_nodes);
+    std::vector<std::shared_ptr<NodeDescriptor>> tx_nodes = test_view->tx_nodes();
+    ASSERT_EQ(tx_nodes.size(), size / 2);
+    ASSERT_EQ(tx_nodes[0]->address(), my_address);
+    std::unordered_set<std::string> sent;
+    for (auto& node : tx_nodes) {
+        // The healing oldest are held back
+        ASSERT_LT(node->age(), size / 2);
+        ASSERT_TRUE(sent.insert(node->address()).second);
+    }
+}
+
+TEST_F(_PackedView_, selector_full_urnr) {
+    std::shared_ptr<PackedView> test_view = packed_view(SelectorType::TAIL);
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(dummy_nodes);
+    auto selector = test_view->create_subscriber(SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT);
+    std::unordered_set<std::string> returned;
+    for (int i = 0; i < size; ++i) {
+        std::shared_ptr<NodeDescriptor> selected = selector->select_peer();
+        ASSERT_TRUE(returned.insert(selected->address()).second) << "Failed peer :" << *selected << std::endl;
+    }
+    ASSERT_TRUE(test_view->contains(selector->select_peer()->address()));
+}
+
+TEST_F(_PackedView_, selector_urnr_skips_removed) {
+    std::shared_ptr<PackedView> test_view = packed_view(SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT);
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(dummy_nodes);
+    for (int i = 0; i < size / 2; ++i) {
+        ASSERT_TRUE(test_view->remove(dummy_nodes[i]->address()));
+    }
+    for (int i = 0; i < size / 2; ++i) {
+        ASSERT_TRUE(test_view->contains(test_view->select_peer()->address()));
+    }
+}
+
+TEST_F(_PackedView_, select_peers) {
+    std::shared_ptr<VectorLog> log = std::make_shared<VectorLog>();
+    std::vector<std::shared_ptr<NodeDescriptor>> selected;
+    for (SelectorType type : {SelectorType::TAIL, SelectorType::UNIFORM_RANDOM, SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT,
+                              SelectorType::LOGGED_TAIL, SelectorType::LOGGED_UNIFORM_RANDOM,
+                              SelectorType::LOGGED_UNIFORM_RANDOM_NO_REPLACEMENT}) {
+        std::shared_ptr<PackedView> test_view = packed_view(type, log);
+        ASSERT_EQ(test_view->select_peers(3, selected), 0);
+        std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
+        test_view->rx_nodes(dummy_nodes);
+        for (int k : {1, size / 2, size, 2 * size}) {
+            ASSERT_EQ(test_view->select_peers(k, selected), static_cast<std::size_t>(std::min(k, size)));
+            std::unordered_set<std::string> returned;
+            for (auto& node : selected) {
+                ASSERT_TRUE(test_view->contains(node->address()));
+                ASSERT_TRUE(returned.insert(node->address()).second) << "Repeated peer: " << *node << std::endl;
+            }
+        }
+    }
+    ASSERT_EQ(log->data_copy().size(), 3 * (1 + 1 + size / 2 + size + size));
+}
+
+TEST_F(_PackedView_, select_peers_urnr) {
+    std::shared_ptr<PackedView> test_view = packed_view(SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT);
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(dummy_nodes);
+    std::vector<std::shared_ptr<NodeDescriptor>> selected;
+    std::unordered_set<std::string> returned;
+    for (int i = 0; i < size / 3; ++i) {
+        ASSERT_EQ(test_view->select_peers(3, selected), 3);
+        for (auto& node : selected) {
+            ASSERT_TRUE(returned.insert(node->address()).second) << "Failed peer :" << *node << std::endl;
+        }
+    }
+    // The last unselected peer first, the rest of the batch distinct from it
+    ASSERT_EQ(test_view->select_peers(3, selected), 3);
+    ASSERT_EQ(returned.count(selected[0]->address()), 0);
+    std::unordered_set<std::string> batch;
+    for (auto& node : selected) {
+        ASSERT_TRUE(batch.insert(node->address()).second);
+    }
+}
+
+TEST_F(_PackedView_, increment_age) {
+    std::shared_ptr<PackedView> test_view = packed_view(SelectorType::TAIL);
+    std::vector<std::shared_ptr<NodeDescriptor>> merged{std::make_shared<NodeDescriptor>("node:1", 3)};
+    test_view->rx_nodes(merged);
+    test_view->increment_age();
+    ASSERT_EQ(test_view->select_peer()->age(), 4);
+    test_view->merge(merged);
+    ASSERT_EQ(test_view->select_peer()->age(), 4);
+    // Descriptors handed in are copied, not aged in place
+    ASSERT_EQ(merged[0]->age(), 3);
+}
+
+TEST_F(_PackedView_, remove) {
+    std::shared_ptr<PackedView> test_view = packed_view(SelectorType::TAIL);
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(dummy_nodes);
+
+    std::string removed = test_view->select_peer()->address();
+    ASSERT_TRUE(test_view->remove(removed));
+    ASSERT_FALSE(test_view->contains(removed));
+    ASSERT_NE(test_view->select_peer()->address(), removed);
+    ASSERT_FALSE(test_view->remove(removed));
+    // Never removes itself
+    ASSERT_FALSE(test_view->remove(my_address));
+    ASSERT_TRUE(test_view->contains(my_address));
+}
+
+TEST_F(_PackedView_, print) {
+    std::shared_ptr<PackedView> test_view = packed_view(SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT);
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(2);
+    test_view->rx_nodes(dummy_nodes);
+    std::cout << *test_view << std::endl;
+}
@@ -255,4 +255,56 @@ TEST_F(_PeerSamplingService_, logged_lan) {
 
 
     std::this_thread::sleep_for(std::chrono::seconds(2));
-}
\ No newline at end of file
+}
+
+TEST_F(_PeerSamplingService_, enter_parallel) {
+    std::vector<std::string> entry_points0;
+    std::string address0 = "0.0.0.0:50055";
+    std::shared_ptr<URView> view0 = std::make_shared<URView>(address0, size, healing, swap);
+    view0->init_selector(SelectorType::TAIL);
+    PeerSamplingService peer_sampling_service0(push, pull, wait_time, timeout, entry_points0, view0);
+    peer_sampling_service0.start_server();
+
+    // The unroutable entry point is listed first, it must not hold up entering through the live one
+    std::vector<std::string> entry_points1 = {"192.168.225.1:7000", address0};
+    std::shared_ptr<URView> view1 = std::make_shared<URView>("0.0.0.0:50056", size, healing, swap);
+    view1->init_selector(SelectorType::TAIL);
+    PeerSamplingService peer_sampling_service1(push, pull, wait_time, timeout, entry_points1, view1);
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(peer_sampling_service1.enter());
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(timeout * 1000 / 2));
+    ASSERT_TRUE(view1->contains(address0));
+}
+
+TEST_F(_PeerSamplingService_, enter_past_max_in_flight) {
+    std::vector<std::string> entry_points0;
+    std::string address0 = "0.0.0.0:50058";
+    std::shared_ptr<URView> view0 = std::make_shared<URView>(address0, size, healing, swap);
+    view0->init_selector(SelectorType::TAIL);
+    PeerSamplingService peer_sampling_service0(push, pull, wait_time, timeout, entry_points0, view0);
+    peer_sampling_service0.start_server();
+
+    // More entry points than may be in flight, the live one is last and must still be tried
+    std::vector<std::string> entry_points1 = {"127.0.0.1:1", "127.0.0.1:2", "127.0.0.1:3", address0};
+    std::shared_ptr<URView> view1 = std::make_shared<URView>("0.0.0.0:50059", size, healing, swap);
+    view1->init_selector(SelectorType::TAIL);
+    PeerSamplingService peer_sampling_service1(push, pull, wait_time, timeout, entry_points1, view1);
+    peer_sampling_service1.set_max_in_flight(1);
+    ASSERT_EQ(peer_sampling_service1.max_in_flight(), 1);
+
+    ASSERT_TRUE(peer_sampling_service1.enter());
+    ASSERT_TRUE(view1->contains(address0));
+}
+
+TEST_F(_PeerSamplingService_, enter_all_fail) {
+    std::vector<std::string> entry_points = {"127.0.0.1:1", "127.0.0.1:2", "127.0.0.1:3"};
+    std::shared_ptr<URView> view = std::make_shared<URView>("0.0.0.0:50057", size, healing, swap);
+    view->init_selector(SelectorType::TAIL);
+    PeerSamplingService peer_sampling_service(push, pull, wait_time, timeout, entry_points, view);
+    peer_sampling_service.set_entry_fanout(2);
+    ASSERT_EQ(peer_sampling_service.entry_fanout(), 2);
+
+    ASSERT_FALSE(peer_sampling_service.enter());
+    ASSERT_FALSE(peer_sampling_service.entered());
+}
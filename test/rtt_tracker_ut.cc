@@ -0,0 +1,113 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <string>
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "rtt_tracker.h"
+
+using namespace gossip;
+
+TEST(_RttTracker_, construction) {
+    RttTracker tracker(std::chrono::milliseconds(10), std::chrono::milliseconds(1000));
+    ASSERT_EQ(tracker.min_timeout(), std::chrono::milliseconds(10));
+    ASSERT_EQ(tracker.max_timeout(), std::chrono::milliseconds(1000));
+    ASSERT_EQ(tracker.size(), 0);
+}
+
+TEST(_RttTracker_, unknown_peer) {
+    RttTracker tracker(std::chrono::milliseconds(10), std::chrono::milliseconds(1000));
+    ASSERT_EQ(tracker.timeout("127.0.0.1:7000"), std::chrono::milliseconds(1000));
+    ASSERT_EQ(tracker.srtt("127.0.0.1:7000"), std::chrono::microseconds(0));
+    // Timeouts on a peer never measured aren't tracked
+    tracker.record_timeout("127.0.0.1:7000");
+    ASSERT_FALSE(tracker.contains("127.0.0.1:7000"));
+}
+
+TEST(_RttTracker_, steady_rtt) {
+    RttTracker tracker(std::chrono::milliseconds(1), std::chrono::milliseconds(1000));
+    for (int i = 0; i < 50; ++i) {
+        tracker.record("127.0.0.1:7000", std::chrono::milliseconds(20));
+    }
+    ASSERT_EQ(tracker.srtt("127.0.0.1:7000"), std::chrono::milliseconds(20));
+    ASSERT_EQ(tracker.percentile_rtt("127.0.0.1:7000"), std::chrono::milliseconds(20));
+    // Variance has decayed away, the deadline sits just above the round trip
+    ASSERT_GE(tracker.timeout("127.0.0.1:7000"), std::chrono::milliseconds(20));
+    ASSERT_LE(tracker.timeout("127.0.0.1:7000"), std::chrono::milliseconds(25));
+}
+
+TEST(_RttTracker_, percentile_covers_outliers) {
+    RttTracker tracker(std::chrono::milliseconds(1), std::chrono::milliseconds(1000));
+    for (int i = 0; i < 31; ++i) {
+        tracker.record("127.0.0.1:7000", std::chrono::milliseconds(10));
+    }
+    tracker.record("127.0.0.1:7000", std::chrono::milliseconds(200));
+    for (int i = 0; i < 20; ++i) {
+        tracker.record("127.0.0.1:7000", std::chrono::milliseconds(10));
+    }
+    // The smoothed estimate has forgotten the spike but it is still in the window
+    ASSERT_LT(tracker.srtt("127.0.0.1:7000"), std::chrono::milliseconds(15));
+    ASSERT_EQ(tracker.percentile_rtt("127.0.0.1:7000"), std::chrono::milliseconds(200));
+    ASSERT_GE(tracker.timeout("127.0.0.1:7000"), std::chrono::milliseconds(200));
+}
+
+TEST(_RttTracker_, clamped) {
+    RttTracker tracker(std::chrono::milliseconds(50), std::chrono::milliseconds(100));
+    tracker.record("127.0.0.1:7000", std::chrono::milliseconds(1));
+    ASSERT_EQ(tracker.timeout("127.0.0.1:7000"), std::chrono::milliseconds(50));
+    tracker.record("127.0.0.1:7001", std::chrono::milliseconds(500));
+    ASSERT_EQ(tracker.timeout("127.0.0.1:7001"), std::chrono::milliseconds(100));
+}
+
+TEST(_RttTracker_, backoff) {
+    RttTracker tracker(std::chrono::milliseconds(1), std::chrono::milliseconds(10000));
+    for (int i = 0; i < 50; ++i) {
+        tracker.record("127.0.0.1:7000", std::chrono::milliseconds(20));
+    }
+    std::chrono::milliseconds base = tracker.timeout("127.0.0.1:7000");
+    tracker.record_timeout("127.0.0.1:7000");
+    ASSERT_GE(tracker.timeout("127.0.0.1:7000"), 2 * (base - std::chrono::milliseconds(1)));
+    tracker.record_timeout("127.0.0.1:7000");
+    ASSERT_GE(tracker.timeout("127.0.0.1:7000"), 4 * (base - std::chrono::milliseconds(1)));
+    // One success resets it
+    tracker.record("127.0.0.1:7000", std::chrono::milliseconds(20));
+    ASSERT_LE(tracker.timeout("127.0.0.1:7000"), base + std::chrono::milliseconds(1));
+}
+
+TEST(_RttTracker_, max_peers) {
+    RttTracker tracker(std::chrono::milliseconds(1), std::chrono::milliseconds(1000), 2);
+    tracker.record("127.0.0.1:7000", std::chrono::milliseconds(1));
+    tracker.record("127.0.0.1:7001", std::chrono::milliseconds(1));
+    tracker.record("127.0.0.1:7000", std::chrono::milliseconds(1));
+    tracker.record("127.0.0.1:7002", std::chrono::milliseconds(1));
+    ASSERT_EQ(tracker.size(), 2);
+    ASSERT_TRUE(tracker.contains("127.0.0.1:7000"));
+    ASSERT_FALSE(tracker.contains("127.0.0.1:7001"));
+    tracker.forget("127.0.0.1:7000");
+    ASSERT_FALSE(tracker.contains("127.0.0.1:7000"));
+}
+
+TEST(_RttTracker_, print) {
+    RttTracker tracker(std::chrono::milliseconds(1), std::chrono::milliseconds(1000));
+    tracker.record("127.0.0.1:7000", std::chrono::milliseconds(1));
+    std::cout << tracker << std::endl;
+}
@@ -0,0 +1,199 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <memory>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "scheduler.h"
+
+using namespace gossip;
+
+TEST(_Scheduler_, construction) {
+    Scheduler scheduler(2, std::chrono::milliseconds(5));
+    ASSERT_EQ(scheduler.num_workers(), 2);
+    ASSERT_EQ(scheduler.tick(), std::chrono::milliseconds(5));
+    ASSERT_EQ(scheduler.size(), 0);
+}
+
+TEST(_Scheduler_, one_shot) {
+    Scheduler scheduler(2, std::chrono::milliseconds(5));
+    std::atomic<int> fired(0);
+    scheduler.schedule(std::chrono::milliseconds(20), [&fired]() { fired++; });
+    ASSERT_EQ(scheduler.size(), 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    ASSERT_EQ(fired, 1);
+    ASSERT_EQ(scheduler.size(), 0);
+}
+
+TEST(_Scheduler_, not_early) {
+    Scheduler scheduler(1, std::chrono::milliseconds(5));
+    std::atomic<bool> fired(false);
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<int64_t> elapsed_ms(0);
+    scheduler.schedule(std::chrono::milliseconds(100), [&]() {
+        elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        fired = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    ASSERT_TRUE(fired);
+    ASSERT_GE(elapsed_ms, 95);
+}
+
+TEST(_Scheduler_, periodic) {
+    Scheduler scheduler(2, std::chrono::milliseconds(5));
+    std::atomic<int> fired(0);
+    auto id = scheduler.schedule_periodic(std::chrono::milliseconds(20), [&fired]() { fired++; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(210));
+    scheduler.cancel(id);
+    int count = fired;
+    ASSERT_GE(count, 5);
+    ASSERT_LE(count, 11);
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    ASSERT_EQ(fired, count);
+}
+
+TEST(_Scheduler_, periodic_jitter) {
+    Scheduler scheduler(1, std::chrono::milliseconds(1));
+    std::mutex lock;
+    std::vector<std::chrono::steady_clock::time_point> fires;
+    auto id = scheduler.schedule_periodic(std::chrono::milliseconds(20), [&]() {
+        std::lock_guard<std::mutex> guard(lock);
+        fires.push_back(std::chrono::steady_clock::now());
+    }, std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    scheduler.cancel(id);
+
+    std::lock_guard<std::mutex> guard(lock);
+    // 30 due on average, a loaded runner only ever delays them
+    ASSERT_GE(fires.size(), 10);
+    ASSERT_LE(fires.size(), 35);
+    std::vector<int64_t> gaps;
+    for (std::size_t i = 1; i < fires.size(); ++i) {
+        gaps.push_back(std::chrono::duration_cast<std::chrono::milliseconds>(fires[i] - fires[i - 1]).count());
+    }
+    // Period is 20 +/- 10ms, single gaps stretch or shrink with the load but the median stays inside it
+    std::sort(gaps.begin(), gaps.end());
+    ASSERT_GE(gaps[gaps.size() / 2], 10);
+    ASSERT_LE(gaps[gaps.size() / 2], 30);
+    ASSERT_GT(std::set<int64_t>(gaps.begin(), gaps.end()).size(), 1);
+}
+
+TEST(_Scheduler_, missed_firings_merge) {
+    Scheduler scheduler(1, std::chrono::milliseconds(1));
+    std::atomic<int> fired(0);
+    // Holds the only worker while the periodic task comes due about ten times
+    scheduler.schedule(std::chrono::milliseconds(1), []() { std::this_thread::sleep_for(std::chrono::milliseconds(100)); });
+    auto id = scheduler.schedule_periodic(std::chrono::milliseconds(10), [&fired]() { fired++; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    scheduler.cancel(id);
+    // 29 come due, the ten or so missed while the worker was held run once rather than back to back
+    ASSERT_GE(fired, 2);
+    ASSERT_LE(fired, 24);
+}
+
+TEST(_Scheduler_, cascade_long_delay) {
+    // 1ms ticks so 100ms spills past the first level of the wheel
+    Scheduler scheduler(1, std::chrono::milliseconds(1));
+    std::atomic<int> fired(0);
+    scheduler.schedule(std::chrono::milliseconds(100), [&fired]() { fired++; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_EQ(fired, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    ASSERT_EQ(fired, 1);
+}
+
+TEST(_Scheduler_, cascade_due_on_boundary) {
+    // One of these lands exactly on a level one slot boundary and comes due as it cascades
+    Scheduler scheduler(2, std::chrono::milliseconds(1));
+    std::atomic<int> fired(0);
+    std::vector<Scheduler::TaskId> ids;
+    for (int period = 64; period < 128; ++period) {
+        ids.push_back(scheduler.schedule_periodic(std::chrono::milliseconds(period), [&fired]() { fired++; }));
+    }
+    ASSERT_EQ(scheduler.size(), 64);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    for (auto id : ids) {
+        scheduler.cancel(id);
+    }
+    // Every periodic timer comes due at least three times in 500ms
+    ASSERT_GE(fired, 64 * 3);
+
+    for (int delay = 64; delay < 128; ++delay) {
+        scheduler.schedule(std::chrono::milliseconds(delay), []() {});
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ASSERT_EQ(scheduler.size(), 0);
+}
+
+TEST(_Scheduler_, cancel_before_fire) {
+    Scheduler scheduler(1, std::chrono::milliseconds(5));
+    std::atomic<int> fired(0);
+    auto id = scheduler.schedule(std::chrono::milliseconds(50), [&fired]() { fired++; });
+    scheduler.cancel(id);
+    ASSERT_EQ(scheduler.size(), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    ASSERT_EQ(fired, 0);
+}
+
+TEST(_Scheduler_, periodic_never_overlaps) {
+    Scheduler scheduler(4, std::chrono::milliseconds(5));
+    std::atomic<int> running(0);
+    std::atomic<int> max_running(0);
+    auto id = scheduler.schedule_periodic(std::chrono::milliseconds(5), [&]() {
+        int now = ++running;
+        if (now > max_running) {
+            max_running = now;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        --running;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    scheduler.cancel(id);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_EQ(max_running, 1);
+}
+
+TEST(_Scheduler_, many_tasks) {
+    Scheduler scheduler(2, std::chrono::milliseconds(5));
+    std::atomic<int> fired(0);
+    for (int i = 0; i < 1000; ++i) {
+        scheduler.schedule(std::chrono::milliseconds(i % 50), [&fired]() { fired++; });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ASSERT_EQ(fired, 1000);
+}
+
+TEST(_Scheduler_, stop) {
+    Scheduler scheduler(2, std::chrono::milliseconds(5));
+    std::atomic<int> fired(0);
+    scheduler.schedule_periodic(std::chrono::milliseconds(10), [&fired]() { fired++; });
+    scheduler.stop();
+    int count = fired;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_EQ(fired, count);
+    ASSERT_EQ(scheduler.size(), 0);
+}
@@ -0,0 +1,278 @@
+/**
+ * GossipSampling
+ * Copyright (C) Matthew Love 2024 (gossipsampling@gmail.com)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <future>
+#include <thread>
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "udp_transport.h"
+#include "client.h"
+#include "server.h"
+#include "peer_sampling_service.h"
+
+using namespace gossip;
+
+namespace {
+
+std::shared_ptr<Server> make_server(const std::string& address) {
+    std::shared_ptr<URView> view = std::make_shared<URView>(address, 10, 5, 5);
+    view->init_selector(SelectorType::TAIL);
+    return std::make_shared<Server>(view);
+}
+
+::grpc::Status exchange(std::shared_ptr<UdpTransport> transport, const std::string& address, ExchangeRequest::Type type,
+                        std::shared_ptr<ViewProto> tx_buf, ViewProto* rx_buf=nullptr,
+                        std::chrono::milliseconds timeout=std::chrono::seconds(1)) {
+    std::promise<::grpc::Status> done;
+    transport->exchange(address, type, tx_buf, timeout, [&done, rx_buf](::grpc::Status status, const ViewProto& view) {
+        if (rx_buf) {
+            *rx_buf = view;
+        }
+        done.set_value(status);
+    });
+    return done.get_future().get();
+}
+
+/* A bare UDP socket on 127.0.0.1, -1 if the port can't be bound */
+int bind_socket(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+}
+
+TEST(_UdpTransport_, start_stop) {
+    std::shared_ptr<UdpTransport> transport = std::make_shared<UdpTransport>("127.0.0.1:50090", 8);
+    ASSERT_EQ(transport->batch_size(), 8);
+    ASSERT_FALSE(transport->active());
+    ASSERT_TRUE(transport->start());
+    ASSERT_TRUE(transport->active());
+    // The port is taken
+    std::shared_ptr<UdpTransport> other = std::make_shared<UdpTransport>("127.0.0.1:50090");
+    ASSERT_FALSE(other->start());
+    transport->stop();
+    ASSERT_FALSE(transport->active());
+    ASSERT_TRUE(other->start());
+}
+
+TEST(_UdpTransport_, serve_unserve) {
+    std::shared_ptr<UdpTransport> transport = std::make_shared<UdpTransport>("127.0.0.1:50091");
+    ASSERT_TRUE(transport->serve(make_server("127.0.0.1:50091")));
+    ASSERT_FALSE(transport->serve(make_server("127.0.0.1:50091")));
+    ASSERT_TRUE(transport->serving());
+    transport->unserve("127.0.0.1:50091");
+    ASSERT_FALSE(transport->serving());
+}
+
+TEST(_UdpTransport_, exchange) {
+    std::shared_ptr<Server> server = make_server("127.0.0.1:50092");
+    std::shared_ptr<UdpTransport> server_transport = std::make_shared<UdpTransport>("127.0.0.1:50092");
+    ASSERT_TRUE(server_transport->serve(server));
+    std::shared_ptr<UdpTransport> client_transport = std::make_shared<UdpTransport>("127.0.0.1:0");
+
+    std::shared_ptr<ViewProto> tx_buf = std::make_shared<ViewProto>();
+    NodeDescriptorProto* node = tx_buf->add_nodes();
+    node->set_address("127.0.0.1:50093");
+    node->set_age(0);
+
+    ViewProto rx_buf;
+    ASSERT_TRUE(exchange(client_transport, "127.0.0.1:50092", ExchangeRequest::PUSH, tx_buf, &rx_buf).ok());
+    ASSERT_EQ(rx_buf.nodes_size(), 0);
+    ASSERT_TRUE(server->view()->contains("127.0.0.1:50093"));
+
+    ASSERT_TRUE(exchange(client_transport, "127.0.0.1:50092", ExchangeRequest::PULL, nullptr, &rx_buf).ok());
+    ASSERT_GT(rx_buf.nodes_size(), 0);
+    ASSERT_EQ(rx_buf.nodes(0).address(), "127.0.0.1:50092");
+
+    ASSERT_TRUE(exchange(client_transport, "127.0.0.1:50092", ExchangeRequest::PUSH_PULL, tx_buf, &rx_buf).ok());
+    ASSERT_EQ(client_transport->pending(), 0);
+}
+
+TEST(_UdpTransport_, batched) {
+    std::shared_ptr<UdpTransport> server_transport = std::make_shared<UdpTransport>("127.0.0.1:50094", 16);
+    ASSERT_TRUE(server_transport->serve(make_server("127.0.0.1:50094")));
+    std::shared_ptr<UdpTransport> client_transport = std::make_shared<UdpTransport>("127.0.0.1:0", 16);
+
+    const int num_exchanges = 256;
+    std::vector<std::promise<::grpc::Status>> done(num_exchanges);
+    for (int i = 0; i < num_exchanges; ++i) {
+        std::promise<::grpc::Status>* promise = &done[i];
+        client_transport->exchange("127.0.0.1:50094", ExchangeRequest::PULL, nullptr, std::chrono::seconds(2),
+                                   [promise](::grpc::Status status, const ViewProto&) {
+            promise->set_value(status);
+        });
+    }
+    for (auto& promise : done) {
+        ASSERT_TRUE(promise.get_future().get().ok());
+    }
+}
+
+TEST(_UdpTransport_, timeout) {
+    // Bound but serving nothing, requests go unanswered
+    std::shared_ptr<UdpTransport> silent = std::make_shared<UdpTransport>("127.0.0.1:50095");
+    ASSERT_TRUE(silent->start());
+    std::shared_ptr<UdpTransport> client_transport = std::make_shared<UdpTransport>("127.0.0.1:0");
+
+    ::grpc::Status status = exchange(client_transport, "127.0.0.1:50095", ExchangeRequest::PULL, nullptr, nullptr,
+                                     std::chrono::milliseconds(50));
+    ASSERT_EQ(status.error_code(), ::grpc::StatusCode::DEADLINE_EXCEEDED);
+    ASSERT_EQ(client_transport->pending(), 0);
+
+    ASSERT_EQ(exchange(client_transport, "no port", ExchangeRequest::PULL, nullptr).error_code(), ::grpc::StatusCode::UNAVAILABLE);
+}
+
+TEST(_UdpTransport_, stop_cancels) {
+    std::shared_ptr<UdpTransport> silent = std::make_shared<UdpTransport>("127.0.0.1:50096");
+    ASSERT_TRUE(silent->start());
+    std::shared_ptr<UdpTransport> client_transport = std::make_shared<UdpTransport>("127.0.0.1:0");
+
+    std::promise<::grpc::Status> done;
+    client_transport->exchange("127.0.0.1:50096", ExchangeRequest::PULL, nullptr, std::chrono::seconds(10),
+                               [&done](::grpc::Status status, const ViewProto&) { done.set_value(status); });
+    client_transport->stop();
+    ASSERT_EQ(done.get_future().get().error_code(), ::grpc::StatusCode::CANCELLED);
+}
+
+TEST(_UdpTransport_, peer_sampling_service) {
+    std::string address0 = "127.0.0.1:50097";
+    std::shared_ptr<URView> view0 = std::make_shared<URView>(address0, 10, 5, 5);
+    view0->init_selector(SelectorType::TAIL);
+    PeerSamplingService entry(true, true, 1, 1, std::vector<std::string>(), view0);
+    entry.set_transport(std::make_shared<UdpTransport>(address0));
+    entry.start_server();
+
+    std::string address1 = "127.0.0.1:50098";
+    std::shared_ptr<URView> view1 = std::make_shared<URView>(address1, 10, 5, 5);
+    view1->init_selector(SelectorType::TAIL);
+    PeerSamplingService node(true, true, 1, 1, {address0}, view1);
+    node.set_transport(std::make_shared<UdpTransport>(address1));
+    node.start_server();
+
+    ASSERT_TRUE(node.enter());
+    ASSERT_TRUE(view1->contains(address0));
+    ASSERT_TRUE(view0->contains(address1));
+}
+
+TEST(_UdpTransport_, response_from_other_source) {
+    // Stands in for the peer, the response is sent once from another port and then from the peer's own
+    int peer = bind_socket(50117);
+    int impostor = bind_socket(50118);
+    ASSERT_GE(peer, 0);
+    ASSERT_GE(impostor, 0);
+    std::shared_ptr<UdpTransport> client_transport = std::make_shared<UdpTransport>("127.0.0.1:0");
+
+    std::promise<::grpc::Status> done;
+    client_transport->exchange("127.0.0.1:50117", ExchangeRequest::PULL, nullptr, std::chrono::seconds(2),
+                               [&done](::grpc::Status status, const ViewProto&) { done.set_value(status); });
+    std::future<::grpc::Status> status = done.get_future();
+
+    std::vector<char> buffer(UdpTransport::kMaxDatagram);
+    sockaddr_storage from;
+    socklen_t from_len = sizeof(from);
+    ssize_t received = recvfrom(peer, buffer.data(), buffer.size(), 0, reinterpret_cast<sockaddr*>(&from), &from_len);
+    ASSERT_GT(received, 0);
+    DatagramProto request;
+    ASSERT_TRUE(request.ParseFromArray(buffer.data(), received));
+
+    DatagramProto reply;
+    reply.mutable_response()->set_id(request.request().id());
+    std::string data = reply.SerializeAsString();
+    sendto(impostor, data.data(), data.size(), 0, reinterpret_cast<sockaddr*>(&from), from_len);
+    ASSERT_EQ(status.wait_for(std::chrono::milliseconds(200)), std::future_status::timeout);
+    ASSERT_EQ(client_transport->pending(), 1);
+
+    sendto(peer, data.data(), data.size(), 0, reinterpret_cast<sockaddr*>(&from), from_len);
+    ASSERT_TRUE(status.get().ok());
+    close(peer);
+    close(impostor);
+}
+
+TEST(_UdpTransport_, oversize_answer) {
+    std::shared_ptr<Server> server = make_server("127.0.0.1:50119");
+    // Every node sent back is 20KB, well past one datagram
+    for (int i = 0; i < 5; ++i) {
+        server->view()->manual_insert(std::make_shared<NodeDescriptor>(std::string(20000, static_cast<char>('a' + i)) + ":1", 0));
+    }
+    std::shared_ptr<UdpTransport> server_transport = std::make_shared<UdpTransport>("127.0.0.1:50119");
+    ASSERT_TRUE(server_transport->serve(server));
+    std::shared_ptr<UdpTransport> client_transport = std::make_shared<UdpTransport>("127.0.0.1:0");
+
+    // Refused straight away rather than left to time out
+    auto start = std::chrono::steady_clock::now();
+    ::grpc::Status status = exchange(client_transport, "127.0.0.1:50119", ExchangeRequest::PULL, nullptr, nullptr,
+                                     std::chrono::seconds(5));
+    ASSERT_EQ(status.error_code(), ::grpc::StatusCode::RESOURCE_EXHAUSTED);
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+}
+
+TEST(_UdpTransport_, max_datagram) {
+    std::shared_ptr<UdpTransport> server_transport = std::make_shared<UdpTransport>("127.0.0.1:50121", 4, nullptr, 512);
+    ASSERT_EQ(server_transport->max_datagram(), 512);
+    ASSERT_TRUE(server_transport->serve(make_server("127.0.0.1:50121")));
+    std::shared_ptr<ViewProto> tx_buf = std::make_shared<ViewProto>();
+    tx_buf->add_nodes()->set_address(std::string(1000, 'a') + ":1");
+
+    // Too long for the server, dropped there rather than parsed cut short
+    std::shared_ptr<UdpTransport> client_transport = std::make_shared<UdpTransport>("127.0.0.1:0");
+    ::grpc::Status status = exchange(client_transport, "127.0.0.1:50121", ExchangeRequest::PUSH, tx_buf, nullptr,
+                                     std::chrono::milliseconds(200));
+    ASSERT_EQ(status.error_code(), ::grpc::StatusCode::DEADLINE_EXCEEDED);
+    // Too long for the sender's own limit, refused before it is sent
+    std::shared_ptr<UdpTransport> small_transport = std::make_shared<UdpTransport>("127.0.0.1:0", 4, nullptr, 512);
+    status = exchange(small_transport, "127.0.0.1:50121", ExchangeRequest::PUSH, tx_buf);
+    ASSERT_EQ(status.error_code(), ::grpc::StatusCode::INVALID_ARGUMENT);
+    ASSERT_EQ(small_transport->pending(), 0);
+
+    ASSERT_EQ(std::make_shared<UdpTransport>("127.0.0.1:0", 1, nullptr, 1 << 20)->max_datagram(), UdpTransport::kMaxDatagram);
+}
+
+TEST(_UdpTransport_, released_from_callback) {
+    std::shared_ptr<UdpTransport> server_transport = std::make_shared<UdpTransport>("127.0.0.1:50120");
+    ASSERT_TRUE(server_transport->serve(make_server("127.0.0.1:50120")));
+
+    std::promise<::grpc::Status> done;
+    {
+        // The callback holds the only reference, so the transport is destroyed on its own receive thread
+        std::shared_ptr<UdpTransport> client_transport = std::make_shared<UdpTransport>("127.0.0.1:0");
+        client_transport->exchange("127.0.0.1:50120", ExchangeRequest::PULL, nullptr, std::chrono::seconds(1),
+                                   [client_transport, &done](::grpc::Status status, const ViewProto&) { done.set_value(status); });
+    }
+    ASSERT_TRUE(done.get_future().get().ok());
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+}
@@ -23,10 +23,14 @@
 #include <memory>
 #include <unordered_set>
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 
 #include <gtest/gtest.h>
 
 #include <view.h>
+#include <packed_view.h>
 
 using namespace gossip;
 
@@ -154,6 +158,21 @@ TEST_F(_URView_, select_empty_logged_view_tail) {
     ASSERT_EQ(blank_peer, nullptr);
 }
 
+TEST_F(_URView_, merge_tail) {
+    std::shared_ptr<URView> test_view = tail_view();
+    std::vector<std::shared_ptr<NodeDescriptor>> rx_nodes = vector_of_nodes(size);
+    std::vector<int> ages;
+    for (auto& node : rx_nodes) {
+        ages.push_back(node->age());
+    }
+    // Received and aged as one step
+    test_view->merge(rx_nodes);
+    for (std::size_t i = 0; i < rx_nodes.size(); ++i) {
+        ASSERT_TRUE(test_view->contains(rx_nodes[i]->address()));
+        ASSERT_EQ(rx_nodes[i]->age(), ages[i] + 1);
+    }
+}
+
 TEST_F(_URView_, rx_nodes_contains_ur) {
     std::shared_ptr<URView> test_view = ur_view();
     std::vector<std::shared_ptr<NodeDescriptor>> rx_nodes = vector_of_nodes(size);
@@ -256,6 +275,22 @@ TEST_F(_URView_, tx_nodes_urnr) {
     }
 }
 
+TEST_F(_URView_, tx_nodes_samples_young) {
+    std::shared_ptr<URView> test_view = ur_view();
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(dummy_nodes);
+    std::unordered_set<std::string> sent;
+    for (int i = 0; i < 100; ++i) {
+        for (auto& node : test_view->tx_nodes()) {
+            sent.insert(node->address());
+        }
+    }
+    // Every node but the healing oldest gets sent sooner or later, the oldest never
+    for (auto& node : dummy_nodes) {
+        ASSERT_EQ(sent.count(node->address()), node->age() < static_cast<uint32_t>(size - healing));
+    }
+}
+
 TEST_F(_URView_, subscriber_empty_tail) {
     std::shared_ptr<URView> test_view = urnr_view();
     auto selector = test_view->create_subscriber(SelectorType::TAIL);
@@ -310,6 +345,109 @@ TEST_F(_URView_, selector_full_urnr) {
     }
 }
 
+TEST_F(_URView_, selector_urnr_honors_delete) {
+    std::shared_ptr<URView> test_view = urnr_view();
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(dummy_nodes);
+    for (int i = 0; i < size / 2; ++i) {
+        ASSERT_TRUE(test_view->remove(dummy_nodes[i]->address()));
+    }
+    // Removed and taken back in, it is owed one selection, not two
+    test_view->manual_insert(std::make_shared<NodeDescriptor>(dummy_nodes[0]->address(), 0));
+    std::unordered_set<std::string> returned;
+    for (int i = 0; i < size / 2 + 1; ++i) {
+        std::shared_ptr<NodeDescriptor> selected = test_view->select_peer();
+        ASSERT_TRUE(test_view->contains(selected->address()));
+        ASSERT_TRUE(returned.insert(selected->address()).second) << "Failed peer :" << *selected << std::endl;
+    }
+}
+
+TEST_F(_URView_, selector_urnr_churn) {
+    std::shared_ptr<URView> test_view = urnr_view();
+    auto selector = test_view->create_subscriber(SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT);
+    for (int round = 0; round < 100; ++round) {
+        std::vector<std::shared_ptr<NodeDescriptor>> rx_nodes;
+        for (int i = 0; i < size / 2; ++i) {
+            rx_nodes.push_back(std::make_shared<NodeDescriptor>("churn:" + std::to_string((round * size / 2 + i) % 30), i));
+        }
+        test_view->merge(rx_nodes);
+    }
+    // Only peers still in the view wait to be selected, each once
+    std::unordered_set<std::string> returned;
+    for (int i = 0; i < test_view->max_size(); ++i) {
+        std::shared_ptr<NodeDescriptor> selected = selector->select_peer();
+        ASSERT_TRUE(test_view->contains(selected->address()));
+        ASSERT_TRUE(returned.insert(selected->address()).second) << "Failed peer :" << *selected << std::endl;
+    }
+}
+
+TEST_F(_URView_, select_peers) {
+    std::shared_ptr<VectorLog> log = std::make_shared<VectorLog>();
+    std::vector<std::shared_ptr<NodeDescriptor>> selected;
+    for (SelectorType type : {SelectorType::TAIL, SelectorType::UNIFORM_RANDOM, SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT,
+                              SelectorType::LOGGED_TAIL, SelectorType::LOGGED_UNIFORM_RANDOM,
+                              SelectorType::LOGGED_UNIFORM_RANDOM_NO_REPLACEMENT}) {
+        auto test_view = std::make_shared<URView>(my_address, size, healing, swap);
+        test_view->init_selector(type, log);
+        ASSERT_EQ(test_view->select_peers(3, selected), 0);
+        std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
+        test_view->rx_nodes(dummy_nodes);
+        // Distinct every time, so asking for more than the view holds returns all of it
+        for (int k : {1, size / 2, size, 2 * size}) {
+            ASSERT_EQ(test_view->select_peers(k, selected), static_cast<std::size_t>(std::min(k, size)));
+            ASSERT_EQ(selected.size(), static_cast<std::size_t>(std::min(k, size)));
+            std::unordered_set<std::string> returned;
+            for (auto& node : selected) {
+                ASSERT_TRUE(test_view->contains(node->address()));
+                ASSERT_TRUE(returned.insert(node->address()).second) << "Repeated peer: " << *node << std::endl;
+            }
+        }
+    }
+    // One entry per peer selected, one for each empty selection
+    ASSERT_EQ(log->data_copy().size(), 3 * (1 + 1 + size / 2 + size + size));
+}
+
+TEST_F(_URView_, select_peers_large_view) {
+    const int large = 64;
+    auto test_view = std::make_shared<URView>(my_address, large, 0, 0);
+    test_view->init_selector(SelectorType::UNIFORM_RANDOM);
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(large);
+    test_view->rx_nodes(dummy_nodes);
+    std::vector<std::shared_ptr<NodeDescriptor>> selected;
+    std::unordered_set<std::string> seen;
+    for (int round = 0; round < 100; ++round) {
+        ASSERT_EQ(test_view->select_peers(40, selected), 40);
+        std::unordered_set<std::string> returned;
+        for (auto& node : selected) {
+            ASSERT_TRUE(returned.insert(node->address()).second);
+            seen.insert(node->address());
+        }
+    }
+    ASSERT_EQ(seen.size(), large);
+}
+
+TEST_F(_URView_, select_peers_urnr) {
+    std::shared_ptr<URView> test_view = urnr_view();
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(dummy_nodes);
+    auto selector = test_view->create_subscriber(SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT);
+    std::vector<std::shared_ptr<NodeDescriptor>> selected;
+    std::unordered_set<std::string> returned;
+    // Every peer once across batches, then batches of distinct peers drawn at random
+    for (int i = 0; i < size / 3; ++i) {
+        ASSERT_EQ(selector->select_peers(3, selected), 3);
+        for (auto& node : selected) {
+            ASSERT_TRUE(returned.insert(node->address()).second) << "Failed peer :" << *node << std::endl;
+        }
+    }
+    ASSERT_EQ(selector->select_peers(3, selected), 3);
+    std::unordered_set<std::string> batch;
+    for (auto& node : selected) {
+        ASSERT_TRUE(batch.insert(node->address()).second);
+    }
+    ASSERT_EQ(returned.count(selected[0]->address()), 0);
+}
+
 TEST_F(_URView_, increment_age) {
     std::shared_ptr<URView> test_view = urnr_view();
     std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
@@ -324,7 +462,227 @@ TEST_F(_URView_, increment_age) {
     }
 }
 
+TEST_F(_URView_, healing_evicts_oldest) {
+    auto test_view = std::make_shared<URView>(my_address, size, size, 0);
+    test_view->init_selector(SelectorType::UNIFORM_RANDOM);
+    std::vector<std::shared_ptr<NodeDescriptor>> old_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(old_nodes);
+    for (int i = 0; i < 100; ++i) {
+        test_view->increment_age();
+    }
+    std::vector<std::shared_ptr<NodeDescriptor>> new_nodes;
+    for (int i = 0; i < size / 2; ++i) {
+        new_nodes.push_back(std::make_shared<NodeDescriptor>("new:" + std::to_string(i), i));
+    }
+    test_view->rx_nodes(new_nodes);
+    for (auto& node : new_nodes) {
+        ASSERT_TRUE(test_view->contains(node->address()));
+    }
+    // The oldest half went, the youngest of the old nodes stayed
+    for (int i = 0; i < size / 2; ++i) {
+        ASSERT_TRUE(test_view->contains(old_nodes[i]->address()));
+        ASSERT_FALSE(test_view->contains(old_nodes[size / 2 + i]->address()));
+    }
+}
+
+TEST_F(_URView_, swap_keeps_order) {
+    auto test_view = std::make_shared<URView>(my_address, size, 0, swap);
+    test_view->init_selector(SelectorType::TAIL);
+    std::vector<std::shared_ptr<NodeDescriptor>> nodes[3];
+    for (int batch = 0; batch < 3; ++batch) {
+        for (int i = 0; i < (batch == 0 ? size : swap); ++i) {
+            nodes[batch].push_back(std::make_shared<NodeDescriptor>(std::string(1, 'a' + batch) + ":" + std::to_string(i), 0));
+        }
+    }
+    // No tx_nodes between merges, the head swapped out is always the oldest arrivals
+    for (auto& batch : nodes) {
+        test_view->merge(batch);
+    }
+    for (auto& node : nodes[0]) {
+        ASSERT_FALSE(test_view->contains(node->address()));
+    }
+    std::vector<std::shared_ptr<NodeDescriptor>> selected;
+    ASSERT_EQ(test_view->select_peers(size, selected), static_cast<std::size_t>(size));
+    for (int i = 0; i < swap; ++i) {
+        ASSERT_EQ(selected[i]->address(), nodes[2][swap - 1 - i]->address());
+        ASSERT_EQ(selected[swap + i]->address(), nodes[1][swap - 1 - i]->address());
+    }
+}
+
+TEST_F(_URView_, random_eviction_keeps_order) {
+    auto test_view = std::make_shared<URView>(my_address, size, 0, 0);
+    test_view->init_selector(SelectorType::TAIL);
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size + swap);
+    test_view->merge(dummy_nodes);
+    ASSERT_EQ(test_view->max_size(), size);
+    std::vector<std::shared_ptr<NodeDescriptor>> selected;
+    ASSERT_EQ(test_view->select_peers(size, selected), static_cast<std::size_t>(size));
+    // The nodes kept are in the order they arrived, the tail is the latest of them
+    auto last = dummy_nodes.end();
+    for (auto& node : selected) {
+        auto found = std::find_if(dummy_nodes.begin(), last, [&node](const std::shared_ptr<NodeDescriptor>& other) {
+            return other->address() == node->address();
+        });
+        ASSERT_NE(found, last) << "Out of order: " << *node << std::endl;
+        last = found;
+    }
+}
+
+TEST_F(_URView_, evictions_forget_nodes) {
+    std::shared_ptr<URView> test_view = urnr_view();
+    std::vector<std::shared_ptr<NodeDescriptor>> seen;
+    for (int round = 0; round < 100; ++round) {
+        std::vector<std::shared_ptr<NodeDescriptor>> rx_nodes;
+        for (int i = 0; i < size / 2; ++i) {
+            rx_nodes.push_back(std::make_shared<NodeDescriptor>("churn:" + std::to_string(round * size + i), i));
+        }
+        test_view->rx_nodes(rx_nodes);
+        test_view->increment_age();
+        seen.insert(seen.end(), rx_nodes.begin(), rx_nodes.end());
+        ASSERT_EQ(test_view->max_size(), std::min(size, (round + 1) * size / 2));
+    }
+    int contained = 0;
+    for (auto& node : seen) {
+        contained += test_view->contains(node->address());
+    }
+    // Whichever eviction took them, nodes gone from the view are gone from its lookup too
+    ASSERT_EQ(contained, test_view->max_size());
+    for (int i = 0; i < size; ++i) {
+        ASSERT_TRUE(test_view->contains(test_view->select_peer()->address()));
+    }
+}
+
+TEST_F(_URView_, increment_age_evicted) {
+    std::shared_ptr<URView> test_view = ur_view();
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(dummy_nodes);
+    test_view->increment_age();
+    std::string removed = dummy_nodes[0]->address();
+    ASSERT_TRUE(test_view->remove(removed));
+    test_view->increment_age();
+    // Evicted descriptors stop aging with the view
+    ASSERT_EQ(dummy_nodes[0]->age(), 1);
+    ASSERT_EQ(dummy_nodes[1]->age(), 3);
+}
+
+TEST_F(_URView_, remove) {
+    std::shared_ptr<URView> test_view = tail_view();
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(dummy_nodes);
+    auto sub = test_view->create_subscriber(SelectorType::TAIL);
+
+    std::string removed = sub->select_peer()->address();
+    ASSERT_TRUE(test_view->remove(removed));
+    ASSERT_FALSE(test_view->contains(removed));
+    ASSERT_NE(sub->select_peer()->address(), removed);
+    ASSERT_FALSE(test_view->remove(removed));
+    // Never removes itself
+    ASSERT_FALSE(test_view->remove(my_address));
+    ASSERT_TRUE(test_view->contains(my_address));
+}
+
+TEST_F(_URView_, read_after_unread_changes) {
+    std::shared_ptr<URView> test_view = tail_view();
+    ASSERT_EQ(test_view->max_size(), 0);
+    // Several changes with no read in between, the next read sees all of them
+    std::vector<std::shared_ptr<NodeDescriptor>> dummy_nodes = vector_of_nodes(size);
+    test_view->rx_nodes(dummy_nodes);
+    test_view->tx_nodes();
+    std::string removed = dummy_nodes[0]->address();
+    ASSERT_TRUE(test_view->remove(removed));
+
+    ASSERT_EQ(test_view->max_size(), size - 1);
+    ASSERT_FALSE(test_view->contains(removed));
+    ASSERT_TRUE(test_view->contains(dummy_nodes[1]->address()));
+    std::vector<std::shared_ptr<NodeDescriptor>> tail;
+    ASSERT_EQ(test_view->select_peers(size, tail), static_cast<std::size_t>(size - 1));
+}
+
+TEST_F(_URView_, select_while_merging) {
+    std::shared_ptr<URView> test_view = ur_view();
+    auto tail = test_view->create_subscriber(SelectorType::TAIL);
+    std::atomic<bool> merging(true);
+    std::thread merger([&]() {
+        for (int round = 0; merging; ++round) {
+            std::vector<std::shared_ptr<NodeDescriptor>> rx_nodes;
+            for (int i = 0; i < size / 2; ++i) {
+                rx_nodes.push_back(std::make_shared<NodeDescriptor>("churn:" + std::to_string((round * size / 2 + i) % 1000), i));
+            }
+            test_view->merge(rx_nodes);
+            test_view->tx_nodes();
+        }
+    });
+
+    // With one core the reads could otherwise all be over before the merger first runs
+    while (test_view->max_size() == 0) {
+        std::this_thread::yield();
+    }
+    // Readers always see a whole view, however they interleave with the merges
+    int selected = 0;
+    for (int i = 0; i < 10000; ++i) {
+        std::shared_ptr<NodeDescriptor> peer = i % 2 ? test_view->select_peer() : tail->select_peer();
+        if (peer) {
+            ++selected;
+            ASSERT_EQ(peer->address().rfind("churn:", 0), 0);
+            ASSERT_LT(peer->age(), 1000000);
+        }
+        ASSERT_LE(test_view->max_size(), size);
+        ASSERT_TRUE(test_view->contains(my_address));
+    }
+    merging = false;
+    merger.join();
+    ASSERT_GT(selected, 0);
+}
+
 TEST_F(_URView_, print) {
     std::shared_ptr<URView> test_view = urnr_view();
     std::cout << *test_view << std::endl;
 }
+
+template <class T>
+struct _SeededView_ : public ::testing::Test {
+    const std::string my_address = "192.168.225.1:5012";
+    const int size = 10;
+    const int healing = 5;
+    const int swap = 5;
+
+    /* Every peer a view built from seed sends or selects over rounds of merges */
+    std::vector<std::string> choices(uint64_t seed) {
+        auto test_view = std::make_shared<T>(my_address, size, healing, swap, seed);
+        test_view->init_selector(SelectorType::UNIFORM_RANDOM_NO_REPLACEMENT);
+        auto selector = test_view->create_subscriber(SelectorType::UNIFORM_RANDOM);
+        std::vector<std::shared_ptr<NodeDescriptor>> selected;
+        std::vector<std::string> choices;
+        for (int round = 0; round < 50; ++round) {
+            std::vector<std::shared_ptr<NodeDescriptor>> rx_nodes;
+            for (int i = 0; i < size / 2; ++i) {
+                rx_nodes.push_back(std::make_shared<NodeDescriptor>("peer:" + std::to_string((round * 3 + i) % 40), i));
+            }
+            test_view->merge(rx_nodes);
+            for (auto& node : test_view->tx_nodes()) {
+                choices.push_back(node->address());
+            }
+            choices.push_back(test_view->select_peer()->address());
+            choices.push_back(selector->select_peer()->address());
+            // The pool of peers not yet selected holds at most the last merge, the rest are drawn from the view's engine
+            EXPECT_EQ(test_view->select_peers(size, selected), static_cast<std::size_t>(test_view->max_size()));
+            for (auto& node : selected) {
+                choices.push_back(node->address());
+            }
+            selector->select_peers(size / 2, selected);
+            for (auto& node : selected) {
+                choices.push_back(node->address());
+            }
+        }
+        return choices;
+    }
+};
+
+using SeededViews = ::testing::Types<URView, PackedView>;
+TYPED_TEST_SUITE(_SeededView_, SeededViews);
+
+TYPED_TEST(_SeededView_, same_seed_same_choices) {
+    ASSERT_EQ(this->choices(7), this->choices(7));
+    ASSERT_NE(this->choices(7), this->choices(8));
+    ASSERT_EQ(std::make_shared<TypeParam>(this->my_address, this->size, this->healing, this->swap, 7)->seed(), 7);
+}